@@ -0,0 +1,300 @@
+// Benchmark: deterministic timings of the hot paths in the engine and its libraries.
+// Inputs are generated from fixed seeds, so two runs only differ by the code being measured.
+//
+// Usage: Benchmark [options]
+//   --filter TEXT        only run stages whose group/case/stage name contains TEXT
+//   --json PATH          write the results as JSON, to diff runs across commits
+//   --label TEXT         free text stored in the JSON, e.g. the commit hash
+//   --min-iterations N   run every stage at least N times (default: 3)
+//   --min-seconds S      and for at least S seconds (default: 0.2)
+//   --large              also run the big inputs
+
+// Std. Includes
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// 3rdparty
+#include "lodepng.h"
+
+// Project includes
+#include "Benchmark.h"
+
+double BenchmarkSeconds()
+{
+#ifdef _WIN32
+	// high_resolution_clock of VS2013 is the system clock with millisecond steps, too coarse for short stages
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+unsigned long long BenchmarkCycles()
+{
+#if defined(_WIN32) || defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+double BenchmarkResult::MegabytesPerSecond() const
+{
+	return this->BestSeconds > 0.0 ? this->Bytes / (1024.0 * 1024.0) / this->BestSeconds : 0.0;
+}
+
+double BenchmarkResult::CyclesPerByte() const
+{
+	return this->Bytes > 0 ? this->BestCycles / this->Bytes : 0.0;
+}
+
+BenchmarkSuite::BenchmarkSuite() : MinIterations(3), MinSeconds(0.2), Large(false)
+{
+}
+
+bool BenchmarkSuite::IsEnabled(const std::string& group, const std::string& caseName, const std::string& stage) const
+{
+	return this->Filter.empty() || (group + "/" + caseName + "/" + stage).find(this->Filter) != std::string::npos;
+}
+
+void BenchmarkSuite::Run(const std::string& group, const std::string& caseName, const std::string& stage, size_t bytes,
+	const std::function<unsigned()>& body, const std::function<void()>& prepare)
+{
+	if (!this->IsEnabled(group, caseName, stage))
+		return;
+
+	BenchmarkResult result = BenchmarkResult();
+	result.Group = group;
+	result.Case = caseName;
+	result.Stage = stage;
+	result.Bytes = bytes;
+
+	double totalSeconds = 0.0;
+	while (result.Iterations < this->MinIterations || totalSeconds < this->MinSeconds)
+	{
+		if (prepare)
+			prepare();
+		double start = BenchmarkSeconds();
+		unsigned long long startCycles = BenchmarkCycles();
+		unsigned error = body();
+		double cycles = (double)(BenchmarkCycles() - startCycles);
+		double seconds = BenchmarkSeconds() - start;
+		if (error)
+		{
+			std::ostringstream message;
+			message << "error " << error;
+			this->Fail(group, caseName, stage, message.str());
+			return;
+		}
+
+		if (result.Iterations == 0 || seconds < result.BestSeconds)
+			result.BestSeconds = seconds;
+		if (result.Iterations == 0 || cycles < result.BestCycles)
+			result.BestCycles = cycles;
+		totalSeconds += seconds;
+		result.Iterations++;
+	}
+	result.MeanSeconds = totalSeconds / result.Iterations;
+
+	this->results.push_back(result);
+	this->print(result);
+}
+
+void BenchmarkSuite::Fail(const std::string& group, const std::string& caseName, const std::string& stage, const std::string& error)
+{
+	BenchmarkResult result = BenchmarkResult();
+	result.Group = group;
+	result.Case = caseName;
+	result.Stage = stage;
+	result.Error = error;
+	this->results.push_back(result);
+	this->print(result);
+}
+
+void BenchmarkSuite::Record(const std::string& group, const std::string& caseName, const std::string& stage, const std::string& name,
+	double value, const std::string& unit)
+{
+	if (!this->IsEnabled(group, caseName, stage))
+		return;
+
+	BenchmarkMetric metric;
+	metric.Group = group;
+	metric.Case = caseName;
+	metric.Stage = stage;
+	metric.Name = name;
+	metric.Value = value;
+	metric.Unit = unit;
+	this->metrics.push_back(metric);
+
+	std::ostringstream line;
+	line << std::left << std::setw(8) << group << std::setw(28) << caseName << std::setw(14) << stage
+		<< name << " " << std::fixed << std::setprecision(2) << value << " " << unit;
+	std::cout << line.str() << std::endl;
+}
+
+unsigned BenchmarkSuite::GetFailureCount() const
+{
+	unsigned failures = 0;
+	for (size_t i = 0; i < this->results.size(); i++)
+	{
+		if (!this->results[i].Error.empty())
+			failures++;
+	}
+	return failures;
+}
+
+void BenchmarkSuite::print(const BenchmarkResult& result) const
+{
+	std::ostringstream line;
+	line << std::left << std::setw(8) << result.Group << std::setw(28) << result.Case << std::setw(14) << result.Stage;
+	if (!result.Error.empty())
+		line << "ERROR::BENCHMARK::" << result.Error;
+	else if (result.Bytes == 0)
+	{
+		// No bytes to divide by, the best time is all there is
+		line << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << result.BestSeconds * 1000.0 << " ms"
+			<< "  (" << result.Iterations << " runs)";
+	}
+	else
+	{
+		line << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << result.MegabytesPerSecond() << " MB/s"
+			<< std::setw(10) << result.CyclesPerByte() << " cycles/byte"
+			<< "  (" << result.Iterations << " runs)";
+	}
+	std::cout << line.str() << std::endl;
+}
+
+static std::string jsonString(const std::string& text)
+{
+	std::ostringstream out;
+	out << '"';
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = (unsigned char)text[i];
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c < 0x20)
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (unsigned)c << std::dec << std::setfill(' ');
+		else
+			out << c;
+	}
+	out << '"';
+	return out.str();
+}
+
+bool BenchmarkSuite::WriteJson(const std::string& path) const
+{
+	std::ofstream file(path.c_str());
+	if (!file)
+		return false;
+
+	// One result per line, so a plain text diff of two runs shows exactly the stages that moved
+	file << std::setprecision(9);
+	file << "{" << std::endl;
+	file << "  \"schema\": 2," << std::endl;
+	file << "  \"label\": " << jsonString(this->Label) << "," << std::endl;
+	file << "  \"lodepng\": " << jsonString(LODEPNG_VERSION_STRING) << "," << std::endl;
+	file << "  \"min_iterations\": " << this->MinIterations << "," << std::endl;
+	file << "  \"min_seconds\": " << this->MinSeconds << "," << std::endl;
+	file << "  \"results\": [" << std::endl;
+	for (size_t i = 0; i < this->results.size(); i++)
+	{
+		const BenchmarkResult& result = this->results[i];
+		file << "    {\"group\": " << jsonString(result.Group)
+			<< ", \"case\": " << jsonString(result.Case)
+			<< ", \"stage\": " << jsonString(result.Stage);
+		if (!result.Error.empty())
+			file << ", \"error\": " << jsonString(result.Error);
+		else
+		{
+			file << ", \"bytes\": " << result.Bytes
+				<< ", \"iterations\": " << result.Iterations
+				<< ", \"best_seconds\": " << result.BestSeconds
+				<< ", \"mean_seconds\": " << result.MeanSeconds
+				<< ", \"mb_per_s\": " << result.MegabytesPerSecond()
+				<< ", \"cycles_per_byte\": " << result.CyclesPerByte();
+		}
+		file << "}" << (i + 1 < this->results.size() ? "," : "") << std::endl;
+	}
+	file << "  ]," << std::endl;
+	file << "  \"metrics\": [" << std::endl;
+	for (size_t i = 0; i < this->metrics.size(); i++)
+	{
+		const BenchmarkMetric& metric = this->metrics[i];
+		file << "    {\"group\": " << jsonString(metric.Group)
+			<< ", \"case\": " << jsonString(metric.Case)
+			<< ", \"stage\": " << jsonString(metric.Stage)
+			<< ", \"name\": " << jsonString(metric.Name)
+			<< ", \"value\": " << metric.Value
+			<< ", \"unit\": " << jsonString(metric.Unit)
+			<< "}" << (i + 1 < this->metrics.size() ? "," : "") << std::endl;
+	}
+	file << "  ]" << std::endl;
+	file << "}" << std::endl;
+	return file.good();
+}
+
+static void printUsage()
+{
+	std::cout << "Usage: Benchmark [--filter TEXT] [--json PATH] [--label TEXT]" << std::endl;
+	std::cout << "                 [--min-iterations N] [--min-seconds S] [--large]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkSuite suite;
+	std::string jsonPath;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+			suite.Filter = argv[++i];
+		else if (arg == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (arg == "--label" && hasValue)
+			suite.Label = argv[++i];
+		else if (arg == "--min-iterations" && hasValue)
+			suite.MinIterations = (unsigned)atoi(argv[++i]);
+		else if (arg == "--min-seconds" && hasValue)
+			suite.MinSeconds = atof(argv[++i]);
+		else if (arg == "--large")
+			suite.Large = true;
+		else
+		{
+			std::cout << "ERROR::BENCHMARK::UNKNOWN_ARGUMENT " << arg << std::endl;
+			printUsage();
+			return 1;
+		}
+	}
+	if (suite.MinIterations == 0)
+		suite.MinIterations = 1;
+
+	RunPngBenchmarks(suite);
+	RunTextureBenchmarks(suite);
+	RunSceneBenchmarks(suite);
+
+	if (!jsonPath.empty() && !suite.WriteJson(jsonPath))
+	{
+		std::cout << "ERROR::BENCHMARK::JSON_NOT_WRITTEN " << jsonPath << std::endl;
+		return 1;
+	}
+	return suite.GetFailureCount() ? 2 : 0;
+}
@@ -0,0 +1,88 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <functional>
+
+// Wall clock in seconds, from the highest resolution timer the platform has
+double BenchmarkSeconds();
+// Time stamp counter. On current CPUs it ticks at a fixed rate instead of following the core clock,
+// so cycles/byte are only comparable between runs on the same machine.
+unsigned long long BenchmarkCycles();
+
+struct BenchmarkResult
+{
+	std::string Group;
+	std::string Case;
+	std::string Stage;
+	// Bytes one iteration processes, the unit throughput is given in
+	size_t Bytes;
+	unsigned Iterations;
+	// The fastest iteration is the one least disturbed by the rest of the system, so that is what gets compared
+	double BestSeconds;
+	double MeanSeconds;
+	double BestCycles;
+	// Empty unless the stage failed, in which case there are no timings
+	std::string Error;
+
+	double MegabytesPerSecond() const;
+	double CyclesPerByte() const;
+};
+
+// A measured property of a stage's output other than its speed, e.g. the PSNR of a lossy encoder
+struct BenchmarkMetric
+{
+	std::string Group;
+	std::string Case;
+	std::string Stage;
+	std::string Name;
+	double Value;
+	std::string Unit;
+};
+
+// Times benchmark bodies and collects the results for printing and JSON export
+class BenchmarkSuite
+{
+public:
+	// Only stages whose "group/case/stage" name contains Filter run, empty runs everything
+	std::string Filter;
+	// Every stage runs at least MinIterations times, and keeps going until MinSeconds have been spent on it
+	unsigned MinIterations;
+	double MinSeconds;
+	// Also generate the big inputs. Slower, but closer to the size of real assets
+	bool Large;
+	// Free text copied into the JSON, e.g. the commit being measured
+	std::string Label;
+
+	BenchmarkSuite();
+
+	bool IsEnabled(const std::string& group, const std::string& caseName, const std::string& stage) const;
+	// Times body, which processes bytes bytes per call (0 if it has no per byte figure) and returns 0 on success. prepare runs before every
+	// call and is not timed, for stages that consume their input. A nonzero return from body fails the stage.
+	void Run(const std::string& group, const std::string& caseName, const std::string& stage, size_t bytes,
+		const std::function<unsigned()>& body, const std::function<void()>& prepare = std::function<void()>());
+	// Records a stage that could not run, e.g. because setting up its input failed
+	void Fail(const std::string& group, const std::string& caseName, const std::string& stage, const std::string& error);
+	// Records a metric of a stage, skipped like the stage itself if the filter excludes it
+	void Record(const std::string& group, const std::string& caseName, const std::string& stage, const std::string& name,
+		double value, const std::string& unit);
+
+	// Results in the order they ran, so the JSON of two runs lines up for diffing
+	bool WriteJson(const std::string& path) const;
+	const std::vector<BenchmarkResult>& GetResults() const { return this->results; }
+	unsigned GetFailureCount() const;
+
+private:
+	std::vector<BenchmarkResult> results;
+	std::vector<BenchmarkMetric> metrics;
+
+	void print(const BenchmarkResult& result) const;
+};
+
+// Benchmark groups, each in its own source file
+void RunPngBenchmarks(BenchmarkSuite& suite);
+void RunTextureBenchmarks(BenchmarkSuite& suite);
+void RunSceneBenchmarks(BenchmarkSuite& suite);
+#endif
@@ -0,0 +1,344 @@
+// Times the stages of the lodepng decoder and encoder one by one on the generated corpus.
+// The unfilter, filter and LZ77 stages are internal to lodepng, they come from the LODEPNG_COMPILE_BENCHMARK entry points.
+//
+// Throughput is per stage input or output, whichever is the image in its uncompressed form:
+//   crc                  the whole PNG file
+//   inflate              the inflated scanlines (output)
+//   unfilter, filter     the raw pixels in the color type of the PNG
+//   convert, decode      the RGBA8 output. decode_unchecked is decode with every limit check switched off, even
+//                        the cap at the predicted IDAT size that decode always has, decode_limits sets all limits
+//   lz77, deflate        the filtered scanlines (input)
+//   encode               the raw pixels in the color type of the PNG
+//   rows, rows_indexed   the RGBA8 output of the middle quarter of the rows, without and with a row index. Its
+//                        speedup is the best decode time over its own, for the same PNG
+//
+// The limits check at the end times the decodes against each other once more, see checkLimitsOverhead.
+
+// Std. Includes
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+
+// 3rdparty
+#include "lodepng.h"
+
+// Project includes
+#include "Benchmark.h"
+#include "PngCorpus.h"
+
+// Results of stages nothing else reads go here, so whole program optimization can't drop the call
+static volatile unsigned sink;
+
+// Concatenates the data of all IDAT chunks, which is the zlib stream of the image
+static void extractZlibStream(const std::vector<unsigned char>& png, std::vector<unsigned char>& zlib)
+{
+	// The corpus PNGs come straight from the encoder, so the chunks need no validation
+	const unsigned char* end = &png[0] + png.size();
+	for (const unsigned char* chunk = &png[8]; chunk + 12 <= end; chunk = lodepng_chunk_next_const(chunk))
+	{
+		if (lodepng_chunk_type_equals(chunk, "IDAT"))
+		{
+			const unsigned char* data = lodepng_chunk_data_const(chunk);
+			zlib.insert(zlib.end(), data, data + lodepng_chunk_length(chunk));
+		}
+		else if (lodepng_chunk_type_equals(chunk, "IEND"))
+			break;
+	}
+}
+
+// The checks a decode makes. Every one decodes to RGBA8 like lodepng_decode32 does
+enum Decode_Limits {
+	// None at all, through the benchmark entry point, not even the cap at the predicted IDAT size
+	DECODE_UNCHECKED,
+	// The cap only, which every decode has
+	DECODE_DEFAULT,
+	// All limits set
+	DECODE_LIMITED,
+	DECODE_LIMITS_COUNT
+};
+static const char* const decodeStages[DECODE_LIMITS_COUNT] = { "decode_unchecked", "decode", "decode_limits" };
+
+// The decoder limits have to stay in the noise: decode_limits may be this much slower than decode_unchecked over
+// the corpus, or as much as the timing noise of the run if that is more
+static const double maxLimitsOverhead = 0.01;
+// Rounds of the limits check, each decodes every image once with every Decode_Limits
+static const unsigned limitsRounds = 10;
+
+static unsigned decodeWithLimits(const CorpusImage& image, Decode_Limits limits)
+{
+	LodePNGState state;
+	lodepng_state_init(&state);
+	if (limits == DECODE_LIMITED)
+	{
+		state.decoder.max_pixels = (size_t)image.Width * image.Height;
+		state.decoder.max_chunks = 4096;
+		state.decoder.zlibsettings.max_output_size = 64 * 1024 * 1024;
+	}
+	unsigned char* out = 0;
+	unsigned w, h;
+	unsigned error = limits == DECODE_UNCHECKED
+		? lodepng_bench_decode_unchecked(&out, &w, &h, &state, &image.Png[0], image.Png.size())
+		: lodepng_decode(&out, &w, &h, &state, &image.Png[0], image.Png.size());
+	free(out);
+	lodepng_state_cleanup(&state);
+	return error;
+}
+
+// Rows of the middle quarter, far enough down that decoding without an index has to inflate most of what is above
+static const unsigned rowsBegin = 3, rowsEnd = 5, rowsFraction = 8;
+// Checkpoint spacing of the row index, small enough that even the 256 pixel images get several
+static const size_t rowIndexSpacing = 32768;
+
+// The last result of a stage, or null if it didn't run or failed
+static const BenchmarkResult* findResult(const BenchmarkSuite& suite, const std::string& group, const std::string& caseName,
+	const std::string& stage)
+{
+	const std::vector<BenchmarkResult>& results = suite.GetResults();
+	for (size_t i = results.size(); i-- > 0;)
+	{
+		const BenchmarkResult& result = results[i];
+		if (result.Group == group && result.Case == caseName && result.Stage == stage)
+			return result.Error.empty() ? &result : nullptr;
+	}
+	return nullptr;
+}
+
+// Times lodepng_decode_rows against the full decode, after checking it returns the same bytes as the full decode
+// has for those rows. Interlaced images can't be decoded by rows
+static void benchmarkRows(BenchmarkSuite& suite, const CorpusImage& image)
+{
+	const std::string group = "png";
+	const char* const stages[] = { "rows", "rows_indexed" };
+	if (image.State.info_png.interlace_method != 0
+		|| (!suite.IsEnabled(group, image.Name, stages[0]) && !suite.IsEnabled(group, image.Name, stages[1])))
+		return;
+
+	unsigned y0 = image.Height * rowsBegin / rowsFraction, y1 = image.Height * rowsEnd / rowsFraction;
+	size_t rowBytes = (size_t)image.Width * 4;
+	std::vector<unsigned char> full, rows;
+	unsigned w, h;
+	lodepng::RowIndex index;
+	unsigned error = lodepng::decode(full, w, h, image.Png);
+	if (!error)
+		error = lodepng::build_row_index(index, image.Png, rowIndexSpacing);
+	if (error)
+	{
+		suite.Fail(group, image.Name, stages[0], lodepng_error_text(error));
+		return;
+	}
+
+	for (int indexed = 0; indexed < 2; indexed++)
+	{
+		const LodePNGRowIndex* rowIndex = indexed ? &index : nullptr;
+		rows.clear();
+		error = lodepng::decode_rows(rows, w, h, image.Png, y0, y1, rowIndex);
+		if (error || rows.size() != (y1 - y0) * rowBytes || !std::equal(rows.begin(), rows.end(), full.begin() + y0 * rowBytes))
+		{
+			suite.Fail(group, image.Name, stages[indexed], error ? lodepng_error_text(error) : "rows differ from the full decode");
+			continue;
+		}
+
+		suite.Run(group, image.Name, stages[indexed], rows.size(), [&]()
+		{
+			unsigned char* out = 0;
+			unsigned outW, outH;
+			lodepng::State state;
+			unsigned error = lodepng_decode_rows(&out, &outW, &outH, &state, &image.Png[0], image.Png.size(), y0, y1, rowIndex);
+			free(out);
+			return error;
+		});
+		const BenchmarkResult* decode = findResult(suite, group, image.Name, decodeStages[DECODE_DEFAULT]);
+		const BenchmarkResult* partial = findResult(suite, group, image.Name, stages[indexed]);
+		if (decode && partial)
+			suite.Record(group, image.Name, stages[indexed], "speedup", decode->BestSeconds / partial->BestSeconds, "x");
+	}
+}
+
+static void benchmarkImage(BenchmarkSuite& suite, CorpusImage& image)
+{
+	const std::string group = "png";
+	const unsigned w = image.Width, h = image.Height;
+	const LodePNGInfo& info = image.State.info_png;
+
+	// Inputs of the stages in the middle of the pipeline, taken from the real pipeline once up front
+	std::vector<unsigned char> zlib, scanlines;
+	extractZlibStream(image.Png, zlib);
+	unsigned error = lodepng::decompress(scanlines, zlib);
+	if (error || scanlines.empty())
+	{
+		suite.Fail(group, image.Name, "setup", error ? lodepng_error_text(error) : "no image data");
+		return;
+	}
+
+	size_t rawSize = lodepng_get_raw_size(w, h, &info.color);
+	size_t rgbaSize = (size_t)w * h * 4;
+	std::vector<unsigned char> work(scanlines.size()), raw(rawSize), rgba(rgbaSize);
+	LodePNGColorMode rgbaMode;
+	lodepng_color_mode_init(&rgbaMode);
+
+	suite.Run(group, image.Name, "crc", image.Png.size(), [&]()
+	{
+		sink = lodepng_crc32(&image.Png[0], image.Png.size());
+		return 0u;
+	});
+
+	suite.Run(group, image.Name, "inflate", scanlines.size(), [&]()
+	{
+		unsigned char* out = 0;
+		size_t outsize = 0;
+		unsigned error = lodepng_zlib_decompress(&out, &outsize, &zlib[0], zlib.size(), &lodepng_default_decompress_settings);
+		free(out);
+		return error;
+	});
+
+	// Unfiltering clobbers its input, so every run gets a fresh copy of the scanlines
+	suite.Run(group, image.Name, "unfilter", rawSize, [&]()
+	{
+		return lodepng_bench_unfilter(&raw[0], &work[0], w, h, &info);
+	}, [&]()
+	{
+		work = scanlines;
+	});
+
+	suite.Run(group, image.Name, "convert", rgbaSize, [&]()
+	{
+		return lodepng_convert(&rgba[0], &image.Pixels[0], &rgbaMode, &info.color, w, h);
+	});
+
+	for (int limits = 0; limits < DECODE_LIMITS_COUNT; limits++)
+	{
+		suite.Run(group, image.Name, decodeStages[limits], rgbaSize, [&]()
+		{
+			return decodeWithLimits(image, (Decode_Limits)limits);
+		});
+	}
+	benchmarkRows(suite, image);
+
+	suite.Run(group, image.Name, "filter", rawSize, [&]()
+	{
+		unsigned char* out = 0;
+		size_t outsize = 0;
+		unsigned error = lodepng_bench_filter(&out, &outsize, &image.Pixels[0], w, h, &info, &image.State.encoder);
+		free(out);
+		return error;
+	});
+
+	suite.Run(group, image.Name, "lz77", scanlines.size(), [&]()
+	{
+		size_t symbols = 0;
+		unsigned error = lodepng_bench_lz77(&symbols, &scanlines[0], scanlines.size(), &image.State.encoder.zlibsettings);
+		sink = (unsigned)symbols;
+		return error;
+	});
+
+	suite.Run(group, image.Name, "deflate", scanlines.size(), [&]()
+	{
+		unsigned char* out = 0;
+		size_t outsize = 0;
+		unsigned error = lodepng_deflate(&out, &outsize, &scanlines[0], scanlines.size(), &image.State.encoder.zlibsettings);
+		free(out);
+		return error;
+	});
+
+	suite.Run(group, image.Name, "encode", rawSize, [&]()
+	{
+		unsigned char* out = 0;
+		size_t outsize = 0;
+		unsigned error = lodepng_encode(&out, &outsize, &image.Pixels[0], w, h, &image.State);
+		free(out);
+		return error;
+	});
+
+	lodepng_color_mode_cleanup(&rgbaMode);
+}
+
+// Times decode and decode_limits against decode_unchecked and fails the run if the limits cost more than the noise
+// lets pass. The stages above run one after the other, so a machine that gets busier halfway makes one of them look
+// slower; here the decodes of an image take turns, in a different order every round, and each keeps its best.
+// The noise is how far the best of the even rounds and the best of the odd rounds of one decode differ
+static void checkLimitsOverhead(BenchmarkSuite& suite, const std::vector<CorpusImage>& corpus)
+{
+	if (!suite.IsEnabled("png", "corpus", "limits"))
+		return;
+
+	// Best seconds of every decode of every image, over all rounds and over the even and the odd ones
+	const double none = std::numeric_limits<double>::max();
+	std::vector<double> best(corpus.size() * DECODE_LIMITS_COUNT, none), even(best), odd(best);
+	for (unsigned round = 0; round < limitsRounds; round++)
+	{
+		for (size_t i = 0; i < corpus.size(); i++)
+		{
+			for (int turn = 0; turn < DECODE_LIMITS_COUNT; turn++)
+			{
+				int limits = (turn + round) % DECODE_LIMITS_COUNT;
+				double start = BenchmarkSeconds();
+				unsigned error = decodeWithLimits(corpus[i], (Decode_Limits)limits);
+				double seconds = BenchmarkSeconds() - start;
+				if (error)
+				{
+					suite.Fail("png", corpus[i].Name, "limits", lodepng_error_text(error));
+					return;
+				}
+				size_t index = i * DECODE_LIMITS_COUNT + limits;
+				best[index] = std::min(best[index], seconds);
+				double& half = round % 2 ? odd[index] : even[index];
+				half = std::min(half, seconds);
+			}
+		}
+	}
+
+	double total[DECODE_LIMITS_COUNT] = {}, noise = 0.0;
+	for (int limits = 0; limits < DECODE_LIMITS_COUNT; limits++)
+	{
+		double evenTotal = 0.0, oddTotal = 0.0;
+		for (size_t i = 0; i < corpus.size(); i++)
+		{
+			total[limits] += best[i * DECODE_LIMITS_COUNT + limits];
+			evenTotal += even[i * DECODE_LIMITS_COUNT + limits];
+			oddTotal += odd[i * DECODE_LIMITS_COUNT + limits];
+		}
+		noise = std::max(noise, std::abs(evenTotal - oddTotal));
+	}
+	if (corpus.empty() || total[DECODE_UNCHECKED] <= 0.0)
+		return;
+
+	double margin = std::max(maxLimitsOverhead, noise / total[DECODE_UNCHECKED]);
+	double overhead = total[DECODE_LIMITED] / total[DECODE_UNCHECKED] - 1.0;
+	suite.Record("png", "corpus", "limits", "cap_overhead", 100.0 * (total[DECODE_DEFAULT] / total[DECODE_UNCHECKED] - 1.0), "%");
+	suite.Record("png", "corpus", "limits", "limits_overhead", 100.0 * overhead, "%");
+	suite.Record("png", "corpus", "limits", "limits_noise", 100.0 * noise / total[DECODE_UNCHECKED], "%");
+	if (overhead > margin)
+	{
+		std::ostringstream message;
+		message << std::fixed << std::setprecision(2) << "decoder limits cost " << 100.0 * overhead
+			<< "% over decode_unchecked, more than the " << 100.0 * margin << "% allowed";
+		suite.Fail("png", "corpus", "limits", message.str());
+	}
+}
+
+void RunPngBenchmarks(BenchmarkSuite& suite)
+{
+	std::vector<CorpusImage> corpus;
+	unsigned error = GeneratePngCorpus(corpus, suite.Large);
+	if (error)
+	{
+		suite.Fail("png", "corpus", "setup", lodepng_error_text(error));
+		return;
+	}
+
+	for (size_t i = 0; i < corpus.size(); i++)
+	{
+		std::cout << "png     " << corpus[i].Name << ": " << corpus[i].Width << "x" << corpus[i].Height << ", "
+			<< corpus[i].Pixels.size() << " raw bytes, " << corpus[i].Png.size() << " PNG bytes" << std::endl;
+	}
+	for (size_t i = 0; i < corpus.size(); i++)
+		benchmarkImage(suite, corpus[i]);
+
+	checkLimitsOverhead(suite, corpus);
+}
@@ -0,0 +1,278 @@
+#include "PngCorpus.h"
+
+// Std. Includes
+#include <sstream>
+
+// xorshift32, so the corpus doesn't depend on the rand() of the C runtime
+class CorpusRandom
+{
+public:
+	CorpusRandom(unsigned seed) : state(seed ? seed : 1) {}
+
+	unsigned Next()
+	{
+		this->state ^= this->state << 13;
+		this->state ^= this->state >> 17;
+		this->state ^= this->state << 5;
+		return this->state;
+	}
+	// Uniform enough in [0, count) for small counts
+	unsigned Range(unsigned count) { return this->Next() % count; }
+
+private:
+	unsigned state;
+};
+
+static unsigned clampByte(int value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : (unsigned)value;
+}
+
+// Smoothstep on 0..256 fixed point
+static int smoothStep(int t)
+{
+	return t * t * (768 - 2 * t) / 65536;
+}
+
+// Adds one octave of value noise to field: random lattice values every cell pixels, smoothly interpolated in between.
+// Integer math only, floats could round differently between compilers and the corpus has to be bit-identical.
+static void addNoiseOctave(std::vector<int>& field, unsigned w, unsigned h, unsigned cell, int amplitude, CorpusRandom& random)
+{
+	unsigned columns = w / cell + 2, rows = h / cell + 2;
+	std::vector<int> lattice(columns * rows);
+	for (size_t i = 0; i < lattice.size(); i++)
+		lattice[i] = (int)random.Range(2 * amplitude + 1) - amplitude;
+
+	for (unsigned y = 0; y < h; y++)
+	{
+		const int* row = &lattice[(y / cell) * columns];
+		int ty = smoothStep((int)((y % cell) * 256 / cell));
+		for (unsigned x = 0; x < w; x++)
+		{
+			unsigned cx = x / cell;
+			int tx = smoothStep((int)((x % cell) * 256 / cell));
+			int top = row[cx] * 256 + (row[cx + 1] - row[cx]) * tx;
+			int bottom = row[columns + cx] * 256 + (row[columns + cx + 1] - row[columns + cx]) * tx;
+			field[y * w + x] += (top * 256 + (bottom - top) * ty) / 65536;
+		}
+	}
+}
+
+// Smooth luminance with slowly drifting color tints, which is roughly what the filters and LZ77 see in photos.
+// Sensor grain is left to the callers, since its size depends on the bit depth.
+struct PhotoFields
+{
+	std::vector<int> Luma;
+	std::vector<int> TintRed;
+	std::vector<int> TintBlue;
+
+	PhotoFields(unsigned w, unsigned h, CorpusRandom& random) : Luma(w * h, 128), TintRed(w * h, 0), TintBlue(w * h, 0)
+	{
+		addNoiseOctave(this->Luma, w, h, 128, 70, random);
+		addNoiseOctave(this->Luma, w, h, 32, 35, random);
+		addNoiseOctave(this->Luma, w, h, 8, 12, random);
+		addNoiseOctave(this->TintRed, w, h, 256, 30, random);
+		addNoiseOctave(this->TintBlue, w, h, 256, 30, random);
+	}
+
+	int Red(size_t i) const { return this->Luma[i] + this->TintRed[i]; }
+	int Green(size_t i) const { return this->Luma[i]; }
+	int Blue(size_t i) const { return this->Luma[i] + this->TintBlue[i]; }
+};
+
+static void setColorMode(lodepng::State& state, LodePNGColorType colortype, unsigned bitdepth)
+{
+	state.info_raw.colortype = colortype;
+	state.info_raw.bitdepth = bitdepth;
+	state.info_png.color.colortype = colortype;
+	state.info_png.color.bitdepth = bitdepth;
+	// The corpus has to keep the color type it was generated in, or the stages would measure something else
+	state.encoder.auto_convert = 0;
+}
+
+static void makePhoto(CorpusImage& image, CorpusRandom& random)
+{
+	setColorMode(image.State, LCT_RGB, 8);
+	PhotoFields photo(image.Width, image.Height, random);
+	image.Pixels.resize(image.Width * image.Height * 3);
+	for (size_t i = 0; i < (size_t)image.Width * image.Height; i++)
+	{
+		int grain = (int)random.Range(7) - 3;
+		image.Pixels[i * 3 + 0] = (unsigned char)clampByte(photo.Red(i) + grain);
+		image.Pixels[i * 3 + 1] = (unsigned char)clampByte(photo.Green(i) + grain);
+		image.Pixels[i * 3 + 2] = (unsigned char)clampByte(photo.Blue(i) + grain);
+	}
+}
+
+static void fillRect(CorpusImage& image, unsigned x0, unsigned y0, unsigned x1, unsigned y1, const unsigned char* color)
+{
+	for (unsigned y = y0; y < y1 && y < image.Height; y++)
+	{
+		for (unsigned x = x0; x < x1 && x < image.Width; x++)
+		{
+			unsigned char* pixel = &image.Pixels[(y * image.Width + x) * 4];
+			for (unsigned c = 0; c < 4; c++)
+				pixel[c] = color[c];
+		}
+	}
+}
+
+// Panels of flat color with borders and rows of glyph-like blocks, some of them translucent
+static void makeFlatUI(CorpusImage& image, CorpusRandom& random)
+{
+	static const unsigned char colors[][4] = {
+		{ 240, 240, 240, 255 }, { 255, 255, 255, 255 }, { 52, 101, 164, 255 }, { 211, 215, 207, 255 },
+		{ 46, 52, 54, 255 }, { 115, 210, 22, 255 }, { 245, 121, 0, 255 }, { 32, 32, 32, 200 }
+	};
+	static const unsigned char border[4] = { 136, 138, 133, 255 };
+	static const unsigned char text[4] = { 20, 20, 20, 255 };
+
+	setColorMode(image.State, LCT_RGBA, 8);
+	image.Pixels.resize(image.Width * image.Height * 4);
+	fillRect(image, 0, 0, image.Width, image.Height, colors[0]);
+
+	unsigned panels = image.Width * image.Height / 16384 + 4;
+	for (unsigned p = 0; p < panels; p++)
+	{
+		unsigned w = 32 + random.Range(image.Width / 3), h = 24 + random.Range(image.Height / 4);
+		unsigned x = random.Range(image.Width), y = random.Range(image.Height);
+		fillRect(image, x, y, x + w, y + h, border);
+		fillRect(image, x + 1, y + 1, x + w - 1, y + h - 1, colors[1 + random.Range(7)]);
+
+		// Lines of text: 7 pixel high glyphs of 3 to 6 pixels with a pixel in between, and the odd word gap
+		for (unsigned line = y + 6; line + 7 < y + h - 4; line += 12)
+		{
+			unsigned end = x + w - 6 - random.Range(w / 2 + 1);
+			for (unsigned glyph = x + 6; glyph + 6 < end; )
+			{
+				unsigned glyphWidth = 3 + random.Range(4);
+				fillRect(image, glyph, line + random.Range(2), glyph + glyphWidth, line + 7, text);
+				glyph += glyphWidth + (random.Range(6) == 0 ? 5 : 1);
+			}
+		}
+	}
+}
+
+// Smooth ramps in every channel, rows differ only by a constant, the best case for the Up and Paeth filters
+static void makeGradient(CorpusImage& image, CorpusRandom&)
+{
+	setColorMode(image.State, LCT_RGBA, 8);
+	image.Pixels.resize(image.Width * image.Height * 4);
+	for (unsigned y = 0; y < image.Height; y++)
+	{
+		for (unsigned x = 0; x < image.Width; x++)
+		{
+			unsigned char* pixel = &image.Pixels[(y * image.Width + x) * 4];
+			pixel[0] = (unsigned char)(x * 255 / (image.Width - 1));
+			pixel[1] = (unsigned char)(y * 255 / (image.Height - 1));
+			pixel[2] = (unsigned char)(255 - (x + y) * 255 / (image.Width + image.Height - 2));
+			pixel[3] = 255;
+		}
+	}
+}
+
+// A photo quantized to a 6x6x6 color cube with ordered dithering, like an indexed asset from a paint program
+static void makePalette(CorpusImage& image, CorpusRandom& random)
+{
+	static const int bayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+
+	setColorMode(image.State, LCT_PALETTE, 8);
+	for (unsigned i = 0; i < 216; i++)
+	{
+		unsigned char r = (unsigned char)(i / 36 * 51), g = (unsigned char)(i / 6 % 6 * 51), b = (unsigned char)(i % 6 * 51);
+		lodepng_palette_add(&image.State.info_raw, r, g, b, 255);
+		lodepng_palette_add(&image.State.info_png.color, r, g, b, 255);
+	}
+
+	PhotoFields photo(image.Width, image.Height, random);
+	image.Pixels.resize(image.Width * image.Height);
+	for (unsigned y = 0; y < image.Height; y++)
+	{
+		for (unsigned x = 0; x < image.Width; x++)
+		{
+			size_t i = y * image.Width + x;
+			// Threshold in 0..50, a fraction of one step of the cube
+			int threshold = bayer[y % 4][x % 4] * 51 / 16;
+			unsigned r = (clampByte(photo.Red(i)) + threshold) / 51;
+			unsigned g = (clampByte(photo.Green(i)) + threshold) / 51;
+			unsigned b = (clampByte(photo.Blue(i)) + threshold) / 51;
+			image.Pixels[i] = (unsigned char)((r > 5 ? 5 : r) * 36 + (g > 5 ? 5 : g) * 6 + (b > 5 ? 5 : b));
+		}
+	}
+}
+
+// The photo at 16 bits per channel, big endian as PNG stores it. The grain covers the low byte entirely.
+static void makePhoto16(CorpusImage& image, CorpusRandom& random)
+{
+	setColorMode(image.State, LCT_RGB, 16);
+	PhotoFields photo(image.Width, image.Height, random);
+	image.Pixels.resize(image.Width * image.Height * 6);
+	for (size_t i = 0; i < (size_t)image.Width * image.Height; i++)
+	{
+		int channels[3] = { photo.Red(i), photo.Green(i), photo.Blue(i) };
+		for (unsigned c = 0; c < 3; c++)
+		{
+			int value = channels[c] * 257 + (int)random.Range(769) - 384;
+			unsigned word = value < 0 ? 0 : value > 65535 ? 65535 : (unsigned)value;
+			image.Pixels[i * 6 + c * 2 + 0] = (unsigned char)(word >> 8);
+			image.Pixels[i * 6 + c * 2 + 1] = (unsigned char)(word & 255);
+		}
+	}
+}
+
+// The photo with a soft alpha mask, Adam7 interlaced
+static void makeInterlaced(CorpusImage& image, CorpusRandom& random)
+{
+	setColorMode(image.State, LCT_RGBA, 8);
+	image.State.info_png.interlace_method = 1;
+	PhotoFields photo(image.Width, image.Height, random);
+	std::vector<int> alpha(image.Width * image.Height, 192);
+	addNoiseOctave(alpha, image.Width, image.Height, 64, 120, random);
+	image.Pixels.resize(image.Width * image.Height * 4);
+	for (size_t i = 0; i < (size_t)image.Width * image.Height; i++)
+	{
+		int grain = (int)random.Range(7) - 3;
+		image.Pixels[i * 4 + 0] = (unsigned char)clampByte(photo.Red(i) + grain);
+		image.Pixels[i * 4 + 1] = (unsigned char)clampByte(photo.Green(i) + grain);
+		image.Pixels[i * 4 + 2] = (unsigned char)clampByte(photo.Blue(i) + grain);
+		image.Pixels[i * 4 + 3] = (unsigned char)clampByte(alpha[i]);
+	}
+}
+
+unsigned GeneratePngCorpus(std::vector<CorpusImage>& corpus, bool large)
+{
+	typedef void (*Generator)(CorpusImage&, CorpusRandom&);
+	static const struct { const char* Name; Generator Generate; } kinds[] = {
+		{ "photo_rgb8", makePhoto },
+		{ "ui_rgba8", makeFlatUI },
+		{ "gradient_rgba8", makeGradient },
+		{ "palette8", makePalette },
+		{ "photo_rgb16", makePhoto16 },
+		{ "photo_rgba8_adam7", makeInterlaced }
+	};
+	static const unsigned sizes[] = { 256, 1024, 2048 };
+
+	unsigned sizeCount = large ? 3 : 2;
+	for (unsigned s = 0; s < sizeCount; s++)
+	{
+		for (unsigned k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+		{
+			std::ostringstream name;
+			name << kinds[k].Name << "_" << sizes[s];
+
+			corpus.push_back(CorpusImage());
+			CorpusImage& image = corpus.back();
+			image.Name = name.str();
+			image.Width = sizes[s];
+			image.Height = sizes[s];
+			// Seeded per image, so adding a kind or a size leaves the existing images unchanged
+			CorpusRandom random(2166136261u ^ (k * 16777619u) ^ (sizes[s] * 2654435761u));
+			kinds[k].Generate(image, random);
+
+			unsigned error = lodepng::encode(image.Png, image.Pixels, image.Width, image.Height, image.State);
+			if (error)
+				return error;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef PNGCORPUS_H
+#define PNGCORPUS_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+
+// 3rdparty
+#include "lodepng.h"
+
+// One generated test image, both as raw pixels and encoded
+struct CorpusImage
+{
+	// Kind, format and size, e.g. "photo_rgb8_1024". Keys the results, so it has to stay stable
+	std::string Name;
+	unsigned Width;
+	unsigned Height;
+	// info_raw and info_png.color are both the color type of Pixels, with the encoder settings Png was made with
+	lodepng::State State;
+	std::vector<unsigned char> Pixels;
+	std::vector<unsigned char> Png;
+};
+
+// Generates the corpus: photo-like, flat UI, gradient, palettized, 16-bit and interlaced images at 256 and
+// 1024 pixels square, plus 2048 if large is set. Everything derives from fixed seeds with integer math, so the
+// images are bit-identical on every platform. Returns a lodepng error code, 0 if all images encoded.
+unsigned GeneratePngCorpus(std::vector<CorpusImage>& corpus, bool large);
+#endif
@@ -0,0 +1,635 @@
+// Times the per-frame CPU work of drawing a scene, on generated scenes of a fixed random layout.
+//
+// Throughput is per byte of the work items:
+//   queue_sort   radix sorting the draw keys of a frame, as the render queue does before executing it
+//   std_sort     the same keys through std::stable_sort, which keeps equal keys in order as the radix sort does
+//   record       building the model matrix, sort key and draw packet of every object on one thread
+//   record_jobs  the same spread over a JobSystem with one worker per hardware thread, a command list per range
+//   spheres      frustum culling bounding spheres in SIMD batches into a list of the visible ones, per byte of bounds
+//   boxes        the same for axis aligned boxes
+// The culling stages have a _scalar twin testing one object at a time, and always run at 1M objects
+//   bvh_build        building the hierarchy over the boxes of the objects with the binned SAH, per byte of boxes
+//   bvh_insert       inserting them one by one into an empty tree instead
+//   bvh_refit        refitting after every object moved, with rotations; bvh_refit_only without them
+//   bvh_frustum      a frustum query, per byte of boxes a linear cull would read, so it compares with boxes
+//   bvh_overlap      1000 queries for the objects near a point. They only touch a few nodes each, so there is no
+//                    per byte figure, the queries metric gives the queries per second
+//   bvh_raycast      1000 ray casts against the spheres inside the boxes, likewise in queries per second
+//   occlusion_raster drawing a wall of occluder boxes into the occlusion buffer and its pyramid, per byte of
+//                    triangles, on the JobSystem
+//   occlusion_test   testing the boxes in view of 100k objects behind the wall against it, per byte of boxes
+//   clusters         assigning point lights to the 16x9x24 light clusters of the view on the JobSystem, per byte of
+//                    lights, after culling them against the frustum
+//   clusters_budget  the same keeping only the 256 lights covering the most of the view
+//   glm_models       glm::translate, glm::rotate and glm::scale of every object, per byte of matrices made
+//   rotations        the quaternions of the axis angles of every object in SIMD batches, per byte of axis angles
+//   compose          the model matrices of every object from its position, quaternion and scale in SIMD batches,
+//                    per byte of matrices made
+//   compose_jobs     the same spread over the JobSystem
+// The rotations and compose stages have a _scalar twin. The 10M transforms only run with the large inputs
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// GL Includes
+#include <glm\gtc\matrix_transform.hpp>
+
+// Project includes
+#include "Benchmark.h"
+#include "DrawKey.h"
+#include "CommandList.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include "Bvh.h"
+#include "OcclusionBuffer.h"
+#include "LightClusters.h"
+#include "Transforms.h"
+
+// Results of stages nothing else reads go here, so whole program optimization can't drop the call
+static volatile size_t sink;
+
+// A fixed seed keeps the scenes the same from run to run
+static unsigned nextRandom(unsigned& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+// The keys of a frame of count draws spread over a few layers, 64 programs and 1024 materials at random depths
+static void generateKeys(std::vector<SortItem>& items, size_t count)
+{
+	unsigned state = 1;
+	items.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned layer = nextRandom(state) % 8 == 0 ? 1 : 0;
+		float depth = (nextRandom(state) % 100000) * 0.001f;
+		items[i].Key = MakeDrawKey(layer, nextRandom(state) % 64, nextRandom(state) % 1024, depth, layer == 1);
+		items[i].Index = (unsigned)i;
+	}
+}
+
+static bool byKey(const SortItem& a, const SortItem& b)
+{
+	return a.Key < b.Key;
+}
+
+static void benchmarkQueue(BenchmarkSuite& suite, size_t count)
+{
+	const std::string group = "scene";
+	std::string name = "draws_" + std::to_string(count / 1000) + "k";
+	std::vector<SortItem> keys, items, scratch;
+	generateKeys(keys, count);
+	size_t bytes = count * sizeof(SortItem);
+
+	if (suite.IsEnabled(group, name, "queue_sort"))
+	{
+		items = keys;
+		RadixSort(items, scratch);
+		for (size_t i = 1; i < items.size(); i++)
+		{
+			if (items[i - 1].Key > items[i].Key || (items[i - 1].Key == items[i].Key && items[i - 1].Index > items[i].Index))
+			{
+				suite.Fail(group, name, "queue_sort", "keys not sorted");
+				return;
+			}
+		}
+	}
+	suite.Run(group, name, "queue_sort", bytes, [&]()
+	{
+		RadixSort(items, scratch);
+		sink = items[0].Index;
+		return 0u;
+	}, [&]() { items = keys; });
+
+	suite.Run(group, name, "std_sort", bytes, [&]()
+	{
+		std::stable_sort(items.begin(), items.end(), byKey);
+		sink = items[0].Index;
+		return 0u;
+	}, [&]() { items = keys; });
+}
+
+// Positions of count objects scattered over a 200 unit cube around the origin
+static void generatePositions(std::vector<glm::vec3>& positions, size_t count)
+{
+	unsigned state = 2;
+	positions.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		positions[i] = glm::vec3((nextRandom(state) % 20000) * 0.01f - 100.0f, (nextRandom(state) % 20000) * 0.01f - 100.0f,
+			(nextRandom(state) % 20000) * 0.01f - 100.0f);
+	}
+}
+
+static void benchmarkRecord(BenchmarkSuite& suite, size_t count, JobSystem& jobs)
+{
+	const std::string group = "scene";
+	std::string name = "draws_" + std::to_string(count / 1000) + "k";
+	std::vector<glm::vec3> positions;
+	generatePositions(positions, count);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	DrawPacket packet = DrawPacket();
+	packet.Mode = GL_TRIANGLES;
+	packet.Count = 36;
+
+	// What main records per box, a spinning cube at its position
+	CommandRecorder::Recorder record = [&](CommandList& list, size_t begin, size_t end)
+	{
+		DrawPacket draw = packet;
+		for (size_t i = begin; i < end; i++)
+		{
+			draw.Model = glm::rotate(glm::translate(glm::mat4(), positions[i]), 0.001f * i, glm::vec3(1.0f, 0.3f, 0.5f));
+			GLfloat depth = -(view * draw.Model[3]).z;
+			list.Submit(MakeDrawKey(0, (unsigned)i % 64, (unsigned)i % 1024, depth), draw);
+		}
+	};
+	size_t bytes = count * sizeof(DrawPacket);
+
+	JobSystem serial(1);
+	CommandRecorder single(serial);
+	suite.Run(group, name, "record", bytes, [&]()
+	{
+		single.Record(count, count, record);
+		sink = single.GetSize();
+		return 0u;
+	});
+
+	CommandRecorder recorder(jobs);
+	suite.Run(group, name, "record_jobs", bytes, [&]()
+	{
+		recorder.Record(count, 1024, record);
+		sink = recorder.GetSize();
+		return recorder.GetSize() == count ? 0u : 1u;
+	});
+}
+
+// Culls spheres and boxes of random sizes at the positions of generatePositions, with a camera outside the scene
+// looking at its middle
+static void benchmarkCulling(BenchmarkSuite& suite, size_t count)
+{
+	const std::string group = "scene";
+	std::string name = "cull_" + std::to_string(count / 1000) + "k";
+	std::vector<glm::vec3> positions;
+	generatePositions(positions, count);
+	SphereBounds spheres;
+	BoxBounds boxes;
+	unsigned state = 3;
+	for (size_t i = 0; i < count; i++)
+	{
+		float size = 0.5f + (nextRandom(state) % 1000) * 0.002f;
+		spheres.Add(positions[i], size);
+		boxes.Add(positions[i] - glm::vec3(size), positions[i] + glm::vec3(size * 0.5f));
+	}
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f) * view);
+	std::vector<unsigned> visible, expected;
+
+	// The SIMD lists have to be the ones the scalar tests make
+	const char* kinds[] = { "spheres", "boxes" };
+	size_t sizes[] = { 4 * sizeof(float), 6 * sizeof(float) };
+	for (int kind = 0; kind < 2; kind++)
+	{
+		std::string stage = kinds[kind];
+		if (!suite.IsEnabled(group, name, stage) && !suite.IsEnabled(group, name, stage + "_scalar"))
+			continue;
+		if (kind == 0)
+		{
+			CullSpheres(frustum, spheres, expected, false);
+			CullSpheres(frustum, spheres, visible);
+		}
+		else
+		{
+			CullBoxes(frustum, boxes, expected, false);
+			CullBoxes(frustum, boxes, visible);
+		}
+		if (visible != expected)
+		{
+			suite.Fail(group, name, stage, std::string("lists differ from the scalar ones, ") + GetCullingInstructions());
+			continue;
+		}
+		suite.Record(group, name, stage, "visible", 100.0 * visible.size() / count, "%");
+		for (int simd = 1; simd >= 0; simd--)
+		{
+			suite.Run(group, name, simd ? stage : stage + "_scalar", count * sizes[kind], [&]()
+			{
+				if (kind == 0)
+					CullSpheres(frustum, spheres, visible, simd != 0);
+				else
+					CullBoxes(frustum, boxes, visible, simd != 0);
+				sink = visible.size();
+				return 0u;
+			});
+		}
+	}
+}
+
+// The hierarchy over boxes of random sizes at the positions of generatePositions, moved by up to a unit a frame
+// Records how many queries per second the stage that just ran answered, from its best time
+static void recordQueryRate(BenchmarkSuite& suite, const std::string& group, const std::string& name, const std::string& stage,
+	size_t queries)
+{
+	const std::vector<BenchmarkResult>& results = suite.GetResults();
+	if (results.empty() || results.back().Stage != stage || !results.back().Error.empty() || results.back().BestSeconds <= 0.0)
+		return;
+	suite.Record(group, name, stage, "queries", queries / results.back().BestSeconds, "/s");
+}
+
+static void benchmarkBvh(BenchmarkSuite& suite, size_t count)
+{
+	const std::string group = "scene";
+	std::string name = "bvh_" + std::to_string(count / 1000) + "k";
+	std::vector<glm::vec3> positions;
+	generatePositions(positions, count);
+	std::vector<Aabb> boxes(count), moved(count);
+	unsigned state = 4;
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 extent = glm::vec3((float)(nextRandom(state) % 1000), (float)(nextRandom(state) % 1000), (float)(nextRandom(state) % 1000)) * 0.001f + 0.25f;
+		boxes[i] = Aabb(positions[i] - extent, positions[i] + extent);
+		glm::vec3 offset = glm::vec3((float)(nextRandom(state) % 2001), (float)(nextRandom(state) % 2001), (float)(nextRandom(state) % 2001)) * 0.001f - 1.0f;
+		moved[i] = Aabb(boxes[i].Min + offset, boxes[i].Max + offset);
+	}
+	size_t bytes = count * sizeof(Aabb);
+	Bvh tree;
+
+	suite.Run(group, name, "bvh_insert", bytes, [&]()
+	{
+		for (size_t i = 0; i < count; i++)
+			tree.Insert(boxes[i]);
+		sink = tree.GetNodeCount();
+		return 0u;
+	}, [&]() { tree.Clear(); });
+	if (tree.GetObjectCount() != count)
+	{
+		tree.Clear();
+		for (size_t i = 0; i < count; i++)
+			tree.Insert(boxes[i]);
+	}
+	suite.Record(group, name, "bvh_insert", "sah_cost", tree.GetCost(), "");
+
+	suite.Run(group, name, "bvh_build", bytes, [&]()
+	{
+		tree.Build();
+		sink = tree.GetNodeCount();
+		return 0u;
+	});
+	tree.Build();
+	suite.Record(group, name, "bvh_build", "sah_cost", tree.GetCost(), "");
+	suite.Record(group, name, "bvh_build", "height", tree.GetHeight(), "nodes");
+
+	// Every run moves all objects between their two places, the timed part is only the refit
+	bool flip = false;
+	std::function<void()> move = [&]()
+	{
+		flip = !flip;
+		for (size_t i = 0; i < count; i++)
+			tree.SetBounds((unsigned)i, flip ? moved[i] : boxes[i]);
+	};
+	suite.Run(group, name, "bvh_refit_only", bytes, [&]()
+	{
+		tree.Refit(false);
+		sink = tree.GetNodeCount();
+		return 0u;
+	}, move);
+	suite.Run(group, name, "bvh_refit", bytes, [&]()
+	{
+		tree.Refit();
+		sink = tree.GetNodeCount();
+		return 0u;
+	}, move);
+	suite.Record(group, name, "bvh_refit", "sah_cost", tree.GetCost(), "");
+	for (size_t i = 0; i < count; i++)
+		tree.SetBounds((unsigned)i, boxes[i]);
+	tree.Build();
+
+	// The queries have to find what a linear search finds
+	Frustum frustum(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f) *
+		glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	std::vector<unsigned> found;
+	if (suite.IsEnabled(group, name, "bvh_frustum"))
+	{
+		tree.QueryFrustum(frustum, found);
+		size_t expected = 0;
+		for (size_t i = 0; i < count; i++)
+			expected += frustum.TestBox(boxes[i].Min, boxes[i].Max) ? 1 : 0;
+		if (found.size() != expected)
+			suite.Fail(group, name, "bvh_frustum", "query differs from a linear cull");
+		else
+		{
+			suite.Run(group, name, "bvh_frustum", bytes, [&]()
+			{
+				tree.QueryFrustum(frustum, found);
+				sink = found.size();
+				return 0u;
+			});
+		}
+	}
+
+	const size_t queries = 1000;
+	std::vector<Aabb> regions(queries);
+	std::vector<glm::vec3> origins(queries), directions(queries);
+	for (size_t i = 0; i < queries; i++)
+	{
+		glm::vec3 center = positions[nextRandom(state) % count];
+		regions[i] = Aabb(center - 2.0f, center + 2.0f);
+		origins[i] = glm::vec3((nextRandom(state) % 20000) * 0.01f - 100.0f, (nextRandom(state) % 20000) * 0.01f - 100.0f, 150.0f);
+		directions[i] = glm::normalize(center - origins[i]);
+	}
+	suite.Run(group, name, "bvh_overlap", 0, [&]()
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < queries; i++)
+		{
+			tree.QueryOverlap(regions[i], found);
+			total += found.size();
+		}
+		sink = total;
+		return 0u;
+	});
+	recordQueryRate(suite, group, name, "bvh_overlap", queries);
+
+	// The sphere inside each box, so a hit is never outside the box the tree knows
+	Bvh::RayTest sphere;
+	glm::vec3 origin, direction;
+	sphere = [&](unsigned proxy, float& distance)
+	{
+		const Aabb& box = boxes[proxy];
+		glm::vec3 extent = (box.Max - box.Min) * 0.5f;
+		return RaySphere(origin, direction, box.GetCenter(), glm::min(extent.x, glm::min(extent.y, extent.z)), distance);
+	};
+	suite.Run(group, name, "bvh_raycast", 0, [&]()
+	{
+		size_t hits = 0;
+		RayHit hit;
+		for (size_t i = 0; i < queries; i++)
+		{
+			origin = origins[i];
+			direction = directions[i];
+			hits += tree.RayCast(origin, direction, 1000.0f, sphere, hit) ? 1 : 0;
+		}
+		sink = hits;
+		return 0u;
+	});
+	recordQueryRate(suite, group, name, "bvh_raycast", queries);
+}
+
+// The 36 corners of the triangles of a cube around the origin, 3 floats each
+static void generateCube(std::vector<GLfloat>& vertices)
+{
+	// Two triangles a face, the corner index bits are x, y and z
+	static const int faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+	static const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+	vertices.clear();
+	for (int f = 0; f < 6; f++)
+	{
+		for (int c = 0; c < 6; c++)
+		{
+			int corner = faces[f][corners[c]];
+			vertices.push_back(corner & 1 ? 0.5f : -0.5f);
+			vertices.push_back(corner & 2 ? 0.5f : -0.5f);
+			vertices.push_back(corner & 4 ? 0.5f : -0.5f);
+		}
+	}
+}
+
+static void benchmarkOcclusion(BenchmarkSuite& suite, size_t count, JobSystem& jobs)
+{
+	const std::string group = "scene";
+	std::string name = "occlusion_" + std::to_string(count / 1000) + "k";
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f) *
+		glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(viewProjection);
+
+	// A wall of 4x2 boxes of 10 units 40 in front of the camera, over most of the middle of the view
+	std::vector<GLfloat> cube;
+	generateCube(cube);
+	std::vector<glm::mat4> walls;
+	for (int y = 0; y < 2; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			glm::mat4 model = glm::translate(glm::mat4(), glm::vec3(-15.0f + 10.0f * x, -5.0f + 10.0f * y, 110.0f));
+			walls.push_back(glm::scale(model, glm::vec3(10.0f)));
+		}
+	}
+
+	// The objects in view, all behind the wall
+	std::vector<glm::vec3> positions;
+	generatePositions(positions, count);
+	std::vector<Aabb> boxes;
+	for (size_t i = 0; i < count; i++)
+	{
+		Aabb box(positions[i] - 0.5f, positions[i] + 0.5f);
+		if (frustum.TestBox(box.Min, box.Max))
+			boxes.push_back(box);
+	}
+
+	OcclusionBuffer occlusion(jobs);
+	std::function<void()> draw = [&]()
+	{
+		occlusion.BeginFrame(viewProjection);
+		for (size_t i = 0; i < walls.size(); i++)
+			occlusion.AddOccluder(&cube[0], 3, 36, walls[i]);
+		occlusion.Rasterize();
+	};
+	suite.Run(group, name, "occlusion_raster", walls.size() * cube.size() * sizeof(GLfloat), [&]()
+	{
+		draw();
+		sink = occlusion.GetTriangleCount();
+		return 0u;
+	});
+
+	// A box right behind the middle of the wall is hidden, one in front of it is not
+	draw();
+	if (occlusion.IsVisible(Aabb(glm::vec3(-1.0f, -1.0f, 100.0f), glm::vec3(1.0f, 1.0f, 102.0f))) ||
+		!occlusion.IsVisible(Aabb(glm::vec3(-1.0f, -1.0f, 120.0f), glm::vec3(1.0f, 1.0f, 122.0f))))
+	{
+		suite.Fail(group, name, "occlusion_test", "the wall hides the wrong boxes");
+		return;
+	}
+	suite.Run(group, name, "occlusion_test", boxes.size() * sizeof(Aabb), [&]()
+	{
+		occlusion.Tested = 0;
+		occlusion.Occluded = 0;
+		size_t visible = 0;
+		for (size_t i = 0; i < boxes.size(); i++)
+			visible += occlusion.IsVisible(boxes[i]) ? 1 : 0;
+		sink = visible;
+		return 0u;
+	});
+	suite.Record(group, name, "occlusion_test", "in_view", (double)boxes.size(), "objects");
+	suite.Record(group, name, "occlusion_test", "occluded", occlusion.Tested ? 100.0 * occlusion.Occluded / occlusion.Tested : 0.0, "%");
+}
+
+static void benchmarkClusters(BenchmarkSuite& suite, size_t count, JobSystem& jobs)
+{
+	const std::string group = "scene";
+	std::string name = "lights_" + std::to_string(count / 1000) + "k";
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+
+	// Lights reaching about 5 units, at most as many in a cluster as there are lights
+	std::vector<glm::vec3> positions;
+	generatePositions(positions, count);
+	LightClusters clusters(jobs, 16, 9, 24, (unsigned)count);
+	for (size_t i = 0; i < count; i++)
+		clusters.AddPointLight(positions[i], glm::vec3(0.0f), glm::vec3(0.1f), glm::vec3(0.1f), 1.0f, 1.0f, 1.8f);
+
+	suite.Run(group, name, "clusters", count * sizeof(ClusterLight), [&]()
+	{
+		clusters.Assign(view, projection);
+		sink = clusters.GetIndices().size();
+		return 0u;
+	});
+
+	// Every light in view is in the cluster its center is in, found the way Clusters.txt finds a fragment's
+	clusters.Assign(view, projection);
+	glm::uvec4 cells = clusters.GetCount();
+	const std::vector<GLuint>& grid = clusters.GetGrid();
+	const std::vector<GLuint>& indices = clusters.GetIndices();
+	const std::vector<unsigned>& selection = clusters.GetSelection();
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec4 clip = projection * view * glm::vec4(positions[i], 1.0f);
+		float depth = clip.w;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		if (depth <= 0.1f || glm::abs(ndc.x) >= 1.0f || glm::abs(ndc.y) >= 1.0f || ndc.z >= 1.0f)
+			continue;
+		unsigned x = (unsigned)((ndc.x * 0.5f + 0.5f) * cells.x), y = (unsigned)((ndc.y * 0.5f + 0.5f) * cells.y);
+		unsigned z = (unsigned)glm::clamp(std::log(depth) * clusters.GetSliceScale() + clusters.GetSliceBias(), 0.0f, cells.z - 1.0f);
+		unsigned cluster = x + cells.x * (y + cells.y * z);
+		const GLuint* first = indices.data() + grid[2 * cluster];
+		const GLuint* last = first + grid[2 * cluster + 1];
+		GLuint selected = (GLuint)(std::lower_bound(selection.begin(), selection.end(), (unsigned)i) - selection.begin());
+		if (selected == selection.size() || selection[selected] != i || std::find(first, last, selected) == last)
+		{
+			suite.Fail(group, name, "clusters", "a light is missing from the cluster it is in");
+			return;
+		}
+	}
+	suite.Record(group, name, "clusters", "per_cluster", (double)indices.size() / clusters.GetClusterCount(), "lights");
+	suite.Record(group, name, "clusters", "culled", (double)clusters.Culled, "lights");
+
+	clusters.MaxLights = 256;
+	suite.Run(group, name, "clusters_budget", count * sizeof(ClusterLight), [&]()
+	{
+		clusters.Assign(view, projection);
+		sink = clusters.GetIndices().size();
+		return 0u;
+	});
+	clusters.Assign(view, projection);
+	suite.Record(group, name, "clusters_budget", "per_cluster", (double)indices.size() / clusters.GetClusterCount(), "lights");
+	suite.Record(group, name, "clusters_budget", "dropped", (double)clusters.Dropped, "lights");
+}
+
+// Spinning objects of random sizes at the positions of generatePositions, each about its own axis
+static void benchmarkTransforms(BenchmarkSuite& suite, size_t count, JobSystem& jobs)
+{
+	const std::string group = "scene";
+	std::string name = "transforms_" + std::to_string(count / 1000) + "k";
+	// 10M transforms take 1.8 GB, only made if a stage of them runs
+	const char* stages[] = { "glm_models", "rotations", "rotations_scalar", "compose", "compose_scalar", "compose_jobs" };
+	bool enabled = false;
+	for (int i = 0; i < 6; i++)
+		enabled = enabled || suite.IsEnabled(group, name, stages[i]);
+	if (!enabled)
+		return;
+	std::vector<glm::vec3> positions;
+	generatePositions(positions, count);
+	TransformArrays transforms;
+	AxisAngleArrays rotations;
+	unsigned state = 4;
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 scale((nextRandom(state) % 1000) * 0.002f + 0.5f, (nextRandom(state) % 1000) * 0.002f + 0.5f,
+			(nextRandom(state) % 1000) * 0.002f + 0.5f);
+		transforms.Add(positions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), scale);
+		glm::vec3 axis((nextRandom(state) % 1000) * 0.002f - 1.0f, (nextRandom(state) % 1000) * 0.002f - 1.0f, 1.0f);
+		rotations.Add(axis, (nextRandom(state) % 10000) * 0.01f - 50.0f);
+	}
+	std::vector<glm::mat4> models(count), expected(count);
+	size_t modelBytes = count * sizeof(glm::mat4);
+
+	// What main did per object before the batches
+	std::function<void(glm::mat4*)> glmModels = [&](glm::mat4* out)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 axis(rotations.AxisX[i], rotations.AxisY[i], rotations.AxisZ[i]);
+			glm::vec3 scale(transforms.ScaleX[i], transforms.ScaleY[i], transforms.ScaleZ[i]);
+			out[i] = glm::scale(glm::rotate(glm::translate(glm::mat4(), positions[i]), rotations.Angle[i], axis), scale);
+		}
+	};
+	glmModels(&expected[0]);
+	suite.Run(group, name, "glm_models", modelBytes, [&]()
+	{
+		glmModels(&models[0]);
+		sink = (size_t)models[count - 1][3][0];
+		return 0u;
+	});
+
+	// The SIMD matrices have to be the ones glm makes, up to rounding
+	SetRotations(transforms, rotations, 0, count);
+	ComposeTransforms(transforms, 0, count, &models[0]);
+	float error = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			error = std::max(error, glm::length(models[i][c] - expected[i][c]) / std::max(glm::length(expected[i][c]), 1.0f));
+	}
+	if (error > 1.0e-5f)
+	{
+		suite.Fail(group, name, "compose", std::string("matrices differ from glm's, ") + GetTransformInstructions());
+		return;
+	}
+	suite.Record(group, name, "compose", "relative_error", error * 1.0e6, "ppm");
+
+	for (int simd = 1; simd >= 0; simd--)
+	{
+		suite.Run(group, name, simd ? "rotations" : "rotations_scalar", count * 4 * sizeof(float), [&]()
+		{
+			SetRotations(transforms, rotations, 0, count, simd != 0);
+			sink = (size_t)transforms.RotationW[count - 1];
+			return 0u;
+		});
+		suite.Run(group, name, simd ? "compose" : "compose_scalar", modelBytes, [&]()
+		{
+			ComposeTransforms(transforms, 0, count, &models[0], simd != 0);
+			sink = (size_t)models[count - 1][3][0];
+			return 0u;
+		});
+	}
+	suite.Run(group, name, "compose_jobs", modelBytes, [&]()
+	{
+		jobs.ParallelFor(count, 16384, [&](size_t begin, size_t end)
+		{
+			ComposeTransforms(transforms, begin, end, &models[0]);
+		});
+		sink = (size_t)models[count - 1][3][0];
+		return 0u;
+	});
+}
+
+void RunSceneBenchmarks(BenchmarkSuite& suite)
+{
+	JobSystem jobs;
+	size_t counts[] = { 10000, 100000, 1000000 };
+	for (int i = 0; i < (suite.Large ? 3 : 2); i++)
+	{
+		benchmarkQueue(suite, counts[i]);
+		benchmarkRecord(suite, counts[i], jobs);
+		benchmarkBvh(suite, counts[i]);
+	}
+	benchmarkCulling(suite, 1000000);
+	benchmarkOcclusion(suite, 100000, jobs);
+	size_t lightCounts[] = { 1000, 4000, 16000 };
+	for (int i = 0; i < (suite.Large ? 3 : 2); i++)
+		benchmarkClusters(suite, lightCounts[i], jobs);
+	size_t transformCounts[] = { 10000, 100000, 1000000, 10000000 };
+	for (int i = 0; i < (suite.Large ? 4 : 3); i++)
+		benchmarkTransforms(suite, transformCounts[i], jobs);
+}
@@ -0,0 +1,223 @@
+// Times the texture preparation the engine does at load time, on the RGBA8 form of the generated corpus.
+//
+// Throughput is per RGBA8 input image:
+//   mip_box, mip_kaiser  building the whole mip chain with that filter, sRGB aware
+//   mip_box_linear       the box filter for textures that hold data instead of colors, without the sRGB conversions
+//   cache_hit            loading the texture from the texture cache with mips, touching every page of it once.
+//                        Compare with png decode: this is what a run costs once the texture is baked
+//   bc1, bc3, bc7        block compressing level 0 on one thread, each with its PSNR against the input.
+//                        BC1 drops alpha, so its PSNR is over RGB only
+//   bc7_jobs             bc7 spread over a JobSystem with one worker per hardware thread
+//   atlas                packing the whole corpus into a texture atlas and drawing its pages, per byte of all the
+//                        images together, with the share of the page area the images cover
+
+// Std. Includes
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// 3rdparty
+#include "lodepng.h"
+
+// Project includes
+#include "Benchmark.h"
+#include "PngCorpus.h"
+#include "MipChain.h"
+#include "TextureCache.h"
+#include "BlockCompression.h"
+#include "JobSystem.h"
+#include "TextureAtlas.h"
+
+// Results of stages nothing else reads go here, so whole program optimization can't drop the call
+static volatile size_t sink;
+
+// Scratch directory for the PNGs and cache files of the cache stages
+static const char* cacheDirectory = "BenchmarkCache";
+
+static void benchmarkMips(BenchmarkSuite& suite, const std::string& name, const std::vector<unsigned char>& rgba, unsigned w, unsigned h)
+{
+	const std::string group = "texture";
+	size_t bytes = rgba.size();
+	MipChain chain;
+
+	suite.Run(group, name, "mip_box", bytes, [&]()
+	{
+		chain.Build(&rgba[0], w, h, MIP_BOX, true);
+		sink = chain.GetByteSize();
+		return 0u;
+	});
+
+	suite.Run(group, name, "mip_box_linear", bytes, [&]()
+	{
+		chain.Build(&rgba[0], w, h, MIP_BOX, false);
+		sink = chain.GetByteSize();
+		return 0u;
+	});
+
+	suite.Run(group, name, "mip_kaiser", bytes, [&]()
+	{
+		chain.Build(&rgba[0], w, h, MIP_KAISER, true);
+		sink = chain.GetByteSize();
+		return 0u;
+	});
+}
+
+static void benchmarkCache(BenchmarkSuite& suite, const CorpusImage& image, size_t bytes)
+{
+	const std::string group = "texture";
+	if (!suite.IsEnabled(group, image.Name, "cache_hit"))
+		return;
+
+	// The first load bakes the cache file, the timed ones all map it
+	TextureCache cache(cacheDirectory);
+	BakedTexture texture;
+	std::string path = std::string(cacheDirectory) + "/" + image.Name + ".png";
+	if (lodepng::save_file(image.Png, path) || !cache.Load(texture, path))
+	{
+		suite.Fail(group, image.Name, "cache_hit", "texture not baked");
+		return;
+	}
+
+	suite.Run(group, image.Name, "cache_hit", bytes, [&]()
+	{
+		if (!cache.Load(texture, path))
+			return 1u;
+		unsigned sum = 0;
+		for (size_t i = 0; i < texture.Levels.size(); i++)
+		{
+			for (size_t offset = 0; offset < texture.Levels[i].Size; offset += 4096)
+				sum += texture.Levels[i].Data[offset];
+		}
+		sink = sum;
+		texture.Release();
+		return 0u;
+	});
+}
+
+// Peak signal to noise ratio over the first channels channels of two RGBA8 images, in dB. Identical images get 99.
+static double psnr(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, unsigned channels)
+{
+	double error = 0.0;
+	size_t count = 0;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (i % 4 >= channels)
+			continue;
+		double d = (double)a[i] - b[i];
+		error += d * d;
+		count++;
+	}
+	if (error == 0.0 || count == 0)
+		return 99.0;
+	return 10.0 * log10(255.0 * 255.0 / (error / count));
+}
+
+static void benchmarkBlocks(BenchmarkSuite& suite, const std::string& name, const std::vector<unsigned char>& rgba, unsigned w, unsigned h,
+	JobSystem& jobs)
+{
+	const std::string group = "texture";
+	const Texture_Format formats[] = { TEXTURE_BC1, TEXTURE_BC3, TEXTURE_BC7 };
+	const char* stages[] = { "bc1", "bc3", "bc7" };
+	std::vector<unsigned char> blocks, decoded;
+
+	for (int i = 0; i < 3; i++)
+	{
+		Texture_Format format = formats[i];
+		if (suite.IsEnabled(group, name, stages[i]))
+		{
+			CompressBlocks(blocks, &rgba[0], w, h, format);
+			if (!DecompressBlocks(decoded, &blocks[0], w, h, format))
+			{
+				suite.Fail(group, name, stages[i], "blocks not decoded");
+				continue;
+			}
+			suite.Record(group, name, stages[i], "psnr", psnr(rgba, decoded, format == TEXTURE_BC1 ? 3 : 4), "dB");
+		}
+		suite.Run(group, name, stages[i], rgba.size(), [&]()
+		{
+			CompressBlocks(blocks, &rgba[0], w, h, format);
+			return 0u;
+		});
+	}
+
+	suite.Run(group, name, "bc7_jobs", rgba.size(), [&]()
+	{
+		CompressBlocks(blocks, &rgba[0], w, h, TEXTURE_BC7, &jobs);
+		return 0u;
+	});
+}
+
+static void benchmarkAtlas(BenchmarkSuite& suite, const std::vector<CorpusImage>& corpus, const std::vector<std::vector<unsigned char> >& images)
+{
+	const std::string group = "texture";
+	TextureAtlas atlas;
+	size_t bytes = 0;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		atlas.Add(corpus[i].Name, &images[i][0], corpus[i].Width, corpus[i].Height);
+		bytes += images[i].size();
+	}
+
+	if (suite.IsEnabled(group, "corpus", "atlas"))
+	{
+		if (!atlas.Pack())
+		{
+			suite.Fail(group, "corpus", "atlas", "image larger than a page");
+			return;
+		}
+		suite.Record(group, "corpus", "atlas", "efficiency", atlas.GetEfficiency() * 100.0, "%");
+		suite.Record(group, "corpus", "atlas", "pages", (double)atlas.Pages.size(), "pages");
+	}
+	suite.Run(group, "corpus", "atlas", bytes, [&]()
+	{
+		atlas.Pack();
+		return 0u;
+	});
+}
+
+void RunTextureBenchmarks(BenchmarkSuite& suite)
+{
+	std::vector<CorpusImage> corpus;
+	unsigned error = GeneratePngCorpus(corpus, suite.Large);
+	if (error)
+	{
+		suite.Fail("texture", "corpus", "setup", lodepng_error_text(error));
+		return;
+	}
+
+#ifdef _WIN32
+	CreateDirectoryA(cacheDirectory, 0);
+#else
+	mkdir(cacheDirectory, 0755);
+#endif
+
+	JobSystem jobs;
+	std::vector<std::vector<unsigned char> > images;
+	images.reserve(corpus.size());
+	LodePNGColorMode rgbaMode;
+	lodepng_color_mode_init(&rgbaMode);
+	for (size_t i = 0; i < corpus.size(); i++)
+	{
+		const CorpusImage& image = corpus[i];
+		std::vector<unsigned char> rgba((size_t)image.Width * image.Height * 4);
+		error = lodepng_convert(&rgba[0], &image.Pixels[0], &rgbaMode, &image.State.info_png.color, image.Width, image.Height);
+		if (error)
+		{
+			suite.Fail("texture", image.Name, "setup", lodepng_error_text(error));
+			continue;
+		}
+		benchmarkMips(suite, image.Name, rgba, image.Width, image.Height);
+		benchmarkCache(suite, image, rgba.size());
+		benchmarkBlocks(suite, image.Name, rgba, image.Width, image.Height, jobs);
+		images.push_back(rgba);
+	}
+	lodepng_color_mode_cleanup(&rgbaMode);
+	if (images.size() == corpus.size())
+		benchmarkAtlas(suite, corpus, images);
+}
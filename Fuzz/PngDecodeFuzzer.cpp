@@ -0,0 +1,80 @@
+// libFuzzer harness for the lodepng decoder, with the decoder limits set the way a loader of untrusted PNGs would.
+// Besides crashes it catches unbounded work: with the limits set, no input may need more than a few hundred MB.
+//
+// Build (clang only, libFuzzer doesn't exist for MSVC 2013):
+//   clang++ -g -O1 -fsanitize=fuzzer,address,undefined -I../GLFWOpenGLTest PngDecodeFuzzer.cpp ../GLFWOpenGLTest/lodepng.cpp -o PngDecodeFuzzer
+// Run, seeded with the PNGs of the project:
+//   mkdir corpus && cp ../GLFWOpenGLTest/*.png corpus && ./PngDecodeFuzzer corpus -rss_limit_mb=512 -timeout=5
+//
+// Defining PNGFUZZ_STANDALONE_MAIN adds a main that runs the files given on the command line through the harness
+// once, so crashes the fuzzer found can be replayed with any compiler.
+
+// Std. Includes
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#ifdef PNGFUZZ_STANDALONE_MAIN
+#include <iostream>
+#endif
+
+// 3rdparty
+#include "lodepng.h"
+
+static void setLimits(lodepng::State& state)
+{
+	state.decoder.max_pixels = 4096 * 4096;
+	state.decoder.max_chunks = 4096;
+	state.decoder.zlibsettings.max_output_size = 128 * 1024 * 1024;
+	// Mutated inputs almost never have valid checksums, without this the fuzzer never gets past the chunk reader
+	state.decoder.ignore_crc = 1;
+	state.decoder.zlibsettings.ignore_adler32 = 1;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size)
+{
+	std::vector<unsigned char> png(data, data + size);
+	std::vector<unsigned char> image;
+	unsigned w, h;
+
+	lodepng::State state;
+	setLimits(state);
+	if (lodepng::decode(image, w, h, state, png))
+		return 0;
+
+	// Whatever decodes fully has to give the same rows through the row index, the partial decoder has its own inflate loop
+	lodepng::RowIndex index;
+	lodepng::State indexState;
+	setLimits(indexState);
+	if (lodepng_row_index_build(&index, &indexState, &png[0], png.size(), 4096))
+		return 0;
+
+	unsigned y0 = h / 3, y1 = h - h / 4;
+	std::vector<unsigned char> rows;
+	unsigned rowsW, rowsH;
+	lodepng::State rowsState;
+	setLimits(rowsState);
+	if (lodepng::decode_rows(rows, rowsW, rowsH, rowsState, png, y0, y1, &index))
+		abort();
+	size_t offset = (size_t)y0 * w * 4;
+	if (rows.size() != (size_t)(y1 - y0) * w * 4 || (!rows.empty() && memcmp(&rows[0], &image[offset], rows.size()) != 0))
+		abort();
+	return 0;
+}
+
+#ifdef PNGFUZZ_STANDALONE_MAIN
+int main(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::vector<unsigned char> file;
+		if (lodepng::load_file(file, argv[i]))
+		{
+			std::cout << "ERROR::PNGFUZZ::FILE_NOT_READ " << argv[i] << std::endl;
+			return 1;
+		}
+		LLVMFuzzerTestOneInput(file.empty() ? 0 : &file[0], file.size());
+		std::cout << argv[i] << ": ok" << std::endl;
+	}
+	return 0;
+}
+#endif
@@ -0,0 +1,606 @@
+#include "BlockCompression.h"
+
+// Std. Includes
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BLOCKCOMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+// Project includes
+#include "JobSystem.h"
+
+// The 16 texels of a block as floats in 0..255, one array per channel so four texels fill an SSE register
+struct Block
+{
+	float Channel[4][16];
+};
+
+// Interpolation weights of BC7's 4 bit indices, out of 64
+static const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Where every palette entry lies on the way from the first endpoint to the second, by index
+static const float bc1Positions[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+static const float alphaPositions[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+// Channel weights of the palette fits: color only, alpha only, everything
+static const float colorWeights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+static const float alphaWeights[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+static const float rgbaWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+static size_t blockBytes(Texture_Format format)
+{
+	return format == TEXTURE_BC1 ? 8 : 16;
+}
+
+size_t GetTextureLevelSize(Texture_Format format, unsigned width, unsigned height)
+{
+	if (format == TEXTURE_RGBA8)
+		return (size_t)width * height * 4;
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+static float clampChannel(float value)
+{
+	return std::min(std::max(value, 0.0f), 255.0f);
+}
+
+static void loadBlock(Block& block, const unsigned char* pixels, unsigned width, unsigned height, unsigned bx, unsigned by)
+{
+	for (unsigned i = 0; i < 16; i++)
+	{
+		unsigned x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+		const unsigned char* pixel = &pixels[((size_t)y * width + x) * 4];
+		for (int c = 0; c < 4; c++)
+			block.Channel[c][i] = pixel[c];
+	}
+}
+
+// Picks the closest palette entry for every texel, by squared distance with the channels weighted.
+// Returns the summed weighted squared error of the block. This is where the encoders spend their time, so with SSE2
+// it compares four texels against an entry at once.
+static float fitPalette(const Block& block, const float (*palette)[4], unsigned count, const float weights[4], unsigned char indices[16])
+{
+#ifdef BLOCKCOMPRESSION_SSE2
+	__m128 total = _mm_setzero_ps();
+	for (unsigned i = 0; i < 16; i += 4)
+	{
+		__m128 texel[4];
+		for (int c = 0; c < 4; c++)
+			texel[c] = _mm_loadu_ps(&block.Channel[c][i]);
+		__m128 best = _mm_set1_ps(3.0e38f), bestIndex = _mm_setzero_ps();
+		for (unsigned k = 0; k < count; k++)
+		{
+			__m128 distance = _mm_setzero_ps();
+			for (int c = 0; c < 4; c++)
+			{
+				__m128 d = _mm_sub_ps(texel[c], _mm_set1_ps(palette[k][c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(d, d), _mm_set1_ps(weights[c])));
+			}
+			__m128 closer = _mm_cmplt_ps(distance, best);
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)k)), _mm_andnot_ps(closer, bestIndex));
+		}
+		total = _mm_add_ps(total, best);
+		float index[4];
+		_mm_storeu_ps(index, bestIndex);
+		for (int j = 0; j < 4; j++)
+			indices[i + j] = (unsigned char)index[j];
+	}
+	float sums[4];
+	_mm_storeu_ps(sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	float total = 0.0f;
+	for (unsigned i = 0; i < 16; i++)
+	{
+		float best = 3.0e38f;
+		indices[i] = 0;
+		for (unsigned k = 0; k < count; k++)
+		{
+			float distance = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				float d = block.Channel[c][i] - palette[k][c];
+				distance += d * d * weights[c];
+			}
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (unsigned char)k;
+			}
+		}
+		total += best;
+	}
+	return total;
+#endif
+}
+
+// Endpoints of a first guess: the extremes of the texels along their principal axis over the first channels channels
+static void axisEndpoints(const Block& block, unsigned channels, float e0[4], float e1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned c = 0; c < 4; c++)
+	{
+		for (unsigned i = 0; i < 16; i++)
+			mean[c] += block.Channel[c][i];
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = { { 0.0f } };
+	for (unsigned i = 0; i < 16; i++)
+	{
+		for (unsigned a = 0; a < channels; a++)
+		{
+			for (unsigned b = 0; b < channels; b++)
+				covariance[a][b] += (block.Channel[a][i] - mean[a]) * (block.Channel[b][i] - mean[b]);
+		}
+	}
+
+	// Power iteration, starting from the row of the channel that varies most so the start can't be orthogonal to the axis
+	unsigned start = 0;
+	for (unsigned c = 1; c < channels; c++)
+	{
+		if (covariance[c][c] > covariance[start][start])
+			start = c;
+	}
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned c = 0; c < channels; c++)
+		axis[c] = covariance[start][c];
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, largest = 0.0f;
+		for (unsigned a = 0; a < channels; a++)
+		{
+			for (unsigned b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			largest = std::max(largest, fabsf(next[a]));
+		}
+		if (largest == 0.0f)
+			break;
+		for (unsigned c = 0; c < channels; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	float length = 0.0f;
+	for (unsigned c = 0; c < channels; c++)
+		length += axis[c] * axis[c];
+	length = sqrtf(length);
+	float low = 0.0f, high = 0.0f;
+	if (length > 0.0f)
+	{
+		for (unsigned c = 0; c < channels; c++)
+			axis[c] /= length;
+		low = 3.0e38f;
+		high = -3.0e38f;
+		for (unsigned i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (unsigned c = 0; c < channels; c++)
+				t += (block.Channel[c][i] - mean[c]) * axis[c];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+	}
+	for (unsigned c = 0; c < 4; c++)
+	{
+		e0[c] = clampChannel(mean[c] + low * axis[c]);
+		e1[c] = clampChannel(mean[c] + high * axis[c]);
+	}
+}
+
+// Least squares endpoints for the indices found, positions[index] being how far from e0 to e1 the palette entry is.
+// Returns false if the indices don't tell the endpoints apart, all texels on one entry.
+static bool refineEndpoints(const Block& block, const unsigned char indices[16], const float* positions, float e0[4], float e1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned i = 0; i < 16; i++)
+	{
+		float t = positions[indices[i]], s = 1.0f - t;
+		aa += s * s;
+		ab += s * t;
+		bb += t * t;
+		for (int c = 0; c < 4; c++)
+		{
+			ax[c] += s * block.Channel[c][i];
+			bx[c] += t * block.Channel[c][i];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = clampChannel((ax[c] * bb - bx[c] * ab) / determinant);
+		e1[c] = clampChannel((bx[c] * aa - ax[c] * ab) / determinant);
+	}
+	return true;
+}
+
+static unsigned short packRgb565(const float color[4])
+{
+	unsigned r = (unsigned)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned g = (unsigned)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned b = (unsigned)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(unsigned packed, int rgb[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// The colors a BC1 color block decodes to. BC3 always decodes its color in four color mode, BC1 switches to
+// three colors and black if the first endpoint isn't the larger one.
+static void bc1Palette(unsigned c0, unsigned c1, bool fourColors, float palette[4][4])
+{
+	int a[3], b[3];
+	unpackRgb565(c0, a);
+	unpackRgb565(c1, b);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[0][c] = (float)a[c];
+		palette[1][c] = (float)b[c];
+		if (fourColors || c0 > c1)
+		{
+			palette[2][c] = (float)((2 * a[c] + b[c]) / 3);
+			palette[3][c] = (float)((a[c] + 2 * b[c]) / 3);
+		}
+		else
+		{
+			palette[2][c] = (float)((a[c] + b[c]) / 2);
+			palette[3][c] = 0.0f;
+		}
+	}
+	for (int k = 0; k < 4; k++)
+		palette[k][3] = 255.0f;
+}
+
+// The alpha values a BC3 alpha block decodes to, eight steps if the first endpoint is larger, else six plus 0 and 255
+static void alphaPalette(int a0, int a1, float palette[8][4])
+{
+	memset(palette, 0, sizeof(float) * 8 * 4);
+	palette[0][3] = (float)a0;
+	palette[1][3] = (float)a1;
+	if (a0 > a1)
+	{
+		for (int i = 2; i < 8; i++)
+			palette[i][3] = (float)(((8 - i) * a0 + (i - 1) * a1) / 7);
+	}
+	else
+	{
+		for (int i = 2; i < 6; i++)
+			palette[i][3] = (float)(((6 - i) * a0 + (i - 1) * a1) / 5);
+		palette[7][3] = 255.0f;
+	}
+}
+
+// Writes an 8 byte BC1 color block, always in four color mode so BC3 can use it too
+static void encodeBc1Color(const Block& block, unsigned char* out)
+{
+	float e0[4], e1[4];
+	axisEndpoints(block, 3, e0, e1);
+
+	float bestError = 3.0e38f;
+	unsigned best0 = 0, best1 = 0;
+	unsigned char bestIndices[16] = { 0 };
+	for (int iteration = 0; iteration < 3; iteration++)
+	{
+		unsigned c0 = packRgb565(e0), c1 = packRgb565(e1);
+		// The larger endpoint has to come first for four colors. The palette is fitted again after the swap anyway
+		if (c0 < c1)
+			std::swap(c0, c1);
+		float palette[4][4];
+		bc1Palette(c0, c1, true, palette);
+		unsigned char indices[16];
+		float error = fitPalette(block, palette, c0 == c1 ? 1 : 4, colorWeights, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			best0 = c0;
+			best1 = c1;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (c0 == c1 || error == 0.0f || !refineEndpoints(block, indices, bc1Positions, e0, e1))
+			break;
+	}
+
+	unsigned bits = 0;
+	for (unsigned i = 0; i < 16; i++)
+		bits |= (unsigned)bestIndices[i] << (i * 2);
+	out[0] = (unsigned char)best0;
+	out[1] = (unsigned char)(best0 >> 8);
+	out[2] = (unsigned char)best1;
+	out[3] = (unsigned char)(best1 >> 8);
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+// Writes the 8 byte alpha block of BC3, in its eight step mode
+static void encodeBc3Alpha(const Block& block, unsigned char* out)
+{
+	float e0[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, e1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	e0[3] = *std::max_element(block.Channel[3], block.Channel[3] + 16);
+	e1[3] = *std::min_element(block.Channel[3], block.Channel[3] + 16);
+
+	float bestError = 3.0e38f;
+	int best0 = 0, best1 = 0;
+	unsigned char bestIndices[16] = { 0 };
+	for (int iteration = 0; iteration < 2; iteration++)
+	{
+		int a0 = (int)(e0[3] + 0.5f), a1 = (int)(e1[3] + 0.5f);
+		if (a0 < a1)
+			std::swap(a0, a1);
+		float palette[8][4];
+		alphaPalette(a0, a1, palette);
+		unsigned char indices[16];
+		float error = fitPalette(block, palette, a0 == a1 ? 1 : 8, alphaWeights, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			best0 = a0;
+			best1 = a1;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (a0 == a1 || error == 0.0f || !refineEndpoints(block, indices, alphaPositions, e0, e1))
+			break;
+	}
+
+	unsigned long long bits = 0;
+	for (unsigned i = 0; i < 16; i++)
+		bits |= (unsigned long long)bestIndices[i] << (i * 3);
+	out[0] = (unsigned char)best0;
+	out[1] = (unsigned char)best1;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+// Endpoint of BC7 mode 6: 7 bits per channel, with a p-bit shared by the channels as the lowest bit
+static void quantizeBc7(const float endpoint[4], int pbit, int quantized[4], int value[4])
+{
+	for (int c = 0; c < 4; c++)
+	{
+		quantized[c] = std::min(std::max((int)floorf((endpoint[c] - pbit) / 2.0f + 0.5f), 0), 127);
+		value[c] = (quantized[c] << 1) | pbit;
+	}
+}
+
+static void bc7Palette(const int e0[4], const int e1[4], float palette[16][4])
+{
+	for (int k = 0; k < 16; k++)
+	{
+		for (int c = 0; c < 4; c++)
+			palette[k][c] = (float)(((64 - bc7Weights[k]) * e0[c] + bc7Weights[k] * e1[c] + 32) >> 6);
+	}
+}
+
+// Appends bits to a block, lowest bit first, the way BC7 blocks are laid out
+static void writeBits(unsigned char* out, unsigned& position, unsigned value, unsigned bits)
+{
+	for (unsigned b = 0; b < bits; b++, position++)
+	{
+		if ((value >> b) & 1)
+			out[position >> 3] |= (unsigned char)(1 << (position & 7));
+	}
+}
+
+static unsigned readBits(const unsigned char* in, unsigned& position, unsigned bits)
+{
+	unsigned value = 0;
+	for (unsigned b = 0; b < bits; b++, position++)
+		value |= (unsigned)((in[position >> 3] >> (position & 7)) & 1) << b;
+	return value;
+}
+
+// Writes a 16 byte BC7 block in mode 6: one RGBA line with 16 steps. The modes with partitions would do better on
+// blocks with several distinct colors, but mode 6 is the one that holds up on every kind of block, alpha included.
+// Every p-bit combination is tried for every pair of endpoints.
+static void encodeBc7(const Block& block, unsigned char* out)
+{
+	static const float positions[16] = {
+		0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+		34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64 };
+	float e0[4], e1[4];
+	axisEndpoints(block, 4, e0, e1);
+
+	float bestError = 3.0e38f;
+	int best0[4] = { 0 }, best1[4] = { 0 }, bestP0 = 0, bestP1 = 0;
+	unsigned char bestIndices[16] = { 0 };
+	for (int iteration = 0; iteration < 3; iteration++)
+	{
+		float iterationError = 3.0e38f;
+		unsigned char iterationIndices[16] = { 0 };
+		for (int pbits = 0; pbits < 4; pbits++)
+		{
+			int q0[4], q1[4], v0[4], v1[4];
+			quantizeBc7(e0, pbits & 1, q0, v0);
+			quantizeBc7(e1, pbits >> 1, q1, v1);
+			float palette[16][4];
+			bc7Palette(v0, v1, palette);
+			unsigned char indices[16];
+			float error = fitPalette(block, palette, 16, rgbaWeights, indices);
+			if (error < iterationError)
+			{
+				iterationError = error;
+				memcpy(iterationIndices, indices, sizeof(indices));
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(best0, q0, sizeof(q0));
+				memcpy(best1, q1, sizeof(q1));
+				bestP0 = pbits & 1;
+				bestP1 = pbits >> 1;
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+		}
+		if (bestError == 0.0f || !refineEndpoints(block, iterationIndices, positions, e0, e1))
+			break;
+	}
+
+	// The highest bit of the first index isn't stored and has to be 0, mirror the line if it isn't
+	if (bestIndices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(best0[c], best1[c]);
+		std::swap(bestP0, bestP1);
+		for (int i = 0; i < 16; i++)
+			bestIndices[i] = (unsigned char)(15 - bestIndices[i]);
+	}
+
+	memset(out, 0, 16);
+	unsigned position = 0;
+	writeBits(out, position, 1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writeBits(out, position, (unsigned)best0[c], 7);
+		writeBits(out, position, (unsigned)best1[c], 7);
+	}
+	writeBits(out, position, (unsigned)bestP0, 1);
+	writeBits(out, position, (unsigned)bestP1, 1);
+	writeBits(out, position, bestIndices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writeBits(out, position, bestIndices[i], 4);
+}
+
+void CompressBlocks(std::vector<unsigned char>& out, const unsigned char* pixels, unsigned width, unsigned height, Texture_Format format,
+	JobSystem* jobs)
+{
+	if (format == TEXTURE_RGBA8)
+	{
+		out.assign(pixels, pixels + (size_t)width * height * 4);
+		return;
+	}
+
+	unsigned blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t bytes = blockBytes(format);
+	out.assign(GetTextureLevelSize(format, width, height), 0);
+	if (out.empty())
+		return;
+	unsigned char* blocks = &out[0];
+
+	// Every row of blocks writes its own part of out, so rows can go to different threads without any locking
+	auto compressRows = [=](size_t begin, size_t end)
+	{
+		Block block;
+		for (size_t by = begin; by < end; by++)
+		{
+			for (unsigned bx = 0; bx < blocksX; bx++)
+			{
+				loadBlock(block, pixels, width, height, bx, (unsigned)by);
+				unsigned char* block0 = blocks + ((size_t)by * blocksX + bx) * bytes;
+				if (format == TEXTURE_BC1)
+					encodeBc1Color(block, block0);
+				else if (format == TEXTURE_BC3)
+				{
+					encodeBc3Alpha(block, block0);
+					encodeBc1Color(block, block0 + 8);
+				}
+				else
+					encodeBc7(block, block0);
+			}
+		}
+	};
+	if (jobs && blocksY > 1)
+		jobs->ParallelFor(blocksY, 1, compressRows);
+	else
+		compressRows(0, blocksY);
+}
+
+static void decodeBc1Color(const unsigned char* in, bool fourColors, unsigned char texels[16][4])
+{
+	unsigned c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+	unsigned bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned)in[7] << 24);
+	float palette[4][4];
+	bc1Palette(c0, c1, fourColors, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			texels[i][c] = (unsigned char)palette[(bits >> (i * 2)) & 3][c];
+	}
+}
+
+static void decodeBc3Alpha(const unsigned char* in, unsigned char texels[16][4])
+{
+	float palette[8][4];
+	alphaPalette(in[0], in[1], palette);
+	unsigned long long bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= (unsigned long long)in[2 + i] << (i * 8);
+	for (int i = 0; i < 16; i++)
+		texels[i][3] = (unsigned char)palette[(bits >> (i * 3)) & 7][3];
+}
+
+static bool decodeBc7(const unsigned char* in, unsigned char texels[16][4])
+{
+	if ((in[0] & 0x7F) != 0x40)
+		return false;
+	unsigned position = 7;
+	int e0[4], e1[4];
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = (int)readBits(in, position, 7) << 1;
+		e1[c] = (int)readBits(in, position, 7) << 1;
+	}
+	int p0 = (int)readBits(in, position, 1), p1 = (int)readBits(in, position, 1);
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] |= p0;
+		e1[c] |= p1;
+	}
+	float palette[16][4];
+	bc7Palette(e0, e1, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned index = readBits(in, position, i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++)
+			texels[i][c] = (unsigned char)palette[index][c];
+	}
+	return true;
+}
+
+bool DecompressBlocks(std::vector<unsigned char>& out, const unsigned char* blocks, unsigned width, unsigned height, Texture_Format format)
+{
+	if (format == TEXTURE_RGBA8)
+	{
+		out.assign(blocks, blocks + (size_t)width * height * 4);
+		return true;
+	}
+
+	out.assign((size_t)width * height * 4, 0);
+	unsigned blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t bytes = blockBytes(format);
+	bool supported = true;
+	for (unsigned by = 0; by < blocksY; by++)
+	{
+		for (unsigned bx = 0; bx < blocksX; bx++)
+		{
+			const unsigned char* in = blocks + ((size_t)by * blocksX + bx) * bytes;
+			unsigned char texels[16][4];
+			memset(texels, 255, sizeof(texels));
+			if (format == TEXTURE_BC1)
+				decodeBc1Color(in, false, texels);
+			else if (format == TEXTURE_BC3)
+			{
+				decodeBc3Alpha(in, texels);
+				decodeBc1Color(in + 8, true, texels);
+			}
+			else if (!decodeBc7(in, texels))
+				supported = false;
+
+			for (unsigned i = 0; i < 16; i++)
+			{
+				unsigned x = bx * 4 + i % 4, y = by * 4 + i / 4;
+				if (x < width && y < height)
+					memcpy(&out[((size_t)y * width + x) * 4], texels[i], 4);
+			}
+		}
+	}
+	return supported;
+}
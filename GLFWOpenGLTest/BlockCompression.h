@@ -0,0 +1,34 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+// Std. Includes
+#include <vector>
+#include <cstddef>
+
+class JobSystem;
+
+// Pixel formats a texture can be stored and uploaded in. The BC formats store 4x4 texel blocks and need
+// EXT_texture_compression_s3tc (BC1, BC3) or ARB_texture_compression_bptc (BC7) at upload.
+enum Texture_Format {
+	// 4 bytes per texel, uncompressed
+	TEXTURE_RGBA8,
+	// Half a byte per texel, RGB only, alpha is dropped
+	TEXTURE_BC1,
+	// A byte per texel, BC1 color plus separately interpolated alpha
+	TEXTURE_BC3,
+	// A byte per texel, RGBA with higher precision endpoints and 16 interpolation steps, the best quality of the three
+	TEXTURE_BC7
+};
+
+// Bytes of one level of width x height texels in the format, partial blocks at the edges count as whole ones
+size_t GetTextureLevelSize(Texture_Format format, unsigned width, unsigned height);
+
+// Compresses RGBA8 pixels with tightly packed rows into format. The rows of blocks are spread over jobs if given,
+// otherwise the calling thread does all of them. Texels outside the image in edge blocks repeat the edge.
+void CompressBlocks(std::vector<unsigned char>& out, const unsigned char* pixels, unsigned width, unsigned height, Texture_Format format,
+	JobSystem* jobs = 0);
+
+// Decompresses blocks back to RGBA8, to measure what the compression lost. BC1 decodes with opaque alpha.
+// Of BC7 only mode 6 decodes, which is all CompressBlocks writes; returns false if other modes were found.
+bool DecompressBlocks(std::vector<unsigned char>& out, const unsigned char* blocks, unsigned width, unsigned height, Texture_Format format);
+#endif
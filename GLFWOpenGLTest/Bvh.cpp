@@ -0,0 +1,633 @@
+#include "Bvh.h"
+
+// Std. Includes
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <cfloat>
+
+// GL Includes
+#include <glm\gtx\intersect.hpp>
+
+// Buckets the centers are sorted into along the split axis when building. More find slightly better splits for longer
+static const int buildBins = 16;
+
+Aabb::Aabb() : Min(0.0f), Max(0.0f)
+{
+}
+
+Aabb::Aabb(const glm::vec3& min, const glm::vec3& max) : Min(min), Max(max)
+{
+}
+
+Aabb Aabb::Merge(const Aabb& a, const Aabb& b)
+{
+	return Aabb(glm::min(a.Min, b.Min), glm::max(a.Max, b.Max));
+}
+
+float Aabb::GetArea() const
+{
+	glm::vec3 size = this->Max - this->Min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool Aabb::Overlaps(const Aabb& other) const
+{
+	return this->Min.x <= other.Max.x && this->Max.x >= other.Min.x && this->Min.y <= other.Max.y && this->Max.y >= other.Min.y
+		&& this->Min.z <= other.Max.z && this->Max.z >= other.Min.z;
+}
+
+Aabb Aabb::Transform(const glm::mat4& transform) const
+{
+	// The new half extents are the old ones through the absolute values of the rotation and scale
+	glm::vec3 center = glm::vec3(transform * glm::vec4(this->GetCenter(), 1.0f));
+	glm::vec3 extent = (this->Max - this->Min) * 0.5f, reach(0.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			reach[i] += std::fabs(transform[j][i]) * extent[j];
+	}
+	return Aabb(center - reach, center + reach);
+}
+
+// Bound to references by the containers, so it needs its storage
+const unsigned Bvh::nullNode;
+
+Bvh::Bvh() : root(nullNode), objectCount(0)
+{
+}
+
+void Bvh::Clear()
+{
+	this->nodes.clear();
+	this->freeNodes.clear();
+	this->leaves.clear();
+	this->freeProxies.clear();
+	this->root = nullNode;
+	this->objectCount = 0;
+}
+
+unsigned Bvh::allocateNode()
+{
+	unsigned index;
+	if (!this->freeNodes.empty())
+	{
+		index = this->freeNodes.back();
+		this->freeNodes.pop_back();
+	}
+	else
+	{
+		index = (unsigned)this->nodes.size();
+		this->nodes.push_back(Node());
+	}
+	Node& node = this->nodes[index];
+	node.Parent = node.Left = node.Right = nullNode;
+	node.Proxy = 0;
+	return index;
+}
+
+void Bvh::freeNode(unsigned index)
+{
+	this->freeNodes.push_back(index);
+}
+
+unsigned Bvh::findSibling(const Aabb& bounds) const
+{
+	// Walks down while pairing with a child costs less than pairing here. Whatever the choice, every node on the
+	// way grows around the new box, which both children pay for equally
+	unsigned index = this->root;
+	while (!this->nodes[index].IsLeaf())
+	{
+		const Node& node = this->nodes[index];
+		float area = node.Bounds.GetArea();
+		float combined = Aabb::Merge(node.Bounds, bounds).GetArea();
+		float cost = 2.0f * combined;
+		float inherited = 2.0f * (combined - area);
+
+		float childCosts[2];
+		unsigned children[2] = { node.Left, node.Right };
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = this->nodes[children[i]];
+			float merged = Aabb::Merge(child.Bounds, bounds).GetArea();
+			childCosts[i] = (child.IsLeaf() ? merged : merged - child.Bounds.GetArea()) + inherited;
+		}
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+	return index;
+}
+
+unsigned Bvh::Insert(const Aabb& bounds)
+{
+	unsigned proxy;
+	if (!this->freeProxies.empty())
+	{
+		proxy = this->freeProxies.back();
+		this->freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = (unsigned)this->leaves.size();
+		this->leaves.push_back(nullNode);
+	}
+	unsigned leaf = this->allocateNode();
+	this->nodes[leaf].Bounds = bounds;
+	this->nodes[leaf].Proxy = proxy;
+	this->leaves[proxy] = leaf;
+	this->objectCount++;
+	if (this->root == nullNode)
+	{
+		this->root = leaf;
+		return proxy;
+	}
+
+	// The new leaf and its sibling share a new parent where the sibling was
+	unsigned sibling = this->findSibling(bounds);
+	unsigned oldParent = this->nodes[sibling].Parent;
+	unsigned parent = this->allocateNode();
+	Node& node = this->nodes[parent];
+	node.Parent = oldParent;
+	node.Left = sibling;
+	node.Right = leaf;
+	this->nodes[sibling].Parent = parent;
+	this->nodes[leaf].Parent = parent;
+	if (oldParent == nullNode)
+		this->root = parent;
+	else if (this->nodes[oldParent].Left == sibling)
+		this->nodes[oldParent].Left = parent;
+	else
+		this->nodes[oldParent].Right = parent;
+	this->refitUp(parent);
+	return proxy;
+}
+
+void Bvh::Remove(unsigned proxy)
+{
+	unsigned leaf = this->leaves[proxy];
+	this->leaves[proxy] = nullNode;
+	this->freeProxies.push_back(proxy);
+	this->objectCount--;
+	this->freeNode(leaf);
+	if (leaf == this->root)
+	{
+		this->root = nullNode;
+		return;
+	}
+
+	// The sibling takes the place of the parent
+	unsigned parent = this->nodes[leaf].Parent;
+	unsigned grandParent = this->nodes[parent].Parent;
+	unsigned sibling = this->nodes[parent].Left == leaf ? this->nodes[parent].Right : this->nodes[parent].Left;
+	this->nodes[sibling].Parent = grandParent;
+	this->freeNode(parent);
+	if (grandParent == nullNode)
+	{
+		this->root = sibling;
+		return;
+	}
+	if (this->nodes[grandParent].Left == parent)
+		this->nodes[grandParent].Left = sibling;
+	else
+		this->nodes[grandParent].Right = sibling;
+	this->refitUp(grandParent);
+}
+
+void Bvh::SetBounds(unsigned proxy, const Aabb& bounds)
+{
+	this->nodes[this->leaves[proxy]].Bounds = bounds;
+}
+
+const Aabb& Bvh::GetBounds(unsigned proxy) const
+{
+	return this->nodes[this->leaves[proxy]].Bounds;
+}
+
+void Bvh::fit(unsigned index)
+{
+	Node& node = this->nodes[index];
+	node.Bounds = Aabb::Merge(this->nodes[node.Left].Bounds, this->nodes[node.Right].Bounds);
+}
+
+void Bvh::refitUp(unsigned index)
+{
+	while (index != nullNode)
+	{
+		this->fit(index);
+		this->rotate(index);
+		index = this->nodes[index].Parent;
+	}
+}
+
+void Bvh::rotate(unsigned index)
+{
+	const Node& node = this->nodes[index];
+	if (node.IsLeaf())
+		return;
+	// A child can swap places with either child of its sibling. The box of the index node stays the same, the
+	// sibling's box shrinks or grows, keep the swap that shrinks it most
+	unsigned children[2] = { node.Left, node.Right };
+	float bestGain = 0.0f;
+	unsigned bestChild = nullNode, bestGrandChild = nullNode;
+	for (int i = 0; i < 2; i++)
+	{
+		const Node& other = this->nodes[children[1 - i]];
+		if (other.IsLeaf())
+			continue;
+		const Aabb& bounds = this->nodes[children[i]].Bounds;
+		float area = other.Bounds.GetArea();
+		float gains[2] = {
+			area - Aabb::Merge(bounds, this->nodes[other.Right].Bounds).GetArea(),
+			area - Aabb::Merge(bounds, this->nodes[other.Left].Bounds).GetArea()
+		};
+		unsigned grandChildren[2] = { other.Left, other.Right };
+		for (int j = 0; j < 2; j++)
+		{
+			if (gains[j] > bestGain)
+			{
+				bestGain = gains[j];
+				bestChild = children[i];
+				bestGrandChild = grandChildren[j];
+			}
+		}
+	}
+	if (bestChild == nullNode)
+		return;
+
+	unsigned other = this->nodes[bestGrandChild].Parent;
+	Node& parent = this->nodes[index];
+	if (parent.Left == bestChild)
+		parent.Left = bestGrandChild;
+	else
+		parent.Right = bestGrandChild;
+	Node& sibling = this->nodes[other];
+	if (sibling.Left == bestGrandChild)
+		sibling.Left = bestChild;
+	else
+		sibling.Right = bestChild;
+	this->nodes[bestGrandChild].Parent = index;
+	this->nodes[bestChild].Parent = other;
+	this->fit(other);
+}
+
+void Bvh::Refit(bool rotate)
+{
+	if (this->root == nullNode)
+		return;
+	// Parents come before their children in breadth first order, backwards every child is fitted before its parent
+	this->order.clear();
+	this->order.push_back(this->root);
+	for (size_t i = 0; i < this->order.size(); i++)
+	{
+		const Node& node = this->nodes[this->order[i]];
+		if (!node.IsLeaf())
+		{
+			this->order.push_back(node.Left);
+			this->order.push_back(node.Right);
+		}
+	}
+	for (size_t i = this->order.size(); i-- > 0;)
+	{
+		unsigned index = this->order[i];
+		if (this->nodes[index].IsLeaf())
+			continue;
+		this->fit(index);
+		if (rotate)
+			this->rotate(index);
+	}
+}
+
+void Bvh::Build()
+{
+	std::vector<BuildItem> items;
+	items.reserve(this->objectCount);
+	for (size_t i = 0; i < this->leaves.size(); i++)
+	{
+		if (this->leaves[i] == nullNode)
+			continue;
+		BuildItem item;
+		item.Bounds = this->nodes[this->leaves[i]].Bounds;
+		item.Center = item.Bounds.GetCenter();
+		item.Proxy = (unsigned)i;
+		items.push_back(item);
+	}
+	this->nodes.clear();
+	this->freeNodes.clear();
+	this->root = nullNode;
+	if (items.empty())
+		return;
+	this->nodes.reserve(items.size() * 2 - 1);
+	this->root = this->build(items, 0, items.size(), nullNode);
+}
+
+unsigned Bvh::build(std::vector<BuildItem>& items, size_t begin, size_t end, unsigned parent)
+{
+	unsigned index = (unsigned)this->nodes.size();
+	this->nodes.push_back(Node());
+	this->nodes[index].Parent = parent;
+	this->nodes[index].Left = this->nodes[index].Right = nullNode;
+	if (end - begin == 1)
+	{
+		this->nodes[index].Bounds = items[begin].Bounds;
+		this->nodes[index].Proxy = items[begin].Proxy;
+		this->leaves[items[begin].Proxy] = index;
+		return index;
+	}
+
+	// Splits along the axis the centers spread most on, at the bin boundary with the least area times objects
+	glm::vec3 centerMin = items[begin].Center, centerMax = items[begin].Center;
+	for (size_t i = begin + 1; i < end; i++)
+	{
+		centerMin = glm::min(centerMin, items[i].Center);
+		centerMax = glm::max(centerMax, items[i].Center);
+	}
+	glm::vec3 spread = centerMax - centerMin;
+	int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+	size_t middle = (begin + end) / 2;
+	if (spread[axis] > 0.0f && end - begin > 2)
+	{
+		float binScale = buildBins / spread[axis] * 0.9999f;
+		float axisMin = centerMin[axis];
+		size_t counts[buildBins] = { 0 };
+		Aabb bounds[buildBins];
+		for (int i = 0; i < buildBins; i++)
+			bounds[i] = Aabb(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+		for (size_t i = begin; i < end; i++)
+		{
+			const BuildItem& item = items[i];
+			int bin = (int)((item.Center[axis] - axisMin) * binScale);
+			bounds[bin].Min = glm::min(bounds[bin].Min, item.Bounds.Min);
+			bounds[bin].Max = glm::max(bounds[bin].Max, item.Bounds.Max);
+			counts[bin]++;
+		}
+		// The cost of everything left of a boundary, swept from the left, then added to the right side's
+		// Empty bins change nothing and are skipped
+		float leftCosts[buildBins - 1];
+		Aabb sweep = bounds[0];
+		size_t count = 0;
+		float cost = 0.0f;
+		for (int i = 0; i < buildBins - 1; i++)
+		{
+			if (counts[i])
+			{
+				sweep = Aabb::Merge(sweep, bounds[i]);
+				count += counts[i];
+				cost = sweep.GetArea() * count;
+			}
+			leftCosts[i] = cost;
+		}
+		float bestCost = 0.0f;
+		int bestSplit = -1;
+		sweep = bounds[buildBins - 1];
+		count = 0;
+		cost = 0.0f;
+		for (int i = buildBins - 1; i > 0; i--)
+		{
+			if (!counts[i])
+				continue;
+			sweep = Aabb::Merge(sweep, bounds[i]);
+			count += counts[i];
+			cost = sweep.GetArea() * count;
+			if (count < end - begin && (bestSplit < 0 || leftCosts[i - 1] + cost < bestCost))
+			{
+				bestCost = leftCosts[i - 1] + cost;
+				bestSplit = i;
+			}
+		}
+		if (bestSplit > 0)
+		{
+			BuildItem* split = std::partition(&items[0] + begin, &items[0] + end, [=](const BuildItem& item)
+			{
+				return (int)((item.Center[axis] - axisMin) * binScale) < bestSplit;
+			});
+			middle = split - &items[0];
+		}
+	}
+
+	unsigned left = this->build(items, begin, middle, index);
+	unsigned right = this->build(items, middle, end, index);
+	this->nodes[index].Left = left;
+	this->nodes[index].Right = right;
+	this->fit(index);
+	return index;
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned>& proxies) const
+{
+	proxies.clear();
+	if (this->root == nullNode)
+		return;
+	glm::vec3 absolute[PLANE_COUNT];
+	for (int p = 0; p < PLANE_COUNT; p++)
+		absolute[p] = glm::abs(glm::vec3(frustum.Planes[p]));
+
+	// Every node carries the planes its box still crosses. A box inside a plane has all its descendants inside too
+	std::vector<std::pair<unsigned, unsigned> > stack;
+	stack.reserve(64);
+	stack.push_back(std::make_pair(this->root, (1u << PLANE_COUNT) - 1));
+	while (!stack.empty())
+	{
+		unsigned index = stack.back().first, planes = stack.back().second;
+		stack.pop_back();
+		const Node& node = this->nodes[index];
+		bool outside = false;
+		if (planes)
+		{
+			glm::vec3 center = node.Bounds.GetCenter(), extent = (node.Bounds.Max - node.Bounds.Min) * 0.5f;
+			for (int p = 0; p < PLANE_COUNT && !outside; p++)
+			{
+				if (!(planes & (1u << p)))
+					continue;
+				const glm::vec4& plane = frustum.Planes[p];
+				float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				float reach = glm::dot(absolute[p], extent);
+				if (distance < -reach)
+					outside = true;
+				else if (distance >= reach)
+					planes &= ~(1u << p);
+			}
+		}
+		if (outside)
+			continue;
+		if (node.IsLeaf())
+			proxies.push_back(node.Proxy);
+		else
+		{
+			stack.push_back(std::make_pair(node.Right, planes));
+			stack.push_back(std::make_pair(node.Left, planes));
+		}
+	}
+}
+
+void Bvh::QueryOverlap(const Aabb& bounds, std::vector<unsigned>& proxies) const
+{
+	proxies.clear();
+	if (this->root == nullNode)
+		return;
+	std::vector<unsigned> stack;
+	stack.reserve(64);
+	stack.push_back(this->root);
+	while (!stack.empty())
+	{
+		const Node& node = this->nodes[stack.back()];
+		stack.pop_back();
+		if (!node.Bounds.Overlaps(bounds))
+			continue;
+		if (node.IsLeaf())
+			proxies.push_back(node.Proxy);
+		else
+		{
+			stack.push_back(node.Right);
+			stack.push_back(node.Left);
+		}
+	}
+}
+
+// Where the ray enters the box, clipped to 0..maxDistance. False if it misses the box within that
+static bool rayEnters(const Aabb& bounds, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance, float& entry)
+{
+	entry = 0.0f;
+	float exit = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// Parallel to the slab only the origin decides, an origin on one of its planes would give 0 * inf = NaN
+		if (std::isinf(inverse[axis]))
+		{
+			if (origin[axis] < bounds.Min[axis] || origin[axis] > bounds.Max[axis])
+				return false;
+			continue;
+		}
+		float toMin = (bounds.Min[axis] - origin[axis]) * inverse[axis], toMax = (bounds.Max[axis] - origin[axis]) * inverse[axis];
+		entry = std::max(entry, std::min(toMin, toMax));
+		exit = std::min(exit, std::max(toMin, toMax));
+	}
+	return entry <= exit;
+}
+
+bool Bvh::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const RayTest& test, RayHit& hit) const
+{
+	float entry;
+	glm::vec3 inverse = 1.0f / direction;
+	if (this->root == nullNode || !rayEnters(this->nodes[this->root].Bounds, origin, inverse, maxDistance, entry))
+		return false;
+	bool found = false;
+	float best = maxDistance;
+	std::vector<std::pair<unsigned, float> > stack;
+	stack.reserve(64);
+	stack.push_back(std::make_pair(this->root, entry));
+	while (!stack.empty())
+	{
+		unsigned index = stack.back().first;
+		float distance = stack.back().second;
+		stack.pop_back();
+		if (distance > best)
+			continue;
+		const Node& node = this->nodes[index];
+		if (node.IsLeaf())
+		{
+			float objectDistance;
+			if (test(node.Proxy, objectDistance) && objectDistance >= 0.0f && objectDistance <= best)
+			{
+				best = objectDistance;
+				hit.Proxy = node.Proxy;
+				hit.Distance = objectDistance;
+				found = true;
+			}
+			continue;
+		}
+		// The nearer child goes on top, its hits may save visiting the other
+		float leftEntry, rightEntry;
+		bool left = rayEnters(this->nodes[node.Left].Bounds, origin, inverse, best, leftEntry);
+		bool right = rayEnters(this->nodes[node.Right].Bounds, origin, inverse, best, rightEntry);
+		if (left && right && leftEntry < rightEntry)
+		{
+			stack.push_back(std::make_pair(node.Right, rightEntry));
+			stack.push_back(std::make_pair(node.Left, leftEntry));
+		}
+		else
+		{
+			if (left)
+				stack.push_back(std::make_pair(node.Left, leftEntry));
+			if (right)
+				stack.push_back(std::make_pair(node.Right, rightEntry));
+		}
+	}
+	return found;
+}
+
+unsigned Bvh::GetHeight() const
+{
+	if (this->root == nullNode)
+		return 0;
+	unsigned height = 0;
+	std::vector<std::pair<unsigned, unsigned> > stack;
+	stack.push_back(std::make_pair(this->root, 1u));
+	while (!stack.empty())
+	{
+		const Node& node = this->nodes[stack.back().first];
+		unsigned depth = stack.back().second;
+		stack.pop_back();
+		height = std::max(height, depth);
+		if (!node.IsLeaf())
+		{
+			stack.push_back(std::make_pair(node.Left, depth + 1));
+			stack.push_back(std::make_pair(node.Right, depth + 1));
+		}
+	}
+	return height;
+}
+
+float Bvh::GetCost() const
+{
+	// The leaves are the same in every tree over the objects, only the inner nodes count
+	if (this->root == nullNode || this->nodes[this->root].IsLeaf())
+		return 0.0f;
+	float rootArea = this->nodes[this->root].Bounds.GetArea();
+	if (rootArea <= 0.0f)
+		return 0.0f;
+	float total = 0.0f;
+	std::vector<unsigned> stack(1, this->root);
+	while (!stack.empty())
+	{
+		const Node& node = this->nodes[stack.back()];
+		stack.pop_back();
+		if (node.IsLeaf())
+			continue;
+		total += node.Bounds.GetArea();
+		stack.push_back(node.Left);
+		stack.push_back(node.Right);
+	}
+	return total / rootArea;
+}
+
+bool RaySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& center, float radius, float& distance)
+{
+	return glm::intersectRaySphere(origin, direction, center, radius * radius, distance);
+}
+
+bool RayTriangles(const glm::vec3& origin, const glm::vec3& direction, const GLfloat* vertices, GLuint stride,
+	GLuint vertexCount, const glm::mat4& model, float& distance)
+{
+	bool found = false;
+	for (GLuint i = 0; i + 2 < vertexCount; i += 3)
+	{
+		glm::vec3 corners[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const GLfloat* position = vertices + (i + c) * stride;
+			corners[c] = glm::vec3(model * glm::vec4(position[0], position[1], position[2], 1.0f));
+		}
+		// glm only hits triangles facing the ray, so each is tried both ways round. z of the result is the
+		// distance along the ray, x and y where on the triangle it is hit
+		glm::vec3 hit;
+		bool hits = glm::intersectRayTriangle(origin, direction, corners[0], corners[1], corners[2], hit)
+			|| glm::intersectRayTriangle(origin, direction, corners[0], corners[2], corners[1], hit);
+		if (hits && (!found || hit.z < distance))
+		{
+			distance = hit.z;
+			found = true;
+		}
+	}
+	return found;
+}
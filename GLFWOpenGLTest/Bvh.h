@@ -0,0 +1,139 @@
+#ifndef BVH_H
+#define BVH_H
+
+// Std. Includes
+#include <vector>
+#include <functional>
+
+// GL Includes
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+// Project includes
+#include "Frustum.h"
+
+// An axis aligned box
+struct Aabb
+{
+	glm::vec3 Min;
+	glm::vec3 Max;
+
+	Aabb();
+	Aabb(const glm::vec3& min, const glm::vec3& max);
+
+	// The box around both
+	static Aabb Merge(const Aabb& a, const Aabb& b);
+	// Half the surface area, all the SAH needs to compare boxes
+	float GetArea() const;
+	glm::vec3 GetCenter() const { return (this->Min + this->Max) * 0.5f; }
+	bool Overlaps(const Aabb& other) const;
+	// The box around this one moved by transform
+	Aabb Transform(const glm::mat4& transform) const;
+};
+
+// The closest object a ray cast hit
+struct RayHit
+{
+	unsigned Proxy;
+	float Distance;
+};
+
+// A dynamic bounding volume hierarchy over the boxes of scene objects, for culling, picking and overlap tests in
+// logarithmic time. Every leaf holds one object. The nodes live in one array and point at each other by index;
+// Build lays them out depth first, a parent followed by its left subtree, so a traversal mostly walks forwards.
+// Objects can come and go and move between builds: Insert and Remove fix the path to the root at once, moved
+// objects are refitted together by Refit. Both rotate nodes on the way up, swapping a child with a grandchild
+// where that shrinks the boxes, which keeps the tree close to a fresh build for a while. Build from scratch once
+// the objects have moved far
+class Bvh
+{
+public:
+	// Tests a leaf's object against the ray, returns whether it's hit and how far along the ray
+	typedef std::function<bool(unsigned proxy, float& distance)> RayTest;
+
+	Bvh();
+
+	// Adds an object and returns its proxy, the id queries report it by. An empty tree hands out 0, 1, 2...
+	unsigned Insert(const Aabb& bounds);
+	void Remove(unsigned proxy);
+	// Moves an object. The tree is stale until Refit
+	void SetBounds(unsigned proxy, const Aabb& bounds);
+	const Aabb& GetBounds(unsigned proxy) const;
+	// Fits every node around its children again after objects moved, rotating where it helps if rotate is set
+	void Refit(bool rotate = true);
+	// Builds the tree again from the boxes of the objects with a binned surface area heuristic
+	void Build();
+	void Clear();
+
+	// Replaces proxies with the objects at least partly in the frustum. Subtrees fully inside aren't tested further
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned>& proxies) const;
+	// Replaces proxies with the objects whose box overlaps bounds
+	void QueryOverlap(const Aabb& bounds, std::vector<unsigned>& proxies) const;
+	// The closest object hit by the ray from origin along the unit length direction within maxDistance. test
+	// is asked about the objects whose boxes the ray enters, nearest boxes first, and only while they could
+	// still be closer than the best hit so far
+	bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const RayTest& test, RayHit& hit) const;
+
+	size_t GetObjectCount() const { return this->objectCount; }
+	size_t GetNodeCount() const { return this->nodes.size() - this->freeNodes.size(); }
+	unsigned GetHeight() const;
+	// The SAH cost of the tree, the area of all nodes relative to the root's. Lower is faster to query
+	float GetCost() const;
+
+private:
+	static const unsigned nullNode = 0xffffffff;
+
+	struct Node
+	{
+		Aabb Bounds;
+		unsigned Parent;
+		// Both nullNode for a leaf
+		unsigned Left;
+		unsigned Right;
+		// The object of a leaf
+		unsigned Proxy;
+
+		bool IsLeaf() const { return this->Left == nullNode; }
+	};
+
+	// An object while Build sorts them
+	struct BuildItem
+	{
+		Aabb Bounds;
+		glm::vec3 Center;
+		unsigned Proxy;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned> freeNodes;
+	// The leaf of every proxy, nullNode for removed ones
+	std::vector<unsigned> leaves;
+	std::vector<unsigned> freeProxies;
+	unsigned root;
+	size_t objectCount;
+	// Nodes children first, for Refit
+	std::vector<unsigned> order;
+
+	unsigned allocateNode();
+	void freeNode(unsigned index);
+	// The best sibling for a new leaf, by the area it adds to the tree
+	unsigned findSibling(const Aabb& bounds) const;
+	// Refits from index up to the root
+	void refitUp(unsigned index);
+	void fit(unsigned index);
+	// Swaps a child of index with a grandchild on the other side if that makes the child's box smaller
+	void rotate(unsigned index);
+	unsigned build(std::vector<BuildItem>& items, size_t begin, size_t end, unsigned parent);
+
+	Bvh(const Bvh&);
+	Bvh& operator=(const Bvh&);
+};
+
+// Narrow phase tests for RayCast. The direction is unit length, distance is along it.
+// A sphere, through glm::intersectRaySphere. A ray starting inside hits where it leaves the sphere
+bool RaySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& center, float radius, float& distance);
+// The closest of the triangles of a vertex list placed by model, through glm::intersectRayTriangle. Stride is the
+// floats per vertex, the position the first 3 of them. Both sides of a triangle count
+bool RayTriangles(const glm::vec3& origin, const glm::vec3& direction, const GLfloat* vertices, GLuint stride,
+	GLuint vertexCount, const glm::mat4& model, float& distance);
+#endif
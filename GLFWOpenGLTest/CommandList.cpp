@@ -0,0 +1,49 @@
+#include "CommandList.h"
+
+void CommandList::Submit(unsigned long long key, const DrawPacket& packet)
+{
+	this->Keys.push_back(key);
+	this->Packets.push_back(packet);
+}
+
+void CommandList::Clear()
+{
+	this->Keys.clear();
+	this->Packets.clear();
+}
+
+CommandRecorder::CommandRecorder(JobSystem& jobs) : jobs(jobs), used(0)
+{
+}
+
+void CommandRecorder::Record(size_t count, size_t grain, const Recorder& record)
+{
+	if (grain == 0)
+		grain = 1;
+	// Every range has its list before a job starts, the jobs only write to their own
+	this->used = (count + grain - 1) / grain;
+	if (this->lists.size() < this->used)
+		this->lists.resize(this->used);
+	for (size_t i = 0; i < this->used; i++)
+		this->lists[i].Clear();
+
+	// A single range isn't worth waking the workers for
+	if (this->used == 1)
+	{
+		record(this->lists[0], 0, count);
+		return;
+	}
+	std::vector<CommandList>& lists = this->lists;
+	this->jobs.ParallelFor(count, grain, [&lists, &record, grain](size_t begin, size_t end)
+	{
+		record(lists[begin / grain], begin, end);
+	});
+}
+
+size_t CommandRecorder::GetSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < this->used; i++)
+		size += this->lists[i].GetSize();
+	return size;
+}
@@ -0,0 +1,74 @@
+#ifndef COMMANDLIST_H
+#define COMMANDLIST_H
+
+// Std. Includes
+#include <vector>
+#include <functional>
+
+// GL Includes
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+// Project includes
+#include "JobSystem.h"
+
+class Shader;
+
+// Everything a draw of the queue needs. The uniforms of the frame, the camera and the lights, are set on each
+// program before the queue is executed; the packet only brings its "model" matrix
+struct DrawPacket
+{
+	const Shader* Program;
+	GLuint VertexArray;
+	// Bound to unit 0, unless Texture is 0
+	GLenum TextureTarget;
+	GLuint Texture;
+	GLenum Mode;
+	GLint First;
+	GLsizei Count;
+	glm::mat4 Model;
+};
+
+// Draws recorded by one job, with their sort keys. Recording calls no GL, so any thread can do it; the lists
+// are handed to a RenderQueue on the thread that owns the context
+class CommandList
+{
+public:
+	std::vector<unsigned long long> Keys;
+	std::vector<DrawPacket> Packets;
+
+	void Submit(unsigned long long key, const DrawPacket& packet);
+	// Empties the list, keeping its memory
+	void Clear();
+	size_t GetSize() const { return this->Packets.size(); }
+};
+
+// Records the draws of a frame on the workers of a JobSystem: building the matrices, culling and filling the
+// packets of a range of objects goes into a command list of that range. The lists are handed over in range
+// order, so a frame draws the same whichever worker recorded what. Lists keep their memory from frame to frame.
+class CommandRecorder
+{
+public:
+	// Records the draws of objects [begin, end) into list
+	typedef std::function<void(CommandList& list, size_t begin, size_t end)> Recorder;
+
+	CommandRecorder(JobSystem& jobs);
+
+	// Runs record over [0, count) in ranges of grain objects, each range into a list of its own, and returns once
+	// all are recorded. The lists of the previous Record are cleared first
+	void Record(size_t count, size_t grain, const Recorder& record);
+	// The lists of the last Record, in range order
+	size_t GetListCount() const { return this->used; }
+	const CommandList& GetList(size_t index) const { return this->lists[index]; }
+	// Draws recorded by the last Record
+	size_t GetSize() const;
+
+private:
+	JobSystem& jobs;
+	std::vector<CommandList> lists;
+	size_t used;
+
+	CommandRecorder(const CommandRecorder&);
+	CommandRecorder& operator=(const CommandRecorder&);
+};
+#endif
@@ -0,0 +1,60 @@
+#include "DrawKey.h"
+
+// Std. Includes
+#include <cstring>
+
+unsigned long long MakeDrawKey(unsigned layer, unsigned program, unsigned material, float depth, bool backToFront)
+{
+	// The bits of a positive float grow with its value, so its top 28 bits order depths without knowing the far plane
+	unsigned bits = 0;
+	if (depth > 0.0f)
+		std::memcpy(&bits, &depth, sizeof(bits));
+	unsigned depthBits = (bits >> 4) & 0xFFFFFFF;
+	if (backToFront)
+		depthBits = ~depthBits & 0xFFFFFFF;
+	return (unsigned long long)(layer & 0xFF) << 56 | (unsigned long long)(program & 0xFFF) << 44
+		| (unsigned long long)(material & 0xFFFF) << 28 | depthBits;
+}
+
+void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+{
+	size_t count = items.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+
+	// The histograms of all eight bytes in one pass over the keys
+	size_t histograms[8][256];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned long long key = items[i].Key;
+		for (int digit = 0; digit < 8; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	SortItem* from = &items[0];
+	SortItem* to = &scratch[0];
+	for (int digit = 0; digit < 8; digit++)
+	{
+		size_t* histogram = histograms[digit];
+		// A byte every key has the same doesn't reorder anything
+		if (histogram[(from[0].Key >> (digit * 8)) & 0xFF] == count)
+			continue;
+		size_t offset = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			size_t size = histogram[i];
+			histogram[i] = offset;
+			offset += size;
+		}
+		for (size_t i = 0; i < count; i++)
+			to[histogram[(from[i].Key >> (digit * 8)) & 0xFF]++] = from[i];
+		SortItem* swap = from;
+		from = to;
+		to = swap;
+	}
+	// After an odd number of passes the sorted keys are in scratch, swapping the vectors moves no items
+	if (from != &items[0])
+		items.swap(scratch);
+}
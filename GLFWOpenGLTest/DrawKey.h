@@ -0,0 +1,27 @@
+#ifndef DRAWKEY_H
+#define DRAWKEY_H
+
+// Std. Includes
+#include <vector>
+
+// A draw's sort key and the index of the draw it belongs to
+struct SortItem
+{
+	unsigned long long Key;
+	unsigned Index;
+};
+
+// Packs what a draw is sorted by into one key, most significant first:
+//   layer     8 bits, e.g. opaque before transparent before overlays
+//   program  12 bits, draws of a program end up together so it is switched once
+//   material 16 bits, the same for the textures and uniforms within a program
+//   depth    28 bits, distance from the camera, front to back so early depth testing drops hidden fragments.
+//            backToFront reverses it for blended draws
+// program and material are truncated to their bits. IDs that collide only sort less well, they draw the same
+unsigned long long MakeDrawKey(unsigned layer, unsigned program, unsigned material, float depth, bool backToFront = false);
+
+// Sorts items by key, keeping the order of equal keys. A least significant digit radix sort, a byte per pass,
+// skipping the bytes all keys share: the layer and program bytes of most frames. scratch is resized to items
+// and only allocates when items grew past what it held before
+void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+#endif
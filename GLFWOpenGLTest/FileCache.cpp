@@ -0,0 +1,116 @@
+#include "FileCache.h"
+
+// Std. Includes
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+// The primes of xxHash64
+static const unsigned long long hashPrime1 = 11400714785074694791ULL;
+static const unsigned long long hashPrime2 = 14029467366897019727ULL;
+static const unsigned long long hashPrime3 = 1609587929392839161ULL;
+static const unsigned long long hashPrime4 = 9650029242287828579ULL;
+static const unsigned long long hashPrime5 = 2870177450012600261ULL;
+
+static unsigned long long rotateLeft(unsigned long long value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static unsigned long long hashRound(unsigned long long lane, unsigned long long word)
+{
+	return rotateLeft(lane + word * hashPrime2, 31) * hashPrime1;
+}
+
+static unsigned long long hashMerge(unsigned long long hash, unsigned long long lane)
+{
+	return (hash ^ hashRound(0, lane)) * hashPrime1 + hashPrime4;
+}
+
+unsigned long long HashBytes(const void* bytes, size_t size, unsigned long long seed)
+{
+	// Four independent lanes keep hashing a PNG on a cache hit far below the cost of even mapping its pixels
+	const unsigned char* data = (const unsigned char*)bytes;
+	unsigned long long hash, word;
+	size_t i = 0;
+	if (size >= 32)
+	{
+		unsigned long long lanes[4] = { seed + hashPrime1 + hashPrime2, seed + hashPrime2, seed, seed - hashPrime1 };
+		for (; i + 32 <= size; i += 32)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				memcpy(&word, data + i + lane * 8, 8);
+				lanes[lane] = hashRound(lanes[lane], word);
+			}
+		}
+		hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+		for (int lane = 0; lane < 4; lane++)
+			hash = hashMerge(hash, lanes[lane]);
+	}
+	else
+		hash = seed + hashPrime5;
+	hash += size;
+
+	for (; i + 8 <= size; i += 8)
+	{
+		memcpy(&word, data + i, 8);
+		hash = rotateLeft(hash ^ hashRound(0, word), 27) * hashPrime1 + hashPrime4;
+	}
+	if (i + 4 <= size)
+	{
+		unsigned half;
+		memcpy(&half, data + i, 4);
+		hash = rotateLeft(hash ^ (half * hashPrime1), 23) * hashPrime2 + hashPrime3;
+		i += 4;
+	}
+	for (; i < size; i++)
+		hash = rotateLeft(hash ^ (data[i] * hashPrime5), 11) * hashPrime1;
+
+	// Spread the last inputs over all bits
+	hash ^= hash >> 33;
+	hash *= hashPrime2;
+	hash ^= hash >> 29;
+	hash *= hashPrime3;
+	return hash ^ (hash >> 32);
+}
+
+bool WriteCacheFile(const std::string& directory, const std::string& path, const void* data, size_t size)
+{
+#ifdef _WIN32
+	CreateDirectoryA(directory.c_str(), 0);
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary.c_str(), std::ios::binary);
+		file.write((const char*)data, size);
+		if (!file.good())
+		{
+			std::cout << "ERROR::FILECACHE::FILE_NOT_WRITTEN " << temporary << std::endl;
+			return false;
+		}
+	}
+#ifdef _WIN32
+	bool renamed = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool renamed = rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+	if (!renamed)
+	{
+		std::cout << "ERROR::FILECACHE::FILE_NOT_WRITTEN " << path << std::endl;
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,18 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+// Std. Includes
+#include <string>
+#include <cstddef>
+
+// What the caches on disk share, TextureCache and ShaderCache, so they hash and write their files the same way.
+
+// xxHash64 of size bytes, chained by passing the hash so far as seed. Every input bit reaches every output bit,
+// so no two edits of a source can cancel out. Reads words in the byte order of this machine, the caches are
+// caches of this machine
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long seed = 0);
+
+// Writes size bytes to path, creating directory first if it is missing. Written next to path and renamed over it,
+// so a run that dies halfway never leaves a torn file behind
+bool WriteCacheFile(const std::string& directory, const std::string& path, const void* data, size_t size);
+#endif
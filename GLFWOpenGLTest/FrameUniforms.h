@@ -0,0 +1,57 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+// GL Includes
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+// The Frame block of Frame.txt as std140 lays it out, to be copied into a uniform buffer as it is. A vec3 takes
+// the room of a vec4 unless a float follows it, structs and arrays start at 16 bytes, hence the padding
+
+struct DirLightBlock
+{
+	glm::vec3 Direction;
+	GLfloat pad0;
+	glm::vec3 Ambient;
+	GLfloat pad1;
+	glm::vec3 Diffuse;
+	GLfloat pad2;
+	glm::vec3 Specular;
+	GLfloat pad3;
+};
+
+struct SpotLightBlock
+{
+	glm::vec3 Position;
+	GLfloat pad0;
+	glm::vec3 Direction;
+	GLfloat CutOff;
+	GLfloat OuterCutOff;
+	GLfloat Constant;
+	GLfloat Linear;
+	GLfloat Quadratic;
+	glm::vec3 Ambient;
+	GLfloat pad1;
+	glm::vec3 Diffuse;
+	GLfloat pad2;
+	glm::vec3 Specular;
+	GLfloat pad3;
+};
+
+struct FrameBlock
+{
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::vec3 ViewPos;
+	GLfloat pad0;
+	DirLightBlock DirLight;
+	SpotLightBlock SpotLight;
+	// The clusters of LightClusters, see Clusters.txt
+	glm::uvec4 ClusterCount;
+	glm::vec4 ClusterScale;
+};
+
+static_assert(sizeof(DirLightBlock) == 64, "DirLightBlock doesn't match std140");
+static_assert(sizeof(SpotLightBlock) == 96, "SpotLightBlock doesn't match std140");
+static_assert(sizeof(FrameBlock) == 336, "FrameBlock doesn't match std140");
+#endif
@@ -0,0 +1,261 @@
+#include "Frustum.h"
+
+// Std. Includes
+#include <cmath>
+#if defined(__AVX__)
+#define FRUSTUM_AVX
+#include <immintrin.h>
+#endif
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FRUSTUM_SSE2
+#include <emmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < PLANE_COUNT; i++)
+		this->Planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// glm is column major, row i is m[0][i], m[1][i], m[2][i], m[3][i]
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	// A point is inside where -w <= x, y, z <= w in clip space, each of the six inequalities is a plane
+	this->Planes[PLANE_LEFT] = rows[3] + rows[0];
+	this->Planes[PLANE_RIGHT] = rows[3] - rows[0];
+	this->Planes[PLANE_BOTTOM] = rows[3] + rows[1];
+	this->Planes[PLANE_TOP] = rows[3] - rows[1];
+	this->Planes[PLANE_NEAR] = rows[3] + rows[2];
+	this->Planes[PLANE_FAR] = rows[3] - rows[2];
+	for (int i = 0; i < PLANE_COUNT; i++)
+		this->Planes[i] /= glm::length(glm::vec3(this->Planes[i]));
+}
+
+bool Frustum::TestSphere(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		const glm::vec4& plane = this->Planes[i];
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::TestBox(const glm::vec3& min, const glm::vec3& max) const
+{
+	glm::vec3 center = (min + max) * 0.5f, extent = (max - min) * 0.5f;
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		// The box reaches as far towards the plane as its extents projected on the normal
+		const glm::vec4& plane = this->Planes[i];
+		float reach = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -reach)
+			return false;
+	}
+	return true;
+}
+
+unsigned SphereBounds::Add(const glm::vec3& center, float radius)
+{
+	this->X.push_back(center.x);
+	this->Y.push_back(center.y);
+	this->Z.push_back(center.z);
+	this->Radius.push_back(radius);
+	return (unsigned)this->X.size() - 1;
+}
+
+void SphereBounds::Set(unsigned index, const glm::vec3& center, float radius)
+{
+	this->X[index] = center.x;
+	this->Y[index] = center.y;
+	this->Z[index] = center.z;
+	this->Radius[index] = radius;
+}
+
+void SphereBounds::Clear()
+{
+	this->X.clear();
+	this->Y.clear();
+	this->Z.clear();
+	this->Radius.clear();
+}
+
+unsigned BoxBounds::Add(const glm::vec3& min, const glm::vec3& max)
+{
+	this->CenterX.push_back(0.0f);
+	this->CenterY.push_back(0.0f);
+	this->CenterZ.push_back(0.0f);
+	this->ExtentX.push_back(0.0f);
+	this->ExtentY.push_back(0.0f);
+	this->ExtentZ.push_back(0.0f);
+	unsigned index = (unsigned)this->CenterX.size() - 1;
+	this->Set(index, min, max);
+	return index;
+}
+
+void BoxBounds::Set(unsigned index, const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 center = (min + max) * 0.5f, extent = (max - min) * 0.5f;
+	this->CenterX[index] = center.x;
+	this->CenterY[index] = center.y;
+	this->CenterZ[index] = center.z;
+	this->ExtentX[index] = extent.x;
+	this->ExtentY[index] = extent.y;
+	this->ExtentZ[index] = extent.z;
+}
+
+void BoxBounds::Clear()
+{
+	this->CenterX.clear();
+	this->CenterY.clear();
+	this->CenterZ.clear();
+	this->ExtentX.clear();
+	this->ExtentY.clear();
+	this->ExtentZ.clear();
+}
+
+// Writes index + the set bits of mask to visible from written on, lowest first. Every lane is written and only the
+// visible ones kept, which costs no branch a random mask would mispredict
+static void writeVisible(unsigned* visible, size_t& written, unsigned index, int mask, int lanes)
+{
+	for (int bit = 0; bit < lanes; bit++)
+	{
+		visible[written] = index + bit;
+		written += (mask >> bit) & 1;
+	}
+}
+
+// Both volumes are tested the same way: a volume is outside a plane when its center is further behind it than the
+// volume reaches, the radius for a sphere and the extents projected on the normal for a box. Reaches holds the
+// reach per object, or is 0 for boxes, whose reach is made from the extents. Tests the objects from begin on one by one
+static void cullScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* reaches,
+	const float* extentX, const float* extentY, const float* extentZ, size_t begin, size_t count, unsigned* visible, size_t& written)
+{
+	for (size_t i = begin; i < count; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < PLANE_COUNT && inside; p++)
+		{
+			const glm::vec4& plane = frustum.Planes[p];
+			float reach = reaches ? reaches[i] :
+				std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] + std::fabs(plane.z) * extentZ[i];
+			inside = plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w >= -reach;
+		}
+		if (inside)
+			visible[written++] = (unsigned)i;
+	}
+}
+
+// The same test on a structure of arrays, a plane's components broadcast and every lane an object. Returns where
+// the objects it left for cullScalar begin
+static size_t cullSimd(const Frustum& frustum, const float* x, const float* y, const float* z, const float* reaches,
+	const float* extentX, const float* extentY, const float* extentZ, size_t count, unsigned* visible, size_t& written)
+{
+	size_t i = 0;
+#ifdef FRUSTUM_AVX
+	// 8 objects at a time
+	__m256 planes[PLANE_COUNT][4], absolute[PLANE_COUNT][3];
+	for (int p = 0; p < PLANE_COUNT; p++)
+	{
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm256_set1_ps(frustum.Planes[p][c]);
+		for (int c = 0; c < 3; c++)
+			absolute[p][c] = _mm256_set1_ps(std::fabs(frustum.Planes[p][c]));
+	}
+	__m256 zero = _mm256_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256 radius = reaches ? _mm256_loadu_ps(reaches + i) : zero;
+		for (int p = 0; p < PLANE_COUNT; p++)
+		{
+			__m256 reach = radius;
+			if (!reaches)
+			{
+				reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absolute[p][0], _mm256_loadu_ps(extentX + i)),
+					_mm256_mul_ps(absolute[p][1], _mm256_loadu_ps(extentY + i))), _mm256_mul_ps(absolute[p][2], _mm256_loadu_ps(extentZ + i)));
+			}
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], px), _mm256_mul_ps(planes[p][1], py)),
+				_mm256_mul_ps(planes[p][2], pz)), planes[p][3]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_sub_ps(zero, reach), _CMP_GE_OQ));
+		}
+		writeVisible(visible, written, (unsigned)i, _mm256_movemask_ps(inside), 8);
+	}
+#elif defined(FRUSTUM_SSE2)
+	// 4 objects at a time
+	__m128 planes[PLANE_COUNT][4], absolute[PLANE_COUNT][3];
+	for (int p = 0; p < PLANE_COUNT; p++)
+	{
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm_set1_ps(frustum.Planes[p][c]);
+		for (int c = 0; c < 3; c++)
+			absolute[p][c] = _mm_set1_ps(std::fabs(frustum.Planes[p][c]));
+	}
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		__m128 radius = reaches ? _mm_loadu_ps(reaches + i) : zero;
+		for (int p = 0; p < PLANE_COUNT; p++)
+		{
+			__m128 reach = radius;
+			if (!reaches)
+			{
+				reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absolute[p][0], _mm_loadu_ps(extentX + i)),
+					_mm_mul_ps(absolute[p][1], _mm_loadu_ps(extentY + i))), _mm_mul_ps(absolute[p][2], _mm_loadu_ps(extentZ + i)));
+			}
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], px), _mm_mul_ps(planes[p][1], py)),
+				_mm_mul_ps(planes[p][2], pz)), planes[p][3]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_sub_ps(zero, reach)));
+		}
+		writeVisible(visible, written, (unsigned)i, _mm_movemask_ps(inside), 4);
+	}
+#endif
+	return i;
+}
+
+void CullSpheres(const Frustum& frustum, const SphereBounds& bounds, std::vector<unsigned>& visible, bool simd)
+{
+	// Room for every index, cut down to the visible ones afterwards. Only growing the list writes to it
+	size_t count = bounds.GetSize();
+	visible.resize(count);
+	if (!count)
+		return;
+	size_t written = 0;
+	const float *x = &bounds.X[0], *y = &bounds.Y[0], *z = &bounds.Z[0], *radius = &bounds.Radius[0];
+	size_t done = simd ? cullSimd(frustum, x, y, z, radius, 0, 0, 0, count, &visible[0], written) : 0;
+	cullScalar(frustum, x, y, z, radius, 0, 0, 0, done, count, &visible[0], written);
+	visible.resize(written);
+}
+
+void CullBoxes(const Frustum& frustum, const BoxBounds& bounds, std::vector<unsigned>& visible, bool simd)
+{
+	// Room for every index, cut down to the visible ones afterwards. Only growing the list writes to it
+	size_t count = bounds.GetSize();
+	visible.resize(count);
+	if (!count)
+		return;
+	const float *x = &bounds.CenterX[0], *y = &bounds.CenterY[0], *z = &bounds.CenterZ[0];
+	const float *extentX = &bounds.ExtentX[0], *extentY = &bounds.ExtentY[0], *extentZ = &bounds.ExtentZ[0];
+	size_t written = 0;
+	size_t done = simd ? cullSimd(frustum, x, y, z, 0, extentX, extentY, extentZ, count, &visible[0], written) : 0;
+	cullScalar(frustum, x, y, z, 0, extentX, extentY, extentZ, done, count, &visible[0], written);
+	visible.resize(written);
+}
+
+const char* GetCullingInstructions()
+{
+#if defined(FRUSTUM_AVX)
+	return "AVX";
+#elif defined(FRUSTUM_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <glm\glm.hpp>
+
+enum Frustum_Plane {
+	PLANE_LEFT,
+	PLANE_RIGHT,
+	PLANE_BOTTOM,
+	PLANE_TOP,
+	PLANE_NEAR,
+	PLANE_FAR,
+	PLANE_COUNT
+};
+
+// The six planes of a view volume in world space, taken from the rows of projection * view. Each plane is
+// normalized and faces inwards, so the dot with a point plus w is its signed distance, positive inside
+struct Frustum
+{
+	glm::vec4 Planes[PLANE_COUNT];
+
+	Frustum();
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	// Whether the volume is at least partly inside. Conservative: a volume near a corner of the frustum may pass
+	// while outside, none inside fails
+	bool TestSphere(const glm::vec3& center, float radius) const;
+	bool TestBox(const glm::vec3& min, const glm::vec3& max) const;
+};
+
+// Bounding spheres of objects as a structure of arrays, so one SIMD register holds a coordinate of 4 or 8 of them
+struct SphereBounds
+{
+	std::vector<float> X, Y, Z, Radius;
+
+	// Returns the index the visible lists give the sphere
+	unsigned Add(const glm::vec3& center, float radius);
+	void Set(unsigned index, const glm::vec3& center, float radius);
+	void Clear();
+	size_t GetSize() const { return this->X.size(); }
+};
+
+// Axis aligned boxes of objects as centers and half extents, a structure of arrays like SphereBounds
+struct BoxBounds
+{
+	std::vector<float> CenterX, CenterY, CenterZ;
+	std::vector<float> ExtentX, ExtentY, ExtentZ;
+
+	unsigned Add(const glm::vec3& min, const glm::vec3& max);
+	void Set(unsigned index, const glm::vec3& min, const glm::vec3& max);
+	void Clear();
+	size_t GetSize() const { return this->CenterX.size(); }
+};
+
+// Replaces visible with the indices of the volumes at least partly inside the frustum, in increasing order. With
+// simd false the volumes are tested one by one, which gives the same list and is only there to compare against
+void CullSpheres(const Frustum& frustum, const SphereBounds& bounds, std::vector<unsigned>& visible, bool simd = true);
+void CullBoxes(const Frustum& frustum, const BoxBounds& bounds, std::vector<unsigned>& visible, bool simd = true);
+// The instruction set the culling was compiled for: "AVX", "SSE2" or "scalar"
+const char* GetCullingInstructions();
+#endif
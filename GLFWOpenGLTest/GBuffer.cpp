@@ -0,0 +1,112 @@
+#include "GBuffer.h"
+
+// Std. Includes
+#include <iostream>
+
+GBuffer::GBuffer(GLState& state, GLuint width, GLuint height)
+	: state(state), width(width), height(height), geometryFramebuffer(0), lightFramebuffer(0), albedoSpecular(0),
+	normal(0), depth(0), light(0), lightDepth(0), complete(false)
+{
+	this->albedoSpecular = this->makeTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	this->normal = this->makeTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+	this->depth = this->makeTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+	this->light = this->makeTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+
+	glGenFramebuffers(1, &this->geometryFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->geometryFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->albedoSpecular, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, this->normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depth, 0);
+	GLenum geometryTargets[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, geometryTargets);
+	bool geometryComplete = this->check("GEOMETRY");
+
+	// The same format as the depth texture, blitting depth wants them equal
+	glGenRenderbuffers(1, &this->lightDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->lightDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, this->width, this->height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &this->lightFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->lightFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->light, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->lightDepth);
+	this->complete = this->check("LIGHT") && geometryComplete;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::BeginGeometry()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, this->geometryFramebuffer);
+	glViewport(0, 0, this->width, this->height);
+	// Nothing reads the colors of the background, the depth of 1 marks it
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::BeginLighting()
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, this->geometryFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->lightFramebuffer);
+	glBlitFramebuffer(0, 0, this->width, this->height, 0, 0, this->width, this->height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->lightFramebuffer);
+	glViewport(0, 0, this->width, this->height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void GBuffer::End()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, this->width, this->height);
+}
+
+void GBuffer::BindTextures(GLuint firstUnit)
+{
+	this->state.BindTexture(firstUnit + GBUFFER_ALBEDO_SPECULAR, GL_TEXTURE_2D, this->albedoSpecular);
+	this->state.BindTexture(firstUnit + GBUFFER_NORMAL, GL_TEXTURE_2D, this->normal);
+	this->state.BindTexture(firstUnit + GBUFFER_DEPTH, GL_TEXTURE_2D, this->depth);
+	this->state.BindTexture(firstUnit + GBUFFER_LIGHT, GL_TEXTURE_2D, this->light);
+}
+
+void GBuffer::Release()
+{
+	if (this->geometryFramebuffer)
+		glDeleteFramebuffers(1, &this->geometryFramebuffer);
+	if (this->lightFramebuffer)
+		glDeleteFramebuffers(1, &this->lightFramebuffer);
+	if (this->lightDepth)
+		glDeleteRenderbuffers(1, &this->lightDepth);
+	GLuint* textures[] = { &this->albedoSpecular, &this->normal, &this->depth, &this->light };
+	for (int i = 0; i < 4; i++)
+	{
+		if (*textures[i])
+			this->state.DeleteTexture(*textures[i]);
+		*textures[i] = 0;
+	}
+	this->geometryFramebuffer = 0;
+	this->lightFramebuffer = 0;
+	this->lightDepth = 0;
+}
+
+GLuint GBuffer::makeTarget(GLenum internalFormat, GLenum format, GLenum type)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	this->state.BindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, this->width, this->height, 0, format, type, 0);
+	// Read a texel a pixel with texelFetch, never filtered
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+bool GBuffer::check(const char* name)
+{
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+		return true;
+	std::cout << "ERROR::GBUFFER::" << name << "_NOT_COMPLETE" << std::endl;
+	return false;
+}
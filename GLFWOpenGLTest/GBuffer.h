@@ -0,0 +1,63 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "GLState.h"
+
+// The textures BindTextures binds, as offsets from its first unit
+enum GBuffer_Texture {
+	GBUFFER_ALBEDO_SPECULAR,
+	GBUFFER_NORMAL,
+	GBUFFER_DEPTH,
+	GBUFFER_LIGHT
+};
+
+// The render targets of the deferred path. The geometry pass writes the surface of every pixel: albedo with the
+// specular intensity in alpha (RGBA8), the normal folded onto an octahedron (RG16) and the depth, which gives the
+// position back so none is stored. The lighting pass adds the light of every light volume into a half float
+// target, over a copy of that depth so volumes behind the surfaces are rejected before shading. A copy, since GL
+// leaves reading a texture attached to the framebuffer being drawn to undefined
+class GBuffer
+{
+public:
+	// Constructor makes the targets width x height. Needs a current context
+	GBuffer(GLState& state, GLuint width, GLuint height);
+
+	// Binds the geometry targets and clears them
+	void BeginGeometry();
+	// Binds the light target, copies the depth of the geometry pass to it and clears it to no light
+	void BeginLighting();
+	// Back to the window
+	void End();
+	// Binds the G-buffer textures and the light to units firstUnit and on, in the order of GBuffer_Texture
+	void BindTextures(GLuint firstUnit);
+	// Deletes the targets. Call while the GL context is still current, before glfwTerminate
+	void Release();
+
+	bool IsComplete() const { return this->complete; }
+	GLuint GetWidth() const { return this->width; }
+	GLuint GetHeight() const { return this->height; }
+
+private:
+	GLState& state;
+	GLuint width;
+	GLuint height;
+	GLuint geometryFramebuffer;
+	GLuint lightFramebuffer;
+	GLuint albedoSpecular;
+	GLuint normal;
+	GLuint depth;
+	GLuint light;
+	GLuint lightDepth;
+	bool complete;
+
+	GLuint makeTarget(GLenum internalFormat, GLenum format, GLenum type);
+	bool check(const char* name);
+
+	GBuffer(const GBuffer&);
+	GBuffer& operator=(const GBuffer&);
+};
+#endif
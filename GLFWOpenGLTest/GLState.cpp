@@ -0,0 +1,348 @@
+#include "GLState.h"
+
+// Std. Includes
+#include <cstring>
+
+// Buffer targets and texture targets the state knows, binds to others always go to GL
+static const GLenum bufferTargets[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER,
+	GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_SHADER_STORAGE_BUFFER };
+static const GLenum textureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D };
+static const size_t bufferTargetCount = sizeof(bufferTargets) / sizeof(bufferTargets[0]);
+static const size_t textureTargetCount = sizeof(textureTargets) / sizeof(textureTargets[0]);
+// Units beyond the 16 every GL 3.3 driver has for the fragment shader are left to GL
+static const GLuint textureUnitCount = 16;
+// Binding points of each indexed target known, GL 3.3 has at least 36 for uniform blocks
+static const GLuint rangeBindingCount = 16;
+
+State_Counters::State_Counters()
+{
+	for (int i = 0; i < CALL_KIND_COUNT; i++)
+		this->Issued[i] = this->Saved[i] = 0;
+}
+
+unsigned State_Counters::GetIssued() const
+{
+	unsigned issued = 0;
+	for (int i = 0; i < CALL_KIND_COUNT; i++)
+		issued += this->Issued[i];
+	return issued;
+}
+
+unsigned State_Counters::GetSaved() const
+{
+	unsigned saved = 0;
+	for (int i = 0; i < CALL_KIND_COUNT; i++)
+		saved += this->Saved[i];
+	return saved;
+}
+
+GLState::GLState() : buffers(bufferTargetCount), ranges(2 * rangeBindingCount), textures(textureUnitCount * textureTargetCount)
+{
+	for (size_t i = 0; i < this->buffers.size(); i++)
+		this->buffers[i].Target = bufferTargets[i];
+	for (size_t i = 0; i < this->textures.size(); i++)
+		this->textures[i].Target = textureTargets[i % textureTargetCount];
+	this->Reset();
+}
+
+void GLState::BeginFrame()
+{
+	this->LastFrame = this->Frame;
+	this->Frame = State_Counters();
+}
+
+void GLState::Reset()
+{
+	this->program = 0;
+	this->programID = 0;
+	this->vertexArrayKnown = false;
+	this->activeUnitKnown = false;
+	this->activeUnit = 0;
+	for (size_t i = 0; i < this->buffers.size(); i++)
+		this->buffers[i].Known = false;
+	for (size_t i = 0; i < this->ranges.size(); i++)
+		this->ranges[i].Known = false;
+	for (size_t i = 0; i < this->textures.size(); i++)
+		this->textures[i].Known = false;
+}
+
+bool GLState::change(State_Call kind, Binding& binding, GLuint object)
+{
+	if (binding.Known && binding.Object == object)
+	{
+		this->Frame.Saved[kind]++;
+		return false;
+	}
+	binding.Object = object;
+	binding.Known = true;
+	this->Frame.Issued[kind]++;
+	return true;
+}
+
+void GLState::UseProgram(const Shader& shader)
+{
+	// A rebuilt program may have the ID of the one it replaced, the values set on that one mean nothing to it
+	GLuint programID = shader.GetProgram();
+	unsigned revision = shader.GetRevision();
+	Program& program = this->programs[programID];
+	if (program.Revision != revision)
+	{
+		program.Revision = revision;
+		program.Uniforms.clear();
+		program.Names.clear();
+		program.Blocks.clear();
+	}
+	else if (this->program == &program && this->programID == programID)
+	{
+		this->Frame.Saved[CALL_PROGRAM]++;
+		return;
+	}
+	this->program = &program;
+	this->programID = programID;
+	this->Frame.Issued[CALL_PROGRAM]++;
+	glUseProgram(programID);
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+	if (this->vertexArrayKnown && this->vertexArray == vertexArray)
+	{
+		this->Frame.Saved[CALL_VERTEX_ARRAY]++;
+		return;
+	}
+	this->vertexArray = vertexArray;
+	this->vertexArrayKnown = true;
+	this->findBuffer(GL_ELEMENT_ARRAY_BUFFER)->Known = false;
+	this->Frame.Issued[CALL_VERTEX_ARRAY]++;
+	glBindVertexArray(vertexArray);
+}
+
+GLState::Binding* GLState::findBuffer(GLenum target)
+{
+	for (size_t i = 0; i < this->buffers.size(); i++)
+	{
+		if (this->buffers[i].Target == target)
+			return &this->buffers[i];
+	}
+	return 0;
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	Binding* binding = this->findBuffer(target);
+	if (!binding)
+	{
+		this->Frame.Issued[CALL_BUFFER]++;
+		glBindBuffer(target, buffer);
+	}
+	else if (this->change(CALL_BUFFER, *binding, buffer))
+		glBindBuffer(target, buffer);
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	RangeBinding* range = 0;
+	if (index < rangeBindingCount && (target == GL_UNIFORM_BUFFER || target == GL_SHADER_STORAGE_BUFFER))
+		range = &this->ranges[(target == GL_UNIFORM_BUFFER ? 0 : rangeBindingCount) + index];
+	if (range && range->Known && range->Buffer == buffer && range->Offset == offset && range->Size == size)
+	{
+		this->Frame.Saved[CALL_BUFFER]++;
+		return;
+	}
+	if (range)
+	{
+		range->Buffer = buffer;
+		range->Offset = offset;
+		range->Size = size;
+		range->Known = true;
+	}
+	Binding* binding = this->findBuffer(target);
+	if (binding)
+	{
+		binding->Object = buffer;
+		binding->Known = true;
+	}
+	this->Frame.Issued[CALL_BUFFER]++;
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+GLState::Binding* GLState::findTexture(GLuint unit, GLenum target)
+{
+	if (unit >= textureUnitCount)
+		return 0;
+	for (size_t i = 0; i < textureTargetCount; i++)
+	{
+		if (textureTargets[i] == target)
+			return &this->textures[unit * textureTargetCount + i];
+	}
+	return 0;
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	Binding* binding = this->findTexture(unit, target);
+	if (binding && binding->Known && binding->Object == texture)
+	{
+		this->Frame.Saved[CALL_TEXTURE]++;
+		return;
+	}
+	// Only a bind that goes through needs the unit active, the active unit is a call of its own
+	if (!this->activeUnitKnown || this->activeUnit != unit)
+	{
+		this->activeUnit = unit;
+		this->activeUnitKnown = true;
+		this->Frame.Issued[CALL_TEXTURE]++;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	this->BindTexture(target, texture);
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture)
+{
+	Binding* binding = this->activeUnitKnown ? this->findTexture(this->activeUnit, target) : 0;
+	if (!binding)
+	{
+		this->Frame.Issued[CALL_TEXTURE]++;
+		glBindTexture(target, texture);
+	}
+	else if (this->change(CALL_TEXTURE, *binding, texture))
+		glBindTexture(target, texture);
+}
+
+void GLState::DeleteVertexArray(GLuint vertexArray)
+{
+	if (this->vertexArrayKnown && this->vertexArray == vertexArray)
+		this->vertexArray = 0;
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+void GLState::DeleteBuffer(GLuint buffer)
+{
+	for (size_t i = 0; i < this->buffers.size(); i++)
+	{
+		if (this->buffers[i].Known && this->buffers[i].Object == buffer)
+			this->buffers[i].Object = 0;
+	}
+	for (size_t i = 0; i < this->ranges.size(); i++)
+	{
+		if (this->ranges[i].Known && this->ranges[i].Buffer == buffer)
+			this->ranges[i].Known = false;
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void GLState::DeleteTexture(GLuint texture)
+{
+	for (size_t i = 0; i < this->textures.size(); i++)
+	{
+		if (this->textures[i].Known && this->textures[i].Object == texture)
+			this->textures[i].Object = 0;
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void GLState::DeleteProgram(GLuint program)
+{
+	if (this->programID == program)
+	{
+		this->program = 0;
+		this->programID = 0;
+	}
+	this->programs.erase(program);
+	glDeleteProgram(program);
+}
+
+GLState::Uniform* GLState::findUniform(const GLchar* name)
+{
+	if (!this->program || this->programID == 0)
+		return 0;
+	// A buffer the caller fills may hold another name by now, so the name behind a known pointer is compared
+	Program::UniformMap::value_type*& named = this->program->Names[name];
+	if (named && std::strcmp(named->first.c_str(), name) == 0)
+	{
+		this->Frame.Saved[CALL_UNIFORM_LOCATION]++;
+		return &named->second;
+	}
+	Program::UniformMap::iterator found = this->program->Uniforms.find(name);
+	if (found != this->program->Uniforms.end())
+	{
+		named = &*found;
+		this->Frame.Saved[CALL_UNIFORM_LOCATION]++;
+		return &found->second;
+	}
+	found = this->program->Uniforms.insert(Program::UniformMap::value_type(name, Uniform())).first;
+	named = &*found;
+	Uniform& uniform = found->second;
+	uniform.Location = glGetUniformLocation(this->programID, name);
+	uniform.Size = 0;
+	this->Frame.Issued[CALL_UNIFORM_LOCATION]++;
+	return &uniform;
+}
+
+GLint GLState::GetUniformLocation(const GLchar* name)
+{
+	Uniform* uniform = this->findUniform(name);
+	return uniform ? uniform->Location : -1;
+}
+
+GLState::Uniform* GLState::changeUniform(const GLchar* name, const void* value, GLsizei size)
+{
+	Uniform* uniform = this->findUniform(name);
+	if (!uniform || uniform->Location < 0 || (uniform->Size == size && std::memcmp(uniform->Value, value, size) == 0))
+	{
+		this->Frame.Saved[CALL_UNIFORM]++;
+		return 0;
+	}
+	std::memcpy(uniform->Value, value, size);
+	uniform->Size = size;
+	this->Frame.Issued[CALL_UNIFORM]++;
+	return uniform;
+}
+
+void GLState::Uniform1i(const GLchar* name, GLint value)
+{
+	if (Uniform* uniform = this->changeUniform(name, &value, sizeof(value)))
+		glUniform1i(uniform->Location, value);
+}
+
+void GLState::Uniform1f(const GLchar* name, GLfloat value)
+{
+	if (Uniform* uniform = this->changeUniform(name, &value, sizeof(value)))
+		glUniform1f(uniform->Location, value);
+}
+
+void GLState::Uniform3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z)
+{
+	GLfloat value[] = { x, y, z };
+	if (Uniform* uniform = this->changeUniform(name, value, sizeof(value)))
+		glUniform3f(uniform->Location, x, y, z);
+}
+
+void GLState::Uniform4fv(const GLchar* name, const GLfloat* value)
+{
+	if (Uniform* uniform = this->changeUniform(name, value, 4 * sizeof(GLfloat)))
+		glUniform4fv(uniform->Location, 1, value);
+}
+
+void GLState::UniformMatrix4fv(const GLchar* name, const GLfloat* value)
+{
+	if (Uniform* uniform = this->changeUniform(name, value, 16 * sizeof(GLfloat)))
+		glUniformMatrix4fv(uniform->Location, 1, GL_FALSE, value);
+}
+
+void GLState::UniformBlock(const GLchar* name, GLuint binding)
+{
+	if (!this->program || this->programID == 0)
+		return;
+	std::unordered_map<std::string, GLuint>::iterator found = this->program->Blocks.find(name);
+	if (found != this->program->Blocks.end() && found->second == binding)
+	{
+		this->Frame.Saved[CALL_UNIFORM]++;
+		return;
+	}
+	this->program->Blocks[name] = binding;
+	this->Frame.Issued[CALL_UNIFORM]++;
+	GLuint block = glGetUniformBlockIndex(this->programID, name);
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(this->programID, block, binding);
+}
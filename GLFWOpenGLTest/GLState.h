@@ -0,0 +1,149 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "Shader.h"
+
+// Kinds of calls the GLState filters
+enum State_Call {
+	CALL_PROGRAM,
+	CALL_VERTEX_ARRAY,
+	CALL_BUFFER,
+	CALL_TEXTURE,
+	CALL_UNIFORM,
+	// glGetUniformLocation, only the first lookup of a name in a program goes to GL
+	CALL_UNIFORM_LOCATION,
+	CALL_KIND_COUNT
+};
+
+struct State_Counters
+{
+	// Calls passed on to GL, and calls filtered out because they would have set what was set already
+	unsigned Issued[CALL_KIND_COUNT];
+	unsigned Saved[CALL_KIND_COUNT];
+
+	State_Counters();
+	unsigned GetIssued() const;
+	unsigned GetSaved() const;
+};
+
+// Remembers what is bound, program, vertex array, buffers and the textures of each unit, and the value of every
+// uniform set through it, and only calls GL for what changes. Each call the driver doesn't see is validation and
+// state tracking it doesn't do. Everything starts out unknown, so the first call always goes through.
+// Code that binds or deletes behind its back leaves it believing in stale bindings; such code either goes
+// through it too or calls Reset afterwards.
+class GLState
+{
+public:
+	// Counts of the current frame and of the one before it
+	State_Counters Frame;
+	State_Counters LastFrame;
+
+	GLState();
+
+	// Starts counting a new frame
+	void BeginFrame();
+	// Forgets every binding, the next call of each kind goes to GL. Uniforms are set again after a UseProgram
+	void Reset();
+
+	// Uses the program of shader. Uniform values are remembered per program and forgotten when a rebuild
+	// replaces it
+	void UseProgram(const Shader& shader);
+	void BindVertexArray(GLuint vertexArray);
+	// The element array buffer belongs to the vertex array and is forgotten when that changes
+	void BindBuffer(GLenum target, GLuint buffer);
+	// Binds a range of buffer to binding point index of target, GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER.
+	// GL binds buffer to target as well
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	// Binds texture to unit, making unit the active one
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	// Binds texture to the active unit
+	void BindTexture(GLenum target, GLuint texture);
+	GLuint GetActiveTexture() const { return this->activeUnit; }
+	// Delete the object and forget the bindings of it, GL unbinds it and may hand its ID to the next object
+	void DeleteVertexArray(GLuint vertexArray);
+	void DeleteBuffer(GLuint buffer);
+	void DeleteTexture(GLuint texture);
+	// Also forgets the uniforms of the program, GL hands its ID to the next program
+	void DeleteProgram(GLuint program);
+
+	// Location of the uniform name in the program in use, asked from GL once per program. -1 without one
+	GLint GetUniformLocation(const GLchar* name);
+	// Set a uniform of the program in use if its value changed. Uniforms the program doesn't have are no calls
+	void Uniform1i(const GLchar* name, GLint value);
+	void Uniform1f(const GLchar* name, GLfloat value);
+	void Uniform3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z);
+	void Uniform4fv(const GLchar* name, const GLfloat* value);
+	void UniformMatrix4fv(const GLchar* name, const GLfloat* value);
+	// Points the uniform block name of the program in use at binding point binding. GLSL 330 can't say the
+	// binding in the shader, so this is asked from GL once per program
+	void UniformBlock(const GLchar* name, GLuint binding);
+
+private:
+	struct Uniform
+	{
+		GLint Location;
+		// Bytes of the value last set, 0 before the first
+		GLsizei Size;
+		GLfloat Value[16];
+	};
+	struct Program
+	{
+		unsigned Revision;
+		typedef std::unordered_map<std::string, Uniform> UniformMap;
+		UniformMap Uniforms;
+		// The name and uniform each name pointer was found as. Names are mostly literals, so a lookup hashes the
+		// pointer instead of building a std::string of the name every call
+		std::unordered_map<const GLchar*, UniformMap::value_type*> Names;
+		// Binding point of every uniform block pointed at one
+		std::unordered_map<std::string, GLuint> Blocks;
+	};
+	struct Binding
+	{
+		GLenum Target;
+		GLuint Object;
+		bool Known;
+	};
+	struct RangeBinding
+	{
+		GLuint Buffer;
+		GLintptr Offset;
+		GLsizeiptr Size;
+		bool Known;
+	};
+
+	std::unordered_map<GLuint, Program> programs;
+	// The program in use, 0 while unknown
+	Program* program;
+	GLuint programID;
+	GLuint vertexArray;
+	bool vertexArrayKnown;
+	std::vector<Binding> buffers;
+	// Ranges bound to the uniform block binding points, then to the shader storage ones
+	std::vector<RangeBinding> ranges;
+	GLuint activeUnit;
+	bool activeUnitKnown;
+	// Texture bindings of every unit, the targets of a unit next to each other
+	std::vector<Binding> textures;
+
+	// Whether a call of kind that binds object where binding is now is needed, counting it either way
+	bool change(State_Call kind, Binding& binding, GLuint object);
+	Binding* findBuffer(GLenum target);
+	Binding* findTexture(GLuint unit, GLenum target);
+	// The uniform name of the program in use, looking up its location the first time. 0 without a program
+	Uniform* findUniform(const GLchar* name);
+	// The uniform name of the program in use if value differs from the one it has, which becomes its value
+	Uniform* changeUniform(const GLchar* name, const void* value, GLsizei size);
+
+	GLState(const GLState&);
+	GLState& operator=(const GLState&);
+};
+#endif
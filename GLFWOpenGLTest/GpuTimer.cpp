@@ -0,0 +1,47 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer(unsigned frames)
+	: Time(0.0), queries(frames, 0), next(0), pending(0), running(false)
+{
+	glGenQueries(frames, &this->queries[0]);
+}
+
+void GpuTimer::Begin()
+{
+	// Results come in the order the queries were made, the oldest pending one first
+	unsigned frames = (unsigned)this->queries.size();
+	while (this->pending)
+	{
+		GLuint query = this->queries[(this->next + frames - this->pending) % frames];
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+		this->Time = elapsed / 1000000.0;
+		this->pending--;
+	}
+	if (this->pending == frames)
+		return;
+	glBeginQuery(GL_TIME_ELAPSED, this->queries[this->next]);
+	this->running = true;
+}
+
+void GpuTimer::End()
+{
+	if (!this->running)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	this->running = false;
+	this->next = (this->next + 1) % this->queries.size();
+	this->pending++;
+}
+
+void GpuTimer::Release()
+{
+	if (!this->queries.empty() && this->queries[0])
+		glDeleteQueries((GLsizei)this->queries.size(), &this->queries[0]);
+	this->queries.assign(this->queries.size(), 0);
+	this->pending = 0;
+}
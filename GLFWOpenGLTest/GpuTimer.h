@@ -0,0 +1,38 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Times the GPU work of the draws between Begin and End with GL_TIME_ELAPSED queries. The GPU runs frames behind,
+// so every frame gets its own query of a ring and a result is only read once GL has it, never waiting for it.
+// Only one timer can run at a time, GL doesn't nest elapsed time queries
+class GpuTimer
+{
+public:
+	// Milliseconds of the newest frame GL has finished timing
+	double Time;
+
+	// Constructor makes a ring of frames queries. Needs a current context
+	GpuTimer(unsigned frames = 4);
+
+	// Picks up the finished results and starts timing. A frame that finds every query still pending isn't timed
+	void Begin();
+	void End();
+	// Deletes the queries. Call while the GL context is still current, before glfwTerminate
+	void Release();
+
+private:
+	std::vector<GLuint> queries;
+	// The query the next Begin uses, and how many before it are still waiting for their results
+	unsigned next;
+	unsigned pending;
+	bool running;
+
+	GpuTimer(const GpuTimer&);
+	GpuTimer& operator=(const GpuTimer&);
+};
+#endif
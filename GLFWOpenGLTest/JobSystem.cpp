@@ -0,0 +1,133 @@
+#include "JobSystem.h"
+
+
+JobSystem::JobSystem(unsigned threadCount) : pending(0), queued(0), nextWorker(0), quit(false)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	// All queues have to exist before the first worker starts looking for work to steal
+	for (unsigned i = 0; i < threadCount; i++)
+		this->workers.push_back(new Worker());
+	for (unsigned i = 0; i < threadCount; i++)
+		this->workers[i]->Thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	this->Wait();
+	{
+		std::lock_guard<std::mutex> lock(this->sleepLock);
+		this->quit = true;
+	}
+	this->wakeUp.notify_all();
+	// Join everyone before freeing anything, a worker still on its way out may be scanning the other queues
+	for (size_t i = 0; i < this->workers.size(); i++)
+		this->workers[i]->Thread.join();
+	for (size_t i = 0; i < this->workers.size(); i++)
+		delete this->workers[i];
+}
+
+void JobSystem::Submit(Job job)
+{
+	Worker* worker = this->workers[this->nextWorker++ % this->workers.size()];
+	this->pending++;
+	{
+		std::lock_guard<std::mutex> lock(worker->Lock);
+		worker->Jobs.push_back(job);
+		this->queued++;
+	}
+	// Taking the sleep lock makes sure a worker that just found nothing is already waiting when we notify
+	std::lock_guard<std::mutex> lock(this->sleepLock);
+	this->wakeUp.notify_one();
+}
+
+void JobSystem::Wait()
+{
+	Job job;
+	unsigned index = 0;
+	while (this->pending > 0)
+	{
+		// Help out instead of blocking, starting the search at a different queue every time
+		if (this->findJob(index++ % this->workers.size(), job))
+		{
+			this->runJob(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(this->sleepLock);
+		if (this->pending > 0)
+			this->allDone.wait(lock);
+	}
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (grain == 0)
+		grain = 1;
+	for (size_t begin = 0; begin < count; begin += grain)
+	{
+		size_t end = begin + grain < count ? begin + grain : count;
+		this->Submit([&body, begin, end]() { body(begin, end); });
+	}
+	this->Wait();
+}
+
+void JobSystem::workerLoop(unsigned index)
+{
+	Job job;
+	for (;;)
+	{
+		if (this->findJob(index, job))
+		{
+			this->runJob(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(this->sleepLock);
+		if (this->quit)
+			return;
+		// Jobs are queued before the notify under sleepLock, so rechecking the count here can't miss one
+		if (this->queued == 0)
+			this->wakeUp.wait(lock);
+	}
+}
+
+bool JobSystem::findJob(unsigned index, Job& job)
+{
+	Worker* own = this->workers[index];
+	{
+		std::lock_guard<std::mutex> lock(own->Lock);
+		if (!own->Jobs.empty())
+		{
+			job = own->Jobs.front();
+			own->Jobs.pop_front();
+			this->queued--;
+			return true;
+		}
+	}
+	for (size_t i = 1; i < this->workers.size(); i++)
+	{
+		Worker* victim = this->workers[(index + i) % this->workers.size()];
+		std::lock_guard<std::mutex> lock(victim->Lock);
+		if (!victim->Jobs.empty())
+		{
+			job = victim->Jobs.back();
+			victim->Jobs.pop_back();
+			this->queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::runJob(Job& job)
+{
+	job();
+	job = Job();
+	if (--this->pending == 0)
+	{
+		std::lock_guard<std::mutex> lock(this->sleepLock);
+		this->allDone.notify_all();
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+// Std. Includes
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// A pool of worker threads with one job queue per worker. Workers take jobs from the front of their own queue
+// and steal from the back of the others when theirs runs dry, so uneven jobs still keep every core busy.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Job;
+
+	// Constructor starts the workers, 0 threads means one per hardware thread
+	JobSystem(unsigned threadCount = 0);
+	// Destructor finishes the queued jobs and joins the workers
+	~JobSystem();
+
+	// Queues a job, spreading consecutive submissions round robin over the workers
+	void Submit(Job job);
+	// Blocks until every submitted job has run. The calling thread runs jobs too while it waits.
+	// Must not be called from inside a job, the job itself would never count as finished
+	void Wait();
+	// Splits [0, count) into ranges of at most grain items, runs body(begin, end) for each and waits
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	unsigned GetThreadCount() const { return (unsigned)this->workers.size(); }
+
+private:
+	struct Worker
+	{
+		std::mutex Lock;
+		std::deque<Job> Jobs;
+		std::thread Thread;
+	};
+
+	std::vector<Worker*> workers;
+	// Jobs submitted but not finished, and the part of those still sitting in a queue
+	std::atomic<size_t> pending;
+	std::atomic<size_t> queued;
+	std::atomic<unsigned> nextWorker;
+	std::atomic<bool> quit;
+	// Idle workers sleep here until new work is submitted
+	std::mutex sleepLock;
+	std::condition_variable wakeUp;
+	std::condition_variable allDone;
+
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	void workerLoop(unsigned index);
+	// Pops a job from the worker's own queue, or steals one from another worker
+	bool findJob(unsigned index, Job& job);
+	void runJob(Job& job);
+};
+#endif
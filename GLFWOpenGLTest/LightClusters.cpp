@@ -0,0 +1,270 @@
+#include "LightClusters.h"
+
+// Std. Includes
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <functional>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define LIGHTCLUSTERS_SSE2
+#include <emmintrin.h>
+#endif
+
+// A light stops reaching where it falls below this part of its brightest color, about one step of an 8 bit channel
+static const GLfloat lightThreshold = 1.0f / 256.0f;
+
+// The brightest channel of a light up close, all its colors together
+static GLfloat lightBrightness(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular)
+{
+	glm::vec3 color = ambient + diffuse + specular;
+	return std::max(color.r, std::max(color.g, color.b));
+}
+
+// How far a light reaches, where 1 / (constant + linear d + quadratic d^2) times brightest drops to lightThreshold
+static GLfloat lightRange(GLfloat brightest, GLfloat constant, GLfloat linear, GLfloat quadratic)
+{
+	GLfloat rest = constant - brightest / lightThreshold;
+	if (rest >= 0.0f)
+		return 0.0f;
+	if (quadratic > 0.0f)
+		return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * rest)) / (2.0f * quadratic);
+	if (linear > 0.0f)
+		return -rest / linear;
+	return FLT_MAX;
+}
+
+// Writes index + the set bits of mask to visible from written on, lowest first, without a branch per light
+static void writeVisible(unsigned* visible, size_t& written, unsigned index, int mask, int lanes)
+{
+	for (int bit = 0; bit < lanes; bit++)
+	{
+		visible[written] = index + bit;
+		written += (mask >> bit) & 1;
+	}
+}
+
+// Replaces visible with the spheres of bounds overlapping the box from min to max: the distance from the center
+// to the box is the part of each axis outside it
+static void overlapBox(const SphereBounds& bounds, const glm::vec3& min, const glm::vec3& max, std::vector<unsigned>& visible)
+{
+	size_t count = bounds.GetSize();
+	visible.resize(count);
+	if (!count)
+		return;
+	const float *x = &bounds.X[0], *y = &bounds.Y[0], *z = &bounds.Z[0], *radius = &bounds.Radius[0];
+	size_t written = 0, i = 0;
+#ifdef LIGHTCLUSTERS_SSE2
+	__m128 minX = _mm_set1_ps(min.x), minY = _mm_set1_ps(min.y), minZ = _mm_set1_ps(min.z);
+	__m128 maxX = _mm_set1_ps(max.x), maxY = _mm_set1_ps(max.y), maxZ = _mm_set1_ps(max.z);
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i), r = _mm_loadu_ps(radius + i);
+		__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, px), zero), _mm_max_ps(_mm_sub_ps(px, maxX), zero));
+		__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, py), zero), _mm_max_ps(_mm_sub_ps(py, maxY), zero));
+		__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, pz), zero), _mm_max_ps(_mm_sub_ps(pz, maxZ), zero));
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		writeVisible(&visible[0], written, (unsigned)i, _mm_movemask_ps(_mm_cmple_ps(distance, _mm_mul_ps(r, r))), 4);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float dx = std::max(min.x - x[i], 0.0f) + std::max(x[i] - max.x, 0.0f);
+		float dy = std::max(min.y - y[i], 0.0f) + std::max(y[i] - max.y, 0.0f);
+		float dz = std::max(min.z - z[i], 0.0f) + std::max(z[i] - max.z, 0.0f);
+		visible[written] = (unsigned)i;
+		written += dx * dx + dy * dy + dz * dz <= radius[i] * radius[i] ? 1 : 0;
+	}
+	visible.resize(written);
+}
+
+// Copies the spheres of source listed in visible to target, and the indices they stand for from sourceIndices,
+// or the positions in source themselves without it
+static void gather(const SphereBounds& source, const unsigned* sourceIndices, const std::vector<unsigned>& visible,
+	SphereBounds& target, std::vector<unsigned>& targetIndices)
+{
+	target.Clear();
+	targetIndices.clear();
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		unsigned index = visible[i];
+		target.Add(glm::vec3(source.X[index], source.Y[index], source.Z[index]), source.Radius[index]);
+		targetIndices.push_back(sourceIndices ? sourceIndices[index] : index);
+	}
+}
+
+LightClusters::LightClusters(JobSystem& jobs, unsigned tilesX, unsigned tilesY, unsigned slices, unsigned maxClusterLights)
+	: MaxLights(0), Culled(0), Dropped(0), Overflows(0), jobs(jobs), tilesX(tilesX), tilesY(tilesY), slices(slices), maxClusterLights(maxClusterLights),
+	sliceScale(0.0f), sliceBias(0.0f), projection(0.0f), sliceData(slices)
+{
+	this->grid.assign(this->GetClusterCount() * 2, 0);
+}
+
+void LightClusters::Clear()
+{
+	this->lights.clear();
+	this->bounds.Clear();
+	this->brightness.clear();
+}
+
+unsigned LightClusters::AddPointLight(const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+	GLfloat constant, GLfloat linear, GLfloat quadratic)
+{
+	// A cone of every direction
+	return this->AddSpotLight(position, glm::vec3(0.0f, 0.0f, -1.0f), -2.0f, -3.0f, ambient, diffuse, specular, constant, linear, quadratic);
+}
+
+unsigned LightClusters::AddSpotLight(const glm::vec3& position, const glm::vec3& direction, GLfloat cutOff, GLfloat outerCutOff,
+	const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, GLfloat constant, GLfloat linear, GLfloat quadratic)
+{
+	ClusterLight light;
+	light.Position = position;
+	light.OuterCutOff = outerCutOff;
+	light.Ambient = ambient;
+	light.Constant = constant;
+	light.Diffuse = diffuse;
+	light.Linear = linear;
+	light.Specular = specular;
+	light.Quadratic = quadratic;
+	light.Direction = direction;
+	light.CutOff = cutOff;
+	this->lights.push_back(light);
+	GLfloat brightest = lightBrightness(ambient, diffuse, specular);
+	this->brightness.push_back(brightest);
+	this->bounds.Add(position, lightRange(brightest, constant, linear, quadratic));
+	return (unsigned)this->lights.size() - 1;
+}
+
+void LightClusters::build(const glm::mat4& projection)
+{
+	this->projection = projection;
+	// The planes from the depth terms of the projection, -(far + near) / (far - near) and -2 far near / (far - near)
+	GLfloat nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	GLfloat farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	// Slice k starts at near * (far / near)^(k / slices), so log(depth) * scale + bias is the slice of a depth
+	GLfloat depthRatio = std::log(farPlane / nearPlane);
+	this->sliceScale = this->slices / depthRatio;
+	this->sliceBias = -(GLfloat)this->slices * std::log(nearPlane) / depthRatio;
+
+	// The box around each cluster, from its corners at the near and far depth of its slice. At depth d the view
+	// space x of NDC x is x * d / projection[0][0], likewise y. Rows go up from the bottom, like gl_FragCoord
+	this->clusterMin.resize(this->GetClusterCount());
+	this->clusterMax.resize(this->GetClusterCount());
+	for (unsigned s = 0; s < this->slices; s++)
+	{
+		GLfloat sliceNear = nearPlane * std::pow(farPlane / nearPlane, (GLfloat)s / this->slices);
+		GLfloat sliceFar = nearPlane * std::pow(farPlane / nearPlane, (GLfloat)(s + 1) / this->slices);
+		for (unsigned y = 0; y < this->tilesY; y++)
+		{
+			GLfloat bottom = -1.0f + 2.0f * y / this->tilesY, top = -1.0f + 2.0f * (y + 1) / this->tilesY;
+			for (unsigned x = 0; x < this->tilesX; x++)
+			{
+				GLfloat left = -1.0f + 2.0f * x / this->tilesX, right = -1.0f + 2.0f * (x + 1) / this->tilesX;
+				unsigned index = x + this->tilesX * (y + this->tilesY * s);
+				this->clusterMin[index] = glm::vec3(std::min(left * sliceNear, left * sliceFar) / projection[0][0],
+					std::min(bottom * sliceNear, bottom * sliceFar) / projection[1][1], -sliceFar);
+				this->clusterMax[index] = glm::vec3(std::max(right * sliceNear, right * sliceFar) / projection[0][0],
+					std::max(top * sliceNear, top * sliceFar) / projection[1][1], -sliceNear);
+			}
+		}
+	}
+}
+
+void LightClusters::Assign(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (projection != this->projection)
+		this->build(projection);
+
+	// The lights picked, where the clusters are, in view space
+	this->select(view, projection);
+	this->selectedLights.clear();
+	this->viewLights.Clear();
+	for (size_t i = 0; i < this->selection.size(); i++)
+	{
+		unsigned index = this->selection[i];
+		this->selectedLights.push_back(this->lights[index]);
+		this->viewLights.Add(glm::vec3(view * glm::vec4(this->lights[index].Position, 1.0f)), this->bounds.Radius[index]);
+	}
+
+	this->jobs.ParallelFor(this->slices, 1, [this](size_t begin, size_t end)
+	{
+		for (size_t slice = begin; slice < end; slice++)
+			this->assignSlice((unsigned)slice);
+	});
+
+	// The lists of the slices one after the other
+	this->indices.clear();
+	this->Overflows = 0;
+	unsigned sliceClusters = this->tilesX * this->tilesY;
+	for (unsigned s = 0; s < this->slices; s++)
+	{
+		const Slice& slice = this->sliceData[s];
+		GLuint offset = (GLuint)this->indices.size();
+		for (unsigned c = 0; c < sliceClusters; c++)
+		{
+			this->grid[2 * (s * sliceClusters + c)] = offset;
+			this->grid[2 * (s * sliceClusters + c) + 1] = slice.Counts[c];
+			offset += slice.Counts[c];
+		}
+		this->indices.insert(this->indices.end(), slice.Lists.begin(), slice.Lists.end());
+		this->Overflows += slice.Overflows;
+	}
+}
+
+void LightClusters::select(const glm::mat4& view, const glm::mat4& projection)
+{
+	CullSpheres(Frustum(projection * view), this->bounds, this->selection);
+	this->Culled = this->lights.size() - this->selection.size();
+	this->Dropped = 0;
+	if (!this->MaxLights || this->selection.size() <= this->MaxLights)
+		return;
+
+	// A sphere of radius r at distance d spans an angle whose tangent is r / sqrt(d^2 - r^2) from the camera, its
+	// area on screen goes with the square of that. Lights around the camera are everywhere and always kept
+	this->ranking.clear();
+	for (size_t i = 0; i < this->selection.size(); i++)
+	{
+		unsigned index = this->selection[i];
+		glm::vec3 center = glm::vec3(view * glm::vec4(this->lights[index].Position, 1.0f));
+		GLfloat radius = this->bounds.Radius[index];
+		GLfloat outside = glm::dot(center, center) - radius * radius;
+		GLfloat importance = outside > 0.0f ? this->brightness[index] * radius * radius / outside : FLT_MAX;
+		this->ranking.push_back(std::make_pair(importance, index));
+	}
+	std::nth_element(this->ranking.begin(), this->ranking.begin() + this->MaxLights, this->ranking.end(),
+		std::greater<std::pair<GLfloat, unsigned> >());
+	// Back in the order they were added, so the lists of a cluster keep reading the lights in order
+	this->selection.resize(this->MaxLights);
+	for (unsigned i = 0; i < this->MaxLights; i++)
+		this->selection[i] = this->ranking[i].second;
+	std::sort(this->selection.begin(), this->selection.end());
+	this->Dropped = this->ranking.size() - this->MaxLights;
+}
+
+void LightClusters::assignSlice(unsigned s)
+{
+	Slice& slice = this->sliceData[s];
+	slice.Counts.assign(this->tilesX * this->tilesY, 0);
+	slice.Lists.clear();
+	slice.Overflows = 0;
+	// Each step keeps the lights of the one before reaching a smaller box: the slice, a row, a cluster
+	unsigned first = this->tilesX * this->tilesY * s;
+	unsigned last = first + this->tilesX * this->tilesY - 1;
+	overlapBox(this->viewLights, this->clusterMin[first], this->clusterMax[last], slice.Visible);
+	gather(this->viewLights, 0, slice.Visible, slice.Lights, slice.Indices);
+	for (unsigned y = 0; y < this->tilesY && slice.Lights.GetSize(); y++)
+	{
+		unsigned rowFirst = first + y * this->tilesX, rowLast = rowFirst + this->tilesX - 1;
+		overlapBox(slice.Lights, this->clusterMin[rowFirst], this->clusterMax[rowLast], slice.Visible);
+		gather(slice.Lights, &slice.Indices[0], slice.Visible, slice.RowLights, slice.RowIndices);
+		for (unsigned x = 0; x < this->tilesX && slice.RowLights.GetSize(); x++)
+		{
+			overlapBox(slice.RowLights, this->clusterMin[rowFirst + x], this->clusterMax[rowFirst + x], slice.Visible);
+			size_t count = std::min(slice.Visible.size(), (size_t)this->maxClusterLights);
+			for (size_t i = 0; i < count; i++)
+				slice.Lists.push_back(slice.RowIndices[slice.Visible[i]]);
+			slice.Counts[y * this->tilesX + x] = (GLuint)count;
+			slice.Overflows += slice.Visible.size() - count;
+		}
+	}
+}
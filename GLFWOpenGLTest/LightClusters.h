@@ -0,0 +1,128 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+// Std. Includes
+#include <vector>
+#include <utility>
+
+// GL Includes
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+// Project includes
+#include "JobSystem.h"
+#include "Frustum.h"
+
+// A point or spot light as LightBuffer.txt reads it from its buffer texture, 5 RGBA32F texels. Point lights have cut
+// offs below -1, every direction is inside the cone then
+struct ClusterLight
+{
+	glm::vec3 Position;
+	GLfloat OuterCutOff;
+	glm::vec3 Ambient;
+	GLfloat Constant;
+	glm::vec3 Diffuse;
+	GLfloat Linear;
+	glm::vec3 Specular;
+	GLfloat Quadratic;
+	glm::vec3 Direction;
+	GLfloat CutOff;
+};
+
+static_assert(sizeof(ClusterLight) == 80, "ClusterLight isn't 5 texels");
+
+// Clustered light assignment. The view frustum is cut into tiles across the screen and slices in depth, thinner
+// near the camera, and every cluster gets the list of the lights whose range reaches into it, so a fragment only
+// lights with the few lights of its cluster instead of all of them. The lists are made on the CPU every frame: a
+// job per slice first keeps the lights reaching its depths, then per row of tiles, then tests those against each
+// cluster's box, four lights at a time with SSE2.
+// A light reaches as far as its attenuation keeps it above 1/256 of its brightest color. Spot lights are culled
+// by the sphere of that range, not by their cone. Before any of that the spheres are culled against the frustum,
+// and past MaxLights only the lights that matter most on screen are kept: the brightest over the largest part of
+// the view, by brightness times the squared tangent of the angle their sphere spans from the camera
+class LightClusters
+{
+public:
+	// The most lights Assign keeps, 0 for all of them in view
+	unsigned MaxLights;
+	// Of the lights of the last Assign, the ones outside the frustum, the ones past MaxLights, and the entries
+	// dropped from clusters already holding the most they can
+	size_t Culled;
+	size_t Dropped;
+	size_t Overflows;
+
+	// Constructor cuts the frustum into tilesX x tilesY x slices clusters, of at most maxClusterLights lights each
+	LightClusters(JobSystem& jobs, unsigned tilesX = 16, unsigned tilesY = 9, unsigned slices = 24, unsigned maxClusterLights = 256);
+
+	void Clear();
+	// Adds a light for the next Assign. Both return its index, the one GetSelection lists
+	unsigned AddPointLight(const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+		GLfloat constant, GLfloat linear, GLfloat quadratic);
+	unsigned AddSpotLight(const glm::vec3& position, const glm::vec3& direction, GLfloat cutOff, GLfloat outerCutOff,
+		const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, GLfloat constant, GLfloat linear, GLfloat quadratic);
+	// Picks the lights to draw with and makes the light lists of every cluster for the camera. projection is a
+	// symmetric perspective projection, the clusters span its near to far plane
+	void Assign(const glm::mat4& view, const glm::mat4& projection);
+
+	// The lights Assign picked, the ones the lists index, and the index each was added with
+	const std::vector<ClusterLight>& GetLights() const { return this->selectedLights; }
+	const std::vector<unsigned>& GetSelection() const { return this->selection; }
+	size_t GetAddedCount() const { return this->lights.size(); }
+	// Where the lights of every cluster start in GetIndices and how many there are, two values a cluster. Clusters
+	// go across, then down, then into the screen
+	const std::vector<GLuint>& GetGrid() const { return this->grid; }
+	const std::vector<GLuint>& GetIndices() const { return this->indices; }
+	// The cluster counts for the shader, and the scale and bias that make log(view depth) the slice
+	glm::uvec4 GetCount() const { return glm::uvec4(this->tilesX, this->tilesY, this->slices, 0); }
+	GLfloat GetSliceScale() const { return this->sliceScale; }
+	GLfloat GetSliceBias() const { return this->sliceBias; }
+	unsigned GetClusterCount() const { return this->tilesX * this->tilesY * this->slices; }
+	unsigned GetMaxClusterLights() const { return this->maxClusterLights; }
+
+private:
+	// What a slice's job keeps between frames, so assigning allocates nothing once warm
+	struct Slice
+	{
+		// The lights reaching the slice and the ones of those reaching the row, structure of arrays
+		SphereBounds Lights;
+		std::vector<unsigned> Indices;
+		SphereBounds RowLights;
+		std::vector<unsigned> RowIndices;
+		std::vector<unsigned> Visible;
+		// Light count per cluster of the slice and their indices one cluster after the other
+		std::vector<GLuint> Counts;
+		std::vector<GLuint> Lists;
+		size_t Overflows;
+	};
+
+	JobSystem& jobs;
+	unsigned tilesX;
+	unsigned tilesY;
+	unsigned slices;
+	unsigned maxClusterLights;
+	GLfloat sliceScale;
+	GLfloat sliceBias;
+	std::vector<ClusterLight> lights;
+	// Every light's sphere, as far as it reaches, and its brightest channel
+	SphereBounds bounds;
+	std::vector<GLfloat> brightness;
+	// The lights picked for the frame being assigned, their spheres in view space and their importance while picking
+	std::vector<unsigned> selection;
+	std::vector<ClusterLight> selectedLights;
+	SphereBounds viewLights;
+	std::vector<std::pair<GLfloat, unsigned> > ranking;
+	// The projection the cluster boxes were made for, and the view space box of every cluster
+	glm::mat4 projection;
+	std::vector<glm::vec3> clusterMin;
+	std::vector<glm::vec3> clusterMax;
+	std::vector<Slice> sliceData;
+	std::vector<GLuint> grid;
+	std::vector<GLuint> indices;
+
+	// Makes the cluster boxes for projection
+	void build(const glm::mat4& projection);
+	// Fills the selection with the lights in the frustum, the most important MaxLights of them if there are more
+	void select(const glm::mat4& view, const glm::mat4& projection);
+	void assignSlice(unsigned slice);
+};
+#endif
@@ -0,0 +1,137 @@
+#include "MeshArena.h"
+
+// GL Includes
+#include <GLFW\glfw3.h>
+
+MeshArena::MeshArena() : vertexArray(0), vertexBuffer(0), indexBuffer(0)
+{
+}
+
+void MeshArena::Release(GLState& state)
+{
+	if (!this->vertexArray)
+		return;
+	state.DeleteVertexArray(this->vertexArray);
+	state.DeleteBuffer(this->vertexBuffer);
+	state.DeleteBuffer(this->indexBuffer);
+	this->vertexArray = this->vertexBuffer = this->indexBuffer = 0;
+}
+
+MeshRange MeshArena::Add(const GLfloat* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount,
+	const glm::mat4& transform)
+{
+	GLuint base = this->GetVertexCount();
+	// Normals go through the inverse transpose, so scaling doesn't bend them
+	glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+	for (GLuint i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = vertices + i * VertexSize;
+		glm::vec4 position = transform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f);
+		glm::vec3 normal = glm::normalize(normalTransform * glm::vec3(vertex[3], vertex[4], vertex[5]));
+		GLfloat baked[VertexSize] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, vertex[6], vertex[7] };
+		this->vertices.insert(this->vertices.end(), baked, baked + VertexSize);
+	}
+
+	MeshRange range;
+	range.FirstIndex = this->GetIndexCount();
+	range.IndexCount = indices ? indexCount : vertexCount;
+	for (GLuint i = 0; i < range.IndexCount; i++)
+		this->indices.push_back(base + (indices ? indices[i] : i));
+	return range;
+}
+
+void MeshArena::Upload(GLState& state)
+{
+	if (!this->vertexArray)
+	{
+		glGenVertexArrays(1, &this->vertexArray);
+		glGenBuffers(1, &this->vertexBuffer);
+		glGenBuffers(1, &this->indexBuffer);
+	}
+	state.BindVertexArray(this->vertexArray);
+	state.BindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(GLfloat), this->vertices.empty() ? 0 : &this->vertices[0], GL_STATIC_DRAW);
+	state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), this->indices.empty() ? 0 : &this->indices[0], GL_STATIC_DRAW);
+
+	// Position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VertexSize * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	// Normal attribute
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VertexSize * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	// TexCoord attribute
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VertexSize * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+}
+
+IndirectBatch::IndirectBatch() : Indirect(GLEW_ARB_multi_draw_indirect && GLEW_ARB_draw_indirect), Draws(0), DrawCalls(0),
+	SubmitTime(0.0), commandBuffer(0), commandCapacity(0)
+{
+}
+
+void IndirectBatch::Release(GLState& state)
+{
+	if (this->commandBuffer)
+		state.DeleteBuffer(this->commandBuffer);
+	this->commandBuffer = 0;
+	this->commandCapacity = 0;
+}
+
+void IndirectBatch::Add(const MeshRange& range)
+{
+	Command command = { range.IndexCount, 1, range.FirstIndex, 0, 0 };
+	// Meshes that follow each other in the arena are one range, and one command
+	if (!this->commands.empty())
+	{
+		Command& last = this->commands.back();
+		if (last.FirstIndex + last.Count == range.FirstIndex)
+		{
+			last.Count += range.IndexCount;
+			this->Draws++;
+			return;
+		}
+	}
+	this->commands.push_back(command);
+	this->Draws++;
+}
+
+void IndirectBatch::Draw(GLState& state, const MeshArena& arena)
+{
+	double start = glfwGetTime();
+	this->DrawCalls = 0;
+	this->SubmitTime = 0.0;
+	if (this->commands.empty())
+		return;
+	state.BindVertexArray(arena.GetVertexArray());
+	if (this->Indirect)
+	{
+		// A new store every frame, the driver hands out fresh memory instead of waiting for last frame's draws
+		size_t bytes = this->commands.size() * sizeof(Command);
+		if (!this->commandBuffer)
+			glGenBuffers(1, &this->commandBuffer);
+		state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+		if (bytes > this->commandCapacity)
+			this->commandCapacity = bytes;
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, this->commandCapacity, 0, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, &this->commands[0]);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)this->commands.size(), 0);
+		this->DrawCalls = 1;
+	}
+	else
+	{
+		for (size_t i = 0; i < this->commands.size(); i++)
+		{
+			const Command& command = this->commands[i];
+			glDrawElements(GL_TRIANGLES, command.Count, GL_UNSIGNED_INT, (GLvoid*)(command.FirstIndex * sizeof(GLuint)));
+		}
+		this->DrawCalls = (unsigned)this->commands.size();
+	}
+	this->SubmitTime = (glfwGetTime() - start) * 1000.0;
+}
+
+void IndirectBatch::Clear()
+{
+	this->commands.clear();
+	this->Draws = 0;
+}
@@ -0,0 +1,98 @@
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+// Project includes
+#include "GLState.h"
+
+// Where a mesh's indices are in the arena
+struct MeshRange
+{
+	GLuint FirstIndex;
+	GLuint IndexCount;
+};
+
+// Static meshes merged into one vertex buffer and one index buffer behind one vertex array, so meshes that
+// differ can still be drawn by a single call. A mesh is baked into the arena where it stands, its transform
+// applied to the positions and normals, and its indices point straight at its vertices, so meshes added one
+// after the other are also one range of indices
+class MeshArena
+{
+public:
+	// Floats per vertex: position, normal and texture coordinates, attributes 0, 1 and 2
+	static const GLuint VertexSize = 8;
+
+	MeshArena();
+
+	// Adds a mesh placed by transform. Without indices the vertices are taken as a triangle list
+	MeshRange Add(const GLfloat* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount,
+		const glm::mat4& transform = glm::mat4());
+	// Uploads what was added, call once everything is added. Meshes added afterwards need another Upload
+	void Upload(GLState& state);
+	// Deletes the buffers. Call while the GL context is still current, before glfwTerminate
+	void Release(GLState& state);
+
+	GLuint GetVertexArray() const { return this->vertexArray; }
+	GLuint GetVertexCount() const { return (GLuint)(this->vertices.size() / VertexSize); }
+	GLuint GetIndexCount() const { return (GLuint)this->indices.size(); }
+
+private:
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	GLuint vertexArray;
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+
+	MeshArena(const MeshArena&);
+	MeshArena& operator=(const MeshArena&);
+};
+
+// The meshes of an arena to draw in a frame. With GL_ARB_multi_draw_indirect the draw commands are written to a
+// buffer and one glMultiDrawElementsIndirect draws them all; a 3.3 context without it gets a loop of
+// glDrawElements instead, with the ranges that follow each other in the arena merged into one draw
+class IndirectBatch
+{
+public:
+	// Whether Draw uses glMultiDrawElementsIndirect
+	bool Indirect;
+	// Meshes drawn and GL draw calls made by the last Draw, and the milliseconds it took the CPU to make them
+	unsigned Draws;
+	unsigned DrawCalls;
+	double SubmitTime;
+
+	IndirectBatch();
+
+	// Adds a mesh to draw
+	void Add(const MeshRange& range);
+	// Draws the meshes added since the last Clear from the vertex array of arena, with the program in use
+	void Draw(GLState& state, const MeshArena& arena);
+	void Clear();
+	// Deletes the command buffer. Call while the GL context is still current, before glfwTerminate
+	void Release(GLState& state);
+
+private:
+	// The layout glMultiDrawElementsIndirect reads
+	struct Command
+	{
+		GLuint Count;
+		GLuint InstanceCount;
+		GLuint FirstIndex;
+		GLint BaseVertex;
+		GLuint BaseInstance;
+	};
+
+	std::vector<Command> commands;
+	GLuint commandBuffer;
+	// Bytes the command buffer holds
+	size_t commandCapacity;
+
+	IndirectBatch(const IndirectBatch&);
+	IndirectBatch& operator=(const IndirectBatch&);
+};
+#endif
@@ -0,0 +1,277 @@
+#include "MipChain.h"
+
+// Std. Includes
+#include <cmath>
+#include <algorithm>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MIPCHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+// GL Includes
+#include <glm/glm.hpp>
+#include <glm/gtc/color_space.hpp>
+#include <glm/gtc/constants.hpp>
+
+// Lookup tables between 8-bit sRGB and linear, built from glm's conversions once before main runs
+// (a function local static would be simpler, but VS2013 doesn't initialize those thread safe)
+struct SrgbTables
+{
+	// Fine enough that a step of the table stays well below a step of 8-bit sRGB, even in the darks
+	static const unsigned LinearSteps = 16384;
+
+	float ToLinear[256];
+	unsigned char ToSrgb[LinearSteps + 1];
+
+	SrgbTables()
+	{
+		for (unsigned i = 0; i < 256; i++)
+			this->ToLinear[i] = glm::convertSRGBToLinear(glm::vec3(i / 255.0f)).x;
+		for (unsigned i = 0; i <= LinearSteps; i++)
+			this->ToSrgb[i] = (unsigned char)(glm::convertLinearToSRGB(glm::vec3((float)i / LinearSteps)).x * 255.0f + 0.5f);
+	}
+};
+static const SrgbTables srgbTables;
+
+// Filtering works on one RGBA texel of floats at a time, all four channels in one SSE register
+#ifdef MIPCHAIN_SSE2
+typedef __m128 Texel;
+
+static inline Texel texelZero() { return _mm_setzero_ps(); }
+static inline Texel texelLoad(const float* texel) { return _mm_loadu_ps(texel); }
+static inline void texelStore(float* texel, Texel value) { _mm_storeu_ps(texel, value); }
+static inline Texel texelMulAdd(Texel sum, Texel value, float weight) { return _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weight))); }
+#else
+struct Texel { float C[4]; };
+
+static inline Texel texelZero() { Texel t = { { 0.0f, 0.0f, 0.0f, 0.0f } }; return t; }
+static inline Texel texelLoad(const float* texel) { Texel t = { { texel[0], texel[1], texel[2], texel[3] } }; return t; }
+static inline void texelStore(float* texel, Texel value) { for (int c = 0; c < 4; c++) texel[c] = value.C[c]; }
+static inline Texel texelMulAdd(Texel sum, Texel value, float weight)
+{
+	for (int c = 0; c < 4; c++)
+		sum.C[c] += value.C[c] * weight;
+	return sum;
+}
+#endif
+
+// For every texel of the smaller level along one axis: the source texels it reads and their weights.
+// Every texel has the same amount of taps, the shorter ones are padded with zero weights.
+struct FilterTaps
+{
+	unsigned Count;
+	std::vector<unsigned> Index;
+	std::vector<float> Weight;
+};
+
+// Modified Bessel function of the first kind, by its power series which converges fast for the window's arguments
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// Kaiser windowed sinc, x in texels of the smaller level. Alpha 4 and radius 2 trade a little ringing for sharpness
+static double kaiser(double x)
+{
+	const double radius = 2.0, alpha = 4.0;
+	if (fabs(x) >= radius)
+		return 0.0;
+	double r = x / radius;
+	double window = besselI0(alpha * sqrt(1.0 - r * r)) / besselI0(alpha);
+	double px = glm::pi<double>() * x;
+	return x == 0.0 ? window : sin(px) / px * window;
+}
+
+static unsigned sourceIndex(int i, unsigned size, bool wrap)
+{
+	if (wrap)
+		return (unsigned)(((i % (int)size) + (int)size) % (int)size);
+	return i < 0 ? 0 : i >= (int)size ? size - 1 : (unsigned)i;
+}
+
+static void buildTaps(FilterTaps& taps, unsigned sourceSize, unsigned size, Mip_Filter filter, bool wrap)
+{
+	double scale = (double)sourceSize / size;
+	// Reach of the filter around the center of a texel, in source texels
+	double support = filter == MIP_KAISER && sourceSize > size ? 2.0 * scale : 0.5 * scale;
+	unsigned maxTaps = (unsigned)ceil(2.0 * support) + 1;
+
+	std::vector<unsigned> first(size), count(size);
+	std::vector<double> weights(size * maxTaps);
+	taps.Count = 0;
+	for (unsigned i = 0; i < size; i++)
+	{
+		double center = (i + 0.5) * scale;
+		int start = (int)floor(center - support);
+		double sum = 0.0;
+		for (unsigned k = 0; k < maxTaps; k++)
+		{
+			double j = start + (int)k, weight;
+			if (filter == MIP_KAISER && sourceSize > size)
+				weight = kaiser((j + 0.5 - center) / scale);
+			else // Overlap of the source texel with the footprint of the texel
+				weight = std::max(0.0, std::min(j + 1.0, center + support) - std::max(j, center - support));
+			weights[i * maxTaps + k] = weight;
+			sum += weight;
+		}
+		// Trim the zero weights at both ends, so box filtering by two ends up with exactly two taps
+		unsigned begin = 0, end = maxTaps;
+		while (begin < end && fabs(weights[i * maxTaps + begin]) < 1e-9)
+			begin++;
+		while (end > begin && fabs(weights[i * maxTaps + end - 1]) < 1e-9)
+			end--;
+		for (unsigned k = begin; k < end; k++)
+			weights[i * maxTaps + k] /= sum;
+		first[i] = begin;
+		count[i] = end - begin;
+		taps.Count = std::max(taps.Count, end - begin);
+	}
+
+	taps.Index.assign(size * taps.Count, 0);
+	taps.Weight.assign(size * taps.Count, 0.0f);
+	for (unsigned i = 0; i < size; i++)
+	{
+		int start = (int)floor((i + 0.5) * scale - support) + (int)first[i];
+		for (unsigned k = 0; k < taps.Count; k++)
+		{
+			taps.Index[i * taps.Count + k] = sourceIndex(start + (int)k, sourceSize, wrap);
+			if (k < count[i])
+				taps.Weight[i * taps.Count + k] = (float)weights[i * maxTaps + first[i] + k];
+		}
+	}
+}
+
+// Linear (for sRGB) premultiplied float texels from RGBA8
+static void loadTexels(std::vector<float>& texels, const unsigned char* pixels, size_t count, bool srgb)
+{
+	texels.resize(count * 4);
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned char* pixel = &pixels[i * 4];
+		float alpha = pixel[3] / 255.0f;
+		for (int c = 0; c < 3; c++)
+			texels[i * 4 + c] = (srgb ? srgbTables.ToLinear[pixel[c]] : pixel[c] / 255.0f) * alpha;
+		texels[i * 4 + 3] = alpha;
+	}
+}
+
+static void storeTexels(std::vector<unsigned char>& pixels, const std::vector<float>& texels, size_t count, bool srgb)
+{
+	pixels.resize(count * 4);
+	for (size_t i = 0; i < count; i++)
+	{
+		// The Kaiser filter rings a little past the input range, clamp it away
+		float alpha = std::min(std::max(texels[i * 4 + 3], 0.0f), 1.0f);
+		float unpremultiply = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+		for (int c = 0; c < 3; c++)
+		{
+			float value = std::min(std::max(texels[i * 4 + c] * unpremultiply, 0.0f), 1.0f);
+			pixels[i * 4 + c] = srgb ? srgbTables.ToSrgb[(unsigned)(value * SrgbTables::LinearSteps + 0.5f)]
+				: (unsigned char)(value * 255.0f + 0.5f);
+		}
+		pixels[i * 4 + 3] = (unsigned char)(alpha * 255.0f + 0.5f);
+	}
+}
+
+// Filters every row of source (width x height) down to size texels
+static void filterRows(std::vector<float>& out, const std::vector<float>& source, unsigned width, unsigned height, unsigned size, const FilterTaps& taps)
+{
+	out.resize((size_t)size * height * 4);
+	for (unsigned y = 0; y < height; y++)
+	{
+		const float* row = &source[(size_t)y * width * 4];
+		float* outRow = &out[(size_t)y * size * 4];
+		for (unsigned x = 0; x < size; x++)
+		{
+			const unsigned* index = &taps.Index[x * taps.Count];
+			const float* weight = &taps.Weight[x * taps.Count];
+			Texel sum = texelZero();
+			for (unsigned k = 0; k < taps.Count; k++)
+				sum = texelMulAdd(sum, texelLoad(&row[index[k] * 4]), weight[k]);
+			texelStore(&outRow[x * 4], sum);
+		}
+	}
+}
+
+// Filters the columns of source (width x height) down to size texels. Works a whole row at a time,
+// adding weighted source rows into the output row, so all reads stay sequential.
+static void filterColumns(std::vector<float>& out, const std::vector<float>& source, unsigned width, unsigned size, const FilterTaps& taps)
+{
+	out.assign((size_t)width * size * 4, 0.0f);
+	for (unsigned y = 0; y < size; y++)
+	{
+		float* outRow = &out[(size_t)y * width * 4];
+		for (unsigned k = 0; k < taps.Count; k++)
+		{
+			const float* row = &source[(size_t)taps.Index[y * taps.Count + k] * width * 4];
+			float weight = taps.Weight[y * taps.Count + k];
+			if (weight == 0.0f)
+				continue;
+			for (unsigned x = 0; x < width; x++)
+				texelStore(&outRow[x * 4], texelMulAdd(texelLoad(&outRow[x * 4]), texelLoad(&row[x * 4]), weight));
+		}
+	}
+}
+
+MipChain::MipChain(const unsigned char* pixels, unsigned width, unsigned height, Mip_Filter filter, bool srgb, bool wrap)
+{
+	this->Build(pixels, width, height, filter, srgb, wrap);
+}
+
+void MipChain::Build(const unsigned char* pixels, unsigned width, unsigned height, Mip_Filter filter, bool srgb, bool wrap,
+	unsigned maxLevels)
+{
+	this->Levels.clear();
+	if (width == 0 || height == 0)
+		return;
+
+	unsigned levelCount = 1;
+	for (unsigned size = std::max(width, height); size > 1; size /= 2)
+		levelCount++;
+	if (maxLevels != 0)
+		levelCount = std::min(levelCount, maxLevels);
+	// Reserved up front, VS2013 would copy every level when the vector grows
+	this->Levels.reserve(levelCount);
+	this->Levels.push_back(MipLevel());
+	this->Levels[0].Width = width;
+	this->Levels[0].Height = height;
+	this->Levels[0].Pixels.assign(pixels, pixels + (size_t)width * height * 4);
+
+	// Every level is filtered from the float texels of the one above, not from its rounded 8-bit pixels
+	std::vector<float> current, rows, next;
+	FilterTaps horizontal, vertical;
+	loadTexels(current, pixels, (size_t)width * height, srgb);
+	unsigned w = width, h = height;
+	while (this->Levels.size() < levelCount)
+	{
+		unsigned nextW = std::max(w / 2, 1u), nextH = std::max(h / 2, 1u);
+		buildTaps(horizontal, w, nextW, filter, wrap);
+		buildTaps(vertical, h, nextH, filter, wrap);
+		filterRows(rows, current, w, h, nextW, horizontal);
+		filterColumns(next, rows, nextW, nextH, vertical);
+
+		this->Levels.push_back(MipLevel());
+		MipLevel& level = this->Levels.back();
+		level.Width = nextW;
+		level.Height = nextH;
+		storeTexels(level.Pixels, next, (size_t)nextW * nextH, srgb);
+
+		current.swap(next);
+		w = nextW;
+		h = nextH;
+	}
+}
+
+size_t MipChain::GetByteSize() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < this->Levels.size(); i++)
+		bytes += this->Levels[i].Pixels.size();
+	return bytes;
+}
@@ -0,0 +1,45 @@
+#ifndef MIPCHAIN_H
+#define MIPCHAIN_H
+
+// Std. Includes
+#include <vector>
+#include <cstddef>
+
+// Downsampling filters for building the smaller levels
+enum Mip_Filter {
+	// Average over the footprint of each texel, fast and good enough for most textures
+	MIP_BOX,
+	// Kaiser windowed sinc over 4 texels of the smaller level in each direction, keeps the small levels sharper
+	MIP_KAISER
+};
+
+// One level of a mip chain, RGBA8 with tightly packed rows
+struct MipLevel
+{
+	unsigned Width;
+	unsigned Height;
+	std::vector<unsigned char> Pixels;
+};
+
+// Builds a full mip chain on the CPU at load time, so textures can be uploaded level by level
+// instead of waiting on glGenerateMipmap in the driver
+class MipChain
+{
+public:
+	// Level 0 is the input itself, the last level is 1x1 unless Build stopped earlier
+	std::vector<MipLevel> Levels;
+
+	MipChain() {}
+	// Constructor builds the chain from RGBA8 pixels, e.g. the output of lodepng::decode.
+	// sRGB textures are filtered in linear space, so the smaller levels don't turn darker than the texture is.
+	// Color is filtered premultiplied by alpha either way, so transparent texels don't bleed into the edges of cutouts.
+	// wrap samples across the edges for textures drawn with GL_REPEAT, otherwise the edge texels repeat outwards.
+	MipChain(const unsigned char* pixels, unsigned width, unsigned height, Mip_Filter filter = MIP_BOX, bool srgb = true, bool wrap = true);
+
+	// maxLevels stops the chain after that many levels, for textures that never use the smallest ones. 0 builds all
+	void Build(const unsigned char* pixels, unsigned width, unsigned height, Mip_Filter filter = MIP_BOX, bool srgb = true, bool wrap = true,
+		unsigned maxLevels = 0);
+	// Bytes of all levels together, what the texture takes in memory uncompressed
+	size_t GetByteSize() const;
+};
+#endif
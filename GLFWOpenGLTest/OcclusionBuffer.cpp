@@ -0,0 +1,276 @@
+#include "OcclusionBuffer.h"
+
+// Std. Includes
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define OCCLUSIONBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Triangles smaller than this many square pixels cover no pixel center worth the setup
+static const float minimumArea = 1.0e-6f;
+
+OcclusionBuffer::OcclusionBuffer(JobSystem& jobs, unsigned width, unsigned height)
+	: Tested(0), Occluded(0), jobs(jobs)
+{
+	this->tilesX = std::max(1u, (width + tileWidth - 1) / tileWidth);
+	this->tilesY = std::max(1u, (height + tileHeight - 1) / tileHeight);
+	this->width = this->tilesX * tileWidth;
+	this->height = this->tilesY * tileHeight;
+	this->bins.resize(this->tilesX * this->tilesY);
+
+	// Every level half the one below, rounded up, down to a single texel
+	Level level = { this->width, this->height, 0 };
+	this->levels.push_back(level);
+	while (level.Width > 1 || level.Height > 1)
+	{
+		level.Offset += level.Width * level.Height;
+		level.Width = (level.Width + 1) / 2;
+		level.Height = (level.Height + 1) / 2;
+		this->levels.push_back(level);
+	}
+	this->depths.assign(level.Offset + 1, 1.0f);
+}
+
+void OcclusionBuffer::BeginFrame(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	this->triangles.clear();
+	this->Tested = 0;
+	this->Occluded = 0;
+}
+
+void OcclusionBuffer::AddOccluder(const GLfloat* vertices, GLuint stride, GLuint vertexCount, const glm::mat4& model)
+{
+	glm::mat4 transform = this->viewProjection * model;
+	for (GLuint i = 0; i + 2 < vertexCount; i += 3)
+	{
+		Triangle triangle;
+		bool inFront = true;
+		for (int c = 0; c < 3 && inFront; c++)
+		{
+			const GLfloat* position = vertices + (i + c) * stride;
+			glm::vec4 clip = transform * glm::vec4(position[0], position[1], position[2], 1.0f);
+			// Past the near plane, where dividing by w would turn the triangle inside out
+			if (clip.w <= 0.0f || clip.z < -clip.w)
+			{
+				inFront = false;
+				break;
+			}
+			float inverse = 1.0f / clip.w;
+			triangle.Corners[c] = glm::vec3((clip.x * inverse * 0.5f + 0.5f) * this->width,
+				(clip.y * inverse * 0.5f + 0.5f) * this->height, clip.z * inverse);
+		}
+		if (inFront)
+			this->triangles.push_back(triangle);
+	}
+}
+
+void OcclusionBuffer::Rasterize()
+{
+	// Every tile gets the triangles whose bounds overlap it
+	for (size_t i = 0; i < this->bins.size(); i++)
+		this->bins[i].clear();
+	for (size_t i = 0; i < this->triangles.size(); i++)
+	{
+		const Triangle& triangle = this->triangles[i];
+		glm::vec3 low = glm::min(glm::min(triangle.Corners[0], triangle.Corners[1]), triangle.Corners[2]);
+		glm::vec3 high = glm::max(glm::max(triangle.Corners[0], triangle.Corners[1]), triangle.Corners[2]);
+		if (high.x < 0.0f || high.y < 0.0f || low.x >= this->width || low.y >= this->height)
+			continue;
+		// Clamped as floats, a corner near the eye can be far outside the range of an int
+		unsigned x0 = (unsigned)std::max(0.0f, low.x) / tileWidth, y0 = (unsigned)std::max(0.0f, low.y) / tileHeight;
+		unsigned x1 = (unsigned)std::min(high.x, this->width - 1.0f) / tileWidth, y1 = (unsigned)std::min(high.y, this->height - 1.0f) / tileHeight;
+		for (unsigned y = y0; y <= y1; y++)
+		{
+			for (unsigned x = x0; x <= x1; x++)
+				this->bins[y * this->tilesX + x].push_back((unsigned)i);
+		}
+	}
+
+	// The tiles touch disjoint pixels of every level up to the one where a tile is one texel
+	this->jobs.ParallelFor(this->bins.size(), 1, [this](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; tile++)
+			this->rasterizeTile((unsigned)tile);
+	});
+	for (unsigned level = 1; level < this->levels.size(); level++)
+	{
+		if ((tileWidth >> level) == 0 || (tileHeight >> level) == 0)
+			this->reduce(level, 0, 0, this->levels[level].Width - 1, this->levels[level].Height - 1);
+	}
+}
+
+void OcclusionBuffer::rasterizeTile(unsigned tile)
+{
+	unsigned tileX = tile % this->tilesX, tileY = tile / this->tilesX;
+	unsigned x0 = tileX * tileWidth, y0 = tileY * tileHeight;
+	for (unsigned y = y0; y < y0 + tileHeight; y++)
+		std::fill(&this->depths[y * this->width + x0], &this->depths[y * this->width + x0] + tileWidth, 1.0f);
+	const std::vector<unsigned>& bin = this->bins[tile];
+	for (size_t i = 0; i < bin.size(); i++)
+		this->drawTriangle(this->triangles[bin[i]], x0, y0, x0 + tileWidth, y0 + tileHeight);
+	for (unsigned level = 1; (tileWidth >> level) > 0 && (tileHeight >> level) > 0; level++)
+	{
+		unsigned width = tileWidth >> level, height = tileHeight >> level;
+		this->reduce(level, tileX * width, tileY * height, (tileX + 1) * width - 1, (tileY + 1) * height - 1);
+	}
+}
+
+void OcclusionBuffer::drawTriangle(const Triangle& triangle, unsigned x0, unsigned y0, unsigned x1, unsigned y1)
+{
+	// Counter clockwise, so the edge functions are positive inside
+	glm::vec3 a = triangle.Corners[0], b = triangle.Corners[1], c = triangle.Corners[2];
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area < 0.0f)
+	{
+		std::swap(b, c);
+		area = -area;
+	}
+	if (area < minimumArea)
+		return;
+
+	// The pixels of the tile under the triangle's bounds, whole groups of four across
+	float lowX = std::min(std::min(a.x, b.x), c.x), highX = std::max(std::max(a.x, b.x), c.x);
+	float lowY = std::min(std::min(a.y, b.y), c.y), highY = std::max(std::max(a.y, b.y), c.y);
+	int minX = (int)std::floor(std::max((float)x0, lowX)) & ~3, maxX = (int)std::ceil(std::min(x1 - 1.0f, highX));
+	int minY = (int)std::floor(std::max((float)y0, lowY)), maxY = (int)std::ceil(std::min(y1 - 1.0f, highY));
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// Each edge function is step.x * x + step.y * y + start, the weight of the corner across from the edge
+	// times area. The depth is the corners' depths by those weights, another plane over the screen
+	const glm::vec3* corners[3] = { &a, &b, &c };
+	float stepX[3], stepY[3], start[3];
+	for (int e = 0; e < 3; e++)
+	{
+		const glm::vec3& from = *corners[(e + 1) % 3];
+		const glm::vec3& to = *corners[(e + 2) % 3];
+		stepX[e] = from.y - to.y;
+		stepY[e] = to.x - from.x;
+		start[e] = -(stepX[e] * from.x + stepY[e] * from.y);
+	}
+	float depthX = (stepX[0] * a.z + stepX[1] * b.z + stepX[2] * c.z) / area;
+	float depthY = (stepY[0] * a.z + stepY[1] * b.z + stepY[2] * c.z) / area;
+	float depthStart = (start[0] * a.z + start[1] * b.z + start[2] * c.z) / area;
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float* row = &this->depths[y * this->width];
+		float pixelY = y + 0.5f;
+#ifdef OCCLUSIONBUFFER_SSE2
+		// Four pixels a step, the edges and depth of the first and how much they change over the four
+		__m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		__m128 edges[3], edgeSteps[3];
+		for (int e = 0; e < 3; e++)
+		{
+			edges[e] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(stepX[e]), _mm_add_ps(_mm_set1_ps((float)minX), lanes)),
+				_mm_set1_ps(stepY[e] * pixelY + start[e]));
+			edgeSteps[e] = _mm_set1_ps(stepX[e] * 4.0f);
+		}
+		__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthX), _mm_add_ps(_mm_set1_ps((float)minX), lanes)),
+			_mm_set1_ps(depthY * pixelY + depthStart));
+		__m128 depthStep = _mm_set1_ps(depthX * 4.0f);
+		__m128 zero = _mm_setzero_ps();
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edges[0], zero), _mm_cmpge_ps(edges[1], zero)), _mm_cmpge_ps(edges[2], zero));
+			if (_mm_movemask_ps(inside))
+			{
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(old, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+			for (int e = 0; e < 3; e++)
+				edges[e] = _mm_add_ps(edges[e], edgeSteps[e]);
+			depth = _mm_add_ps(depth, depthStep);
+		}
+#else
+		for (int x = minX; x < ((maxX + 4) & ~3); x++)
+		{
+			float pixelX = x + 0.5f;
+			bool inside = true;
+			for (int e = 0; e < 3; e++)
+				inside = inside && stepX[e] * pixelX + stepY[e] * pixelY + start[e] >= 0.0f;
+			float depth = depthX * pixelX + depthY * pixelY + depthStart;
+			if (inside && depth < row[x])
+				row[x] = depth;
+		}
+#endif
+	}
+}
+
+void OcclusionBuffer::reduce(unsigned level, unsigned x0, unsigned y0, unsigned x1, unsigned y1)
+{
+	// The farthest of the 2x2 texels below, clamped at the edge of a level with an odd size
+	const Level& source = this->levels[level - 1];
+	const Level& target = this->levels[level];
+	const float* below = &this->depths[source.Offset];
+	float* above = &this->depths[target.Offset];
+	for (unsigned y = y0; y <= y1; y++)
+	{
+		unsigned top = 2 * y, bottom = std::min(2 * y + 1, source.Height - 1);
+		for (unsigned x = x0; x <= x1; x++)
+		{
+			unsigned left = 2 * x, right = std::min(2 * x + 1, source.Width - 1);
+			above[y * target.Width + x] = std::max(std::max(below[top * source.Width + left], below[top * source.Width + right]),
+				std::max(below[bottom * source.Width + left], below[bottom * source.Width + right]));
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const Aabb& bounds)
+{
+	this->Tested++;
+	// The corners are the transformed minimum corner plus any of the transformed edges
+	glm::vec3 size = bounds.Max - bounds.Min;
+	glm::vec4 base = this->viewProjection * glm::vec4(bounds.Min, 1.0f);
+	glm::vec4 edges[3] = { this->viewProjection[0] * size.x, this->viewProjection[1] * size.y, this->viewProjection[2] * size.z };
+	glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+	float nearest = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 clip = base;
+		for (int e = 0; e < 3; e++)
+		{
+			if (i & (1 << e))
+				clip += edges[e];
+		}
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+			return true;
+		float inverse = 1.0f / clip.w;
+		glm::vec2 pixel((clip.x * inverse * 0.5f + 0.5f) * this->width, (clip.y * inverse * 0.5f + 0.5f) * this->height);
+		low = glm::min(low, pixel);
+		high = glm::max(high, pixel);
+		nearest = std::min(nearest, clip.z * inverse);
+	}
+	if (high.x < 0.0f || high.y < 0.0f || low.x >= this->width || low.y >= this->height)
+		return true;
+	unsigned x0 = (unsigned)std::max(0.0f, low.x), y0 = (unsigned)std::max(0.0f, low.y);
+	unsigned x1 = (unsigned)std::min(high.x, this->width - 1.0f), y1 = (unsigned)std::min(high.y, this->height - 1.0f);
+
+	// The level where the box covers at most 2x2 texels
+	unsigned level = 0;
+	while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+		level++;
+	const Level& texels = this->levels[level];
+	const float* depth = &this->depths[texels.Offset];
+	float farthest = -1.0f;
+	for (unsigned y = y0 >> level; y <= std::min(y1 >> level, texels.Height - 1); y++)
+	{
+		for (unsigned x = x0 >> level; x <= std::min(x1 >> level, texels.Width - 1); x++)
+			farthest = std::max(farthest, depth[y * texels.Width + x]);
+	}
+	if (nearest <= farthest)
+		return true;
+	this->Occluded++;
+	return false;
+}
+
+float OcclusionBuffer::GetDepth(unsigned level, unsigned x, unsigned y) const
+{
+	const Level& texels = this->levels[level];
+	return this->depths[texels.Offset + y * texels.Width + x];
+}
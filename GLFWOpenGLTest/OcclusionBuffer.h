@@ -0,0 +1,87 @@
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+// Project includes
+#include "JobSystem.h"
+#include "Bvh.h"
+
+// Occlusion culling on the CPU. The triangles of a few big occluders are rasterized into a small depth buffer,
+// four pixels at a time with SSE2, one tile per job, and the depth buffer is reduced into a pyramid where every
+// texel holds the farthest depth of the four below it. A box is hidden when its nearest point is farther than the
+// farthest depth of the at most 2x2 pyramid texels it covers, so testing costs the same for boxes of any size.
+// Never hides what is visible, errs the other way: occluder triangles crossing the near plane are left out, and
+// boxes crossing it or off the screen count as visible. Needs no GL or window, so it also runs without a GPU
+class OcclusionBuffer
+{
+public:
+	// Boxes tested and found hidden since BeginFrame
+	unsigned Tested;
+	unsigned Occluded;
+
+	// Constructor makes a buffer of at least width x height pixels, rounded up to whole tiles
+	OcclusionBuffer(JobSystem& jobs, unsigned width = 256, unsigned height = 128);
+
+	// Clears the buffer for a frame seen through viewProjection
+	void BeginFrame(const glm::mat4& viewProjection);
+	// Queues a triangle list placed by model. Stride is the floats per vertex, the position the first 3 of them
+	void AddOccluder(const GLfloat* vertices, GLuint stride, GLuint vertexCount, const glm::mat4& model);
+	// Draws the queued occluders and builds the pyramid. Call once all occluders are added, before any test
+	void Rasterize();
+	// Whether any of the box may be seen past the occluders
+	bool IsVisible(const Aabb& bounds);
+
+	unsigned GetWidth() const { return this->width; }
+	unsigned GetHeight() const { return this->height; }
+	// Depth of a pixel of a level of the pyramid, level 0 the buffer itself. NDC depth, -1 near and 1 far
+	float GetDepth(unsigned level, unsigned x, unsigned y) const;
+	unsigned GetLevelCount() const { return (unsigned)this->levels.size(); }
+	size_t GetTriangleCount() const { return this->triangles.size(); }
+
+private:
+	// Pixels a job rasterizes, a power of two each way so the first levels of the pyramid stay inside the tile
+	static const unsigned tileWidth = 32;
+	static const unsigned tileHeight = 32;
+
+	// A triangle in pixels, x and y, and its NDC depth
+	struct Triangle
+	{
+		glm::vec3 Corners[3];
+	};
+
+	struct Level
+	{
+		unsigned Width;
+		unsigned Height;
+		// Where the level starts in depths
+		size_t Offset;
+	};
+
+	JobSystem& jobs;
+	unsigned width;
+	unsigned height;
+	unsigned tilesX;
+	unsigned tilesY;
+	glm::mat4 viewProjection;
+	std::vector<Triangle> triangles;
+	// The triangles overlapping every tile
+	std::vector<std::vector<unsigned> > bins;
+	// All levels of the pyramid, one after the other
+	std::vector<float> depths;
+	std::vector<Level> levels;
+
+	void rasterizeTile(unsigned tile);
+	void drawTriangle(const Triangle& triangle, unsigned x0, unsigned y0, unsigned x1, unsigned y1);
+	// Fills the part of level from the level below it, for x in x0..x1 and y in y0..y1 of the level
+	void reduce(unsigned level, unsigned x0, unsigned y0, unsigned x1, unsigned y1);
+
+	OcclusionBuffer(const OcclusionBuffer&);
+	OcclusionBuffer& operator=(const OcclusionBuffer&);
+};
+#endif
@@ -0,0 +1,77 @@
+#include "RenderQueue.h"
+
+// GL Includes
+#include <GLFW\glfw3.h>
+#include <glm\gtc\type_ptr.hpp>
+
+RenderQueue::RenderQueue(size_t capacity) : SortTime(0.0), ExecuteTime(0.0), sorted(true)
+{
+	this->packets.reserve(capacity);
+	this->items.reserve(capacity);
+	this->scratch.reserve(capacity);
+}
+
+void RenderQueue::Submit(unsigned long long key, const DrawPacket& packet)
+{
+	SortItem item;
+	item.Key = key;
+	item.Index = (unsigned)this->packets.size();
+	this->items.push_back(item);
+	this->packets.push_back(packet);
+	this->sorted = false;
+}
+
+void RenderQueue::Submit(const CommandList& list)
+{
+	SortItem item;
+	for (size_t i = 0; i < list.Keys.size(); i++)
+	{
+		item.Key = list.Keys[i];
+		item.Index = (unsigned)(this->packets.size() + i);
+		this->items.push_back(item);
+	}
+	this->packets.insert(this->packets.end(), list.Packets.begin(), list.Packets.end());
+	if (!list.Keys.empty())
+		this->sorted = false;
+}
+
+void RenderQueue::Submit(const CommandRecorder& recorder)
+{
+	for (size_t i = 0; i < recorder.GetListCount(); i++)
+		this->Submit(recorder.GetList(i));
+}
+
+void RenderQueue::Sort()
+{
+	if (this->sorted)
+		return;
+	double start = glfwGetTime();
+	// Only the keys and indices move, the packets stay where they were submitted
+	RadixSort(this->items, this->scratch);
+	this->sorted = true;
+	this->SortTime = (glfwGetTime() - start) * 1000.0;
+}
+
+void RenderQueue::Execute(GLState& state)
+{
+	this->Sort();
+	double start = glfwGetTime();
+	for (size_t i = 0; i < this->items.size(); i++)
+	{
+		const DrawPacket& packet = this->packets[this->items[i].Index];
+		state.UseProgram(*packet.Program);
+		state.BindVertexArray(packet.VertexArray);
+		if (packet.Texture)
+			state.BindTexture(0, packet.TextureTarget, packet.Texture);
+		state.UniformMatrix4fv("model", glm::value_ptr(packet.Model));
+		glDrawArrays(packet.Mode, packet.First, packet.Count);
+	}
+	this->ExecuteTime = (glfwGetTime() - start) * 1000.0;
+}
+
+void RenderQueue::Clear()
+{
+	this->packets.clear();
+	this->items.clear();
+	this->sorted = true;
+}
@@ -0,0 +1,51 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "Shader.h"
+#include "GLState.h"
+#include "DrawKey.h"
+#include "CommandList.h"
+
+// Collects the draws of a frame, sorts them by their keys and draws them through a GLState, so draws sharing a
+// program, vertex array and texture follow each other and the state filters the binds between them.
+// The queue keeps its memory from frame to frame, a frame with no more draws than any before allocates nothing.
+class RenderQueue
+{
+public:
+	// Milliseconds the last Sort and Execute took
+	double SortTime;
+	double ExecuteTime;
+
+	// Constructor reserves room for capacity draws, the queue grows past it if needed
+	RenderQueue(size_t capacity = 1024);
+
+	// Adds a draw, key from MakeDrawKey
+	void Submit(unsigned long long key, const DrawPacket& packet);
+	// Adds the draws recorded into list, or into every list of recorder in range order
+	void Submit(const CommandList& list);
+	void Submit(const CommandRecorder& recorder);
+	// Sorts the draws submitted so far. Execute sorts if this wasn't called
+	void Sort();
+	// Draws everything in key order
+	void Execute(GLState& state);
+	// Empties the queue for the next frame
+	void Clear();
+	size_t GetSize() const { return this->packets.size(); }
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	bool sorted;
+
+	RenderQueue(const RenderQueue&);
+	RenderQueue& operator=(const RenderQueue&);
+};
+#endif
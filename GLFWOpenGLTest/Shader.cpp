@@ -1,83 +1,169 @@
 #include "Shader.h"
 
+#include <algorithm>
 
-Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+#include <GLFW\glfw3.h>
+
+#include "GLState.h"
+
+// Revision of the next program swapped in, 0 is a shader without a program
+static unsigned nextRevision = 1;
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, ShaderCache* cache, const ShaderDefines& defines)
+	: Program(0), Revision(0), VertexPath(vertexPath), FragmentPath(fragmentPath), Defines(defines), CompileTime(0.0), LinkTime(0.0), FromCache(false), State(0),
+	pending(0), vertex(0), fragment(0), fallback(0)
+{
+	this->load();
+	this->submit(cache);
+	this->finish(cache);
+}
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines& defines, ShaderCache* cache, const Shader* fallback)
+	: Program(0), Revision(0), VertexPath(vertexPath), FragmentPath(fragmentPath), Defines(defines), CompileTime(0.0), LinkTime(0.0), FromCache(false), State(0),
+	pending(0), vertex(0), fragment(0), fallback(fallback)
 {
-	// 1. Retrieve the vertex/fragment source code from filePath
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	// ensures ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::badbit);
-	try
+	this->load();
+	this->submit(cache);
+}
+
+void Shader::load()
+{
+	// 1. Retrieve the vertex/fragment source code from filePath, with the includes and defines of the variant
+	std::vector<std::string> fragmentFiles;
+	bool read = PreprocessShader(this->vertexCode, this->VertexPath, this->Defines, &this->Files);
+	read = PreprocessShader(this->fragmentCode, this->FragmentPath, this->Defines, &fragmentFiles) && read;
+	if (!read)
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+	for (size_t i = 0; i < fragmentFiles.size(); i++)
 	{
-		// Open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		// Read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-		// Convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		if (std::find(this->Files.begin(), this->Files.end(), fragmentFiles[i]) == this->Files.end())
+			this->Files.push_back(fragmentFiles[i]);
 	}
-	catch (std::ifstream::failure e)
+}
+
+bool Shader::reload(ShaderCache* cache)
+{
+	// A program already compiling would be lost, the caller has to wait for IsReady and ask again. Unchanged
+	// sources, e.g. after saving without edits, aren't worth a rebuild
+	if (this->pending)
+		return false;
+	std::string vertexCode = this->vertexCode, fragmentCode = this->fragmentCode;
+	this->load();
+	if (this->vertexCode == vertexCode && this->fragmentCode == fragmentCode)
+		return false;
+	this->submit(cache);
+	return true;
+}
+
+void Shader::submit(ShaderCache* cache)
+{
+	// 2. Restore the program from the cache if it holds a binary of these sources for this driver
+	this->pending = glCreateProgram();
+	double start = glfwGetTime();
+	if (cache && cache->Load(this->pending, this->vertexCode, this->fragmentCode))
 	{
-		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		this->CompileTime = 0.0;
+		this->LinkTime = (glfwGetTime() - start) * 1000.0;
+		this->FromCache = true;
+		this->swap();
+		return;
 	}
-	const GLchar* vShaderCode = vertexCode.c_str();
-	const GLchar * fShaderCode = fragmentCode.c_str();
-	// 2. Compile shaders
-	GLuint vertex, fragment;
+	this->FromCache = false;
+	// 3. Compile shaders and link them. Nothing asks for a status here, so a driver that compiles on its own
+	// threads isn't made to wait and can work on the next program meanwhile
+	const GLchar* vShaderCode = this->vertexCode.c_str();
+	const GLchar * fShaderCode = this->fragmentCode.c_str();
+	start = glfwGetTime();
+	// Vertex Shader
+	this->vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(this->vertex, 1, &vShaderCode, NULL);
+	glCompileShader(this->vertex);
+	// Fragment Shader
+	this->fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(this->fragment, 1, &fShaderCode, NULL);
+	glCompileShader(this->fragment);
+	// Shader Program
+	if (cache && cache->IsSupported())
+		glProgramParameteri(this->pending, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(this->pending, this->vertex);
+	glAttachShader(this->pending, this->fragment);
+	glLinkProgram(this->pending);
+	this->CompileTime = (glfwGetTime() - start) * 1000.0;
+}
+
+bool Shader::isComplete() const
+{
+	GLint complete;
+	glGetProgramiv(this->pending, GL_COMPLETION_STATUS_ARB, &complete);
+	return complete != GL_FALSE;
+}
+
+void Shader::finish(ShaderCache* cache)
+{
+	if (!this->pending)
+		return;
+	double start = glfwGetTime();
 	GLint success;
 	GLchar infoLog[512];
-	// Vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
 	// Print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(this->vertex, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(this->vertex, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
-	// Fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	// Print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(this->fragment, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+		glGetShaderInfoLog(this->fragment, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
-	// Shader Program
-	this->Program = glCreateProgram();
-	glAttachShader(this->Program, vertex);
-	glAttachShader(this->Program, fragment);
-	glLinkProgram(this->Program);
 	// Print linking errors if any
-	glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
-	if (!success)
+	GLint linked;
+	glGetProgramiv(this->pending, GL_LINK_STATUS, &linked);
+	if (!linked)
 	{
-		glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		glGetProgramInfoLog(this->pending, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << this->VertexPath << " " << this->FragmentPath << "\n" << infoLog << std::endl;
 	}
+	// Keep the binary for the next run, a program that didn't link is compiled again to show its errors
+	else if (cache && cache->IsSupported())
+		cache->Store(this->pending, this->vertexCode, this->fragmentCode);
+	this->LinkTime = (glfwGetTime() - start) * 1000.0;
 	// Delete the shaders as they're linked into our program now and no longer necessery
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(this->vertex);
+	glDeleteShader(this->fragment);
+	this->vertex = this->fragment = 0;
 
+	// A broken edit keeps the program that worked, the next save tries again. Only a shader that has nothing
+	// else to draw with takes the broken one, as it always did
+	if (linked || this->GetProgram() == 0)
+		this->swap();
+	else
+	{
+		this->deleteProgram(this->pending);
+		this->pending = 0;
+	}
 }
-void Shader::Use()
+
+void Shader::swap()
+{
+	if (this->Program)
+		this->deleteProgram(this->Program);
+	this->Program = this->pending;
+	this->Revision = nextRevision++;
+	this->pending = 0;
+}
+
+void Shader::deleteProgram(GLuint program)
 {
-	glUseProgram(this->Program);
+	if (this->State)
+		this->State->DeleteProgram(program);
+	else
+		glDeleteProgram(program);
 }
 
+void Shader::Use()
+{
+	glUseProgram(this->GetProgram());
+}
@@ -5,20 +5,82 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 #include <GL\glew.h>
 
+#include "ShaderCache.h"
+#include "ShaderPreprocessor.h"
+
+class GLState;
+
 class Shader
 {
 public:
-	// Program ID
+	// Program ID of this shader's own program, 0 until the first one is swapped in
 	GLuint Program;
-	
-	// Constructor read and builds the shader
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
+	// Changes whenever Program does. GL hands the ID of a deleted program to the next one, revisions never repeat
+	unsigned Revision;
+	// Files the sources were read from, read again on a rebuild
+	std::string VertexPath;
+	std::string FragmentPath;
+	// Defines of the variant this shader is
+	ShaderDefines Defines;
+	// Every file read for the sources, their includes too
+	std::vector<std::string> Files;
+	// Milliseconds spent handing the compiles and the link to the driver, and waiting for their results afterwards.
+	// A program restored from the cache wasn't compiled, its LinkTime is the time the driver took to take the binary
+	double CompileTime;
+	double LinkTime;
+	bool FromCache;
+	// Programs are deleted through this if set, so it forgets their uniforms along with them
+	GLState* State;
+
+	// Constructor read and builds the shader, restoring it from cache instead if that holds it. defines select
+	// the variant to build
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, ShaderCache* cache = 0, const ShaderDefines& defines = ShaderDefines());
+
+	// False while a program is compiling. Meanwhile the program drawn with is the one built before, or for a shader
+	// added to a ShaderLibrary its fallback's. A program that fails to build never replaces a working one
+	bool IsReady() const { return this->pending == 0; }
+	// The program to draw with and its revision: Program, or the fallback's current one while there is none yet.
+	// Read every time, as a rebuild of the fallback replaces the program it lends
+	GLuint GetProgram() const { return this->Program || !this->fallback ? this->Program : this->fallback->GetProgram(); }
+	unsigned GetRevision() const { return this->Program || !this->fallback ? this->Revision : this->fallback->GetRevision(); }
 
 	// Use the program
 	void Use();
+
+private:
+	friend class ShaderLibrary;
+
+	std::string vertexCode;
+	std::string fragmentCode;
+	// The program being compiled and linked and its shaders, until finish swaps it in
+	GLuint pending;
+	GLuint vertex;
+	GLuint fragment;
+	// Drawn with until the shader has a program of its own, must outlive the shader
+	const Shader* fallback;
+
+	// Reads the sources and submits them without waiting for the driver, drawing with fallback until finish
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines& defines, ShaderCache* cache, const Shader* fallback);
+
+	void load();
+	// Reads the sources again and submits them if they changed. Returns false if nothing was submitted, always
+	// while a program is pending
+	bool reload(ShaderCache* cache);
+	// Restores the program from cache or hands the compiles and the link to the driver, without asking for any status
+	void submit(ShaderCache* cache);
+	// Whether the driver is done with the program, without waiting. Needs GL_KHR_parallel_shader_compile
+	bool isComplete() const;
+	// Waits for the program, prints its errors, stores it in cache and swaps it in
+	void finish(ShaderCache* cache);
+	// Makes pending the program, deleting the one it replaces
+	void swap();
+	void deleteProgram(GLuint program);
+
+	Shader(const Shader&);
+	Shader& operator=(const Shader&);
 };
 #endif
-
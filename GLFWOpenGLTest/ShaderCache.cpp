@@ -0,0 +1,136 @@
+#include "ShaderCache.h"
+
+// Std. Includes
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+
+// Project includes
+#include "FileCache.h"
+
+// Layout of a cache file: the header, then BinarySize bytes of the binary. Bump cacheVersion whenever the layout
+// changes, old files then count as misses.
+static const char cacheMagic[4] = { 'S', 'H', 'D', 'C' };
+static const unsigned cacheVersion = 2;
+
+struct CacheHeader
+{
+	char Magic[4];
+	unsigned Version;
+	unsigned long long SourceHash;
+	unsigned long long DriverHash;
+	unsigned BinaryFormat;
+	unsigned BinarySize;
+};
+
+static unsigned long long hashSources(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	// The length goes in too, moving code from one stage to the other must not hash the same
+	size_t vertexSize = vertexCode.size();
+	unsigned long long hash = HashBytes(&vertexSize, sizeof(vertexSize));
+	hash = HashBytes(vertexCode.data(), vertexCode.size(), hash);
+	return HashBytes(fragmentCode.data(), fragmentCode.size(), hash);
+}
+
+// A binary is only good for the exact driver that made it, the version string changes with every driver update
+static unsigned long long hashDriver()
+{
+	const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	unsigned long long hash = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const char* text = (const char*)glGetString(names[i]);
+		if (text)
+			hash = HashBytes(text, strlen(text) + 1, hash);
+	}
+	return hash;
+}
+
+ShaderCache::ShaderCache(const std::string& directory) : Directory(directory), Hits(0), Misses(0)
+{
+}
+
+bool ShaderCache::IsSupported() const
+{
+	if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+bool ShaderCache::Load(GLuint program, const std::string& vertexCode, const std::string& fragmentCode)
+{
+	if (!this->IsSupported())
+	{
+		this->Misses++;
+		return false;
+	}
+
+	unsigned long long sourceHash = hashSources(vertexCode, fragmentCode);
+	std::ifstream file(this->cachePath(sourceHash).c_str(), std::ios::binary);
+	CacheHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.Magic, cacheMagic, sizeof(cacheMagic)) != 0
+		|| header.Version != cacheVersion || header.SourceHash != sourceHash || header.DriverHash != hashDriver()
+		|| header.BinarySize == 0)
+	{
+		this->Misses++;
+		return false;
+	}
+	std::vector<char> binary(header.BinarySize);
+	if (!file.read(&binary[0], binary.size()))
+	{
+		this->Misses++;
+		return false;
+	}
+
+	// The driver can still turn the binary down, e.g. after an update that kept the version string
+	glProgramBinary(program, header.BinaryFormat, &binary[0], (GLsizei)binary.size());
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		this->Misses++;
+		return false;
+	}
+	this->Hits++;
+	return true;
+}
+
+bool ShaderCache::Store(GLuint program, const std::string& vertexCode, const std::string& fragmentCode) const
+{
+	if (!this->IsSupported())
+		return false;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+
+	CacheHeader header;
+	memcpy(header.Magic, cacheMagic, sizeof(cacheMagic));
+	header.Version = cacheVersion;
+	header.SourceHash = hashSources(vertexCode, fragmentCode);
+	header.DriverHash = hashDriver();
+
+	std::string blob(sizeof(header) + length, '\0');
+	GLsizei written = 0;
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &written, &format, &blob[sizeof(header)]);
+	if (written <= 0)
+		return false;
+	header.BinaryFormat = format;
+	header.BinarySize = (unsigned)written;
+	memcpy(&blob[0], &header, sizeof(header));
+	blob.resize(sizeof(header) + written);
+	return WriteCacheFile(this->Directory, this->cachePath(header.SourceHash), blob.data(), blob.size());
+}
+
+std::string ShaderCache::cachePath(unsigned long long sourceHash) const
+{
+	std::ostringstream path;
+	path << this->Directory << "/" << std::hex << std::setw(16) << std::setfill('0') << sourceHash << ".bin";
+	return path.str();
+}
@@ -0,0 +1,37 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+// Std. Includes
+#include <string>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Keeps linked programs on disk as the binaries the driver hands out, so later runs skip compiling and linking.
+// Every file records a hash of the sources and of the driver's vendor, renderer and version strings; edited
+// sources or another driver count as misses and the program is compiled again. Binaries only work on the driver
+// that made them, the files are a cache of this machine, not something to ship.
+class ShaderCache
+{
+public:
+	// Directory the cache files go to, created on the first store
+	std::string Directory;
+	// Programs restored from a binary and programs that had to be compiled
+	unsigned Hits;
+	unsigned Misses;
+
+	ShaderCache(const std::string& directory = "ShaderCache");
+
+	// Whether the driver gives out program binaries at all. Needs a current context
+	bool IsSupported() const;
+	// Restores the program linked from the sources into program. Returns false if there is no binary for them
+	// that this driver takes, program is then left unlinked for the caller to compile and link
+	bool Load(GLuint program, const std::string& vertexCode, const std::string& fragmentCode);
+	// Stores the binary of program, which must be linked from the sources. Set GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	// on it before linking, some drivers keep no binary otherwise
+	bool Store(GLuint program, const std::string& vertexCode, const std::string& fragmentCode) const;
+
+private:
+	std::string cachePath(unsigned long long sourceHash) const;
+};
+#endif
@@ -0,0 +1,97 @@
+#include "ShaderLibrary.h"
+
+// GLFW
+#include <GLFW\glfw3.h>
+
+// GL_KHR_parallel_shader_compile is newer than our GLEW. It shares its tokens with GL_ARB_parallel_shader_compile,
+// which GLEW knows, so only its entry point has to be fetched by hand
+typedef void (GLAPIENTRY * MaxShaderCompilerThreadsProc)(GLuint count);
+
+ShaderLibrary::ShaderLibrary(ShaderCache* cache) : Cache(cache), State(0), Parallel(false), SubmitTime(0.0), WaitTime(0.0)
+{
+	MaxShaderCompilerThreadsProc maxThreads = 0;
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+		maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if (GLEW_ARB_parallel_shader_compile)
+		maxThreads = glMaxShaderCompilerThreadsARB;
+	if (maxThreads)
+	{
+		// 0xFFFFFFFF leaves the number of threads to the driver
+		maxThreads(0xFFFFFFFF);
+		this->Parallel = true;
+	}
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	for (size_t i = 0; i < this->shaders.size(); i++)
+		delete this->shaders[i];
+}
+
+Shader& ShaderLibrary::Add(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines& defines, const Shader* fallback)
+{
+	Shader* shader = this->Find(vertexPath, fragmentPath, defines);
+	if (shader)
+		return *shader;
+
+	double start = glfwGetTime();
+	shader = new Shader(vertexPath, fragmentPath, defines, this->Cache, fallback);
+	shader->State = this->State;
+	this->shaders.push_back(shader);
+	if (!shader->IsReady())
+		this->pending.push_back(shader);
+	this->SubmitTime += (glfwGetTime() - start) * 1000.0;
+	return *shader;
+}
+
+Shader* ShaderLibrary::Find(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines) const
+{
+	std::string key = defines.GetKey();
+	for (size_t i = 0; i < this->shaders.size(); i++)
+	{
+		Shader* shader = this->shaders[i];
+		if (shader->VertexPath == vertexPath && shader->FragmentPath == fragmentPath && shader->Defines.GetKey() == key)
+			return shader;
+	}
+	return 0;
+}
+
+unsigned ShaderLibrary::Poll()
+{
+	if (this->pending.empty())
+		return 0;
+	double start = glfwGetTime();
+	for (size_t i = 0; i < this->pending.size();)
+	{
+		Shader* shader = this->pending[i];
+		if (!this->Parallel || shader->isComplete())
+		{
+			shader->finish(this->Cache);
+			this->pending[i] = this->pending.back();
+			this->pending.pop_back();
+		}
+		else
+			i++;
+	}
+	this->WaitTime += (glfwGetTime() - start) * 1000.0;
+	return (unsigned)this->pending.size();
+}
+
+void ShaderLibrary::Finish()
+{
+	double start = glfwGetTime();
+	for (size_t i = 0; i < this->pending.size(); i++)
+		this->pending[i]->finish(this->Cache);
+	this->pending.clear();
+	this->WaitTime += (glfwGetTime() - start) * 1000.0;
+}
+
+bool ShaderLibrary::Rebuild(Shader& shader)
+{
+	double start = glfwGetTime();
+	bool submitted = shader.reload(this->Cache);
+	if (submitted && !shader.IsReady())
+		this->pending.push_back(&shader);
+	this->SubmitTime += (glfwGetTime() - start) * 1000.0;
+	return submitted;
+}
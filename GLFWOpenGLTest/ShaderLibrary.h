@@ -0,0 +1,63 @@
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "Shader.h"
+#include "ShaderCache.h"
+
+// Builds many programs at once. Asking for a compile or link status makes the driver finish that program right
+// there, so a Shader built alone keeps the driver busy with one program at a time. The library hands every
+// compile and link to the driver first and asks for the results afterwards. With GL_KHR_parallel_shader_compile,
+// the driver compiles on its own threads and Poll only collects the programs it has finished. Until then a
+// shader draws with the fallback it was added with.
+class ShaderLibrary
+{
+public:
+	// Programs are restored from and stored to this cache if set
+	ShaderCache* Cache;
+	// Handed to every shader added, which deletes its programs through it
+	GLState* State;
+	// Whether the driver compiles in the background, otherwise Poll waits for every program
+	bool Parallel;
+	// Milliseconds spent handing programs to the driver and collecting them
+	double SubmitTime;
+	double WaitTime;
+
+	// Constructor asks the driver for as many compiler threads as it likes. Needs a current context
+	ShaderLibrary(ShaderCache* cache = 0);
+	// Destructor deletes the Shader objects, not their programs
+	~ShaderLibrary();
+
+	// Reads the sources and submits the program. The shader uses the program of fallback until it is ready,
+	// with no fallback it draws nothing until then; fallback must outlive the shader. The reference stays valid
+	// as long as the library.
+	// Variants are kept by their files and permutation key, adding one again returns the shader built before
+	Shader& Add(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines& defines = ShaderDefines(),
+		const Shader* fallback = 0);
+	// The variant added before, 0 if there is none
+	Shader* Find(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines) const;
+	// Swaps in the programs the driver has finished and returns how many are still compiling. Cheap enough for
+	// every frame; without parallel compiling it waits for all of them instead
+	unsigned Poll();
+	// Waits for every program
+	void Finish();
+	// Reads the sources of shader again and, if they changed, submits the program to be swapped in by a later
+	// Poll. Works for shaders built on their own too. Returns false if there was nothing to rebuild, or if shader
+	// is still compiling; ask again once it IsReady
+	bool Rebuild(Shader& shader);
+
+private:
+	std::vector<Shader*> shaders;
+	// Shaders still waiting on the driver
+	std::vector<Shader*> pending;
+
+	ShaderLibrary(const ShaderLibrary&);
+	ShaderLibrary& operator=(const ShaderLibrary&);
+};
+#endif
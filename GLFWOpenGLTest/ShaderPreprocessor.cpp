@@ -0,0 +1,159 @@
+#include "ShaderPreprocessor.h"
+
+// Std. Includes
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+ShaderDefines& ShaderDefines::Set(const std::string& name, const std::string& value)
+{
+	this->values[name] = value;
+	return *this;
+}
+
+ShaderDefines& ShaderDefines::Set(const std::string& name, int value)
+{
+	std::ostringstream text;
+	text << value;
+	return this->Set(name, text.str());
+}
+
+std::string ShaderDefines::GetKey() const
+{
+	std::string key;
+	for (std::map<std::string, std::string>::const_iterator i = this->values.begin(); i != this->values.end(); ++i)
+		key += (key.empty() ? "" : ";") + i->first + "=" + i->second;
+	return key;
+}
+
+std::string ShaderDefines::GetSource() const
+{
+	std::string source;
+	for (std::map<std::string, std::string>::const_iterator i = this->values.begin(); i != this->values.end(); ++i)
+		source += "#define " + i->first + " " + i->second + "\n";
+	return source;
+}
+
+// Includes deeper than this are taken for a mistake rather than followed
+static const int maxIncludeDepth = 16;
+
+// The file name of an #include "file" line, empty if the line is something else
+static std::string includedName(const std::string& line)
+{
+	size_t start = line.find_first_not_of(" \t");
+	if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+		return std::string();
+	size_t open = line.find('"', start + 8);
+	size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+	if (close == std::string::npos)
+		return std::string();
+	return line.substr(open + 1, close - open - 1);
+}
+
+static bool isVersionLine(const std::string& line)
+{
+	size_t start = line.find_first_not_of(" \t");
+	return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+}
+
+// The path with '/' separators and without "." and "dir/.." parts, so one file read through different paths is
+// still recognized as the same. Leading ".." stay, there is nothing to take them back
+static std::string normalizePath(const std::string& path)
+{
+	std::string unified = path;
+	std::replace(unified.begin(), unified.end(), '\\', '/');
+	bool absolute = !unified.empty() && unified[0] == '/';
+	std::vector<std::string> parts;
+	for (size_t start = 0; start <= unified.size();)
+	{
+		size_t end = unified.find('/', start);
+		if (end == std::string::npos)
+			end = unified.size();
+		std::string part = unified.substr(start, end - start);
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (!part.empty() && part != "." && !(part == ".." && absolute))
+			parts.push_back(part);
+		start = end + 1;
+	}
+	std::string normalized = absolute ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+		normalized += (i ? "/" : "") + parts[i];
+	return normalized;
+}
+
+// A #line directive giving the next line the number line of source string file. Since GLSL 3.30 #line works as
+// in C, earlier versions would be off by one
+static std::string lineDirective(size_t line, size_t file)
+{
+	std::ostringstream text;
+	text << "#line " << line << " " << file << "\n";
+	return text.str();
+}
+
+static bool includeFile(std::string& source, const std::string& path, std::vector<std::string>& files, int depth)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+		return false;
+	size_t index = files.size();
+	files.push_back(path);
+
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	std::string line;
+	for (size_t number = 1; std::getline(file, line); number++)
+	{
+		std::string name = includedName(line);
+		if (name.empty())
+		{
+			source += line;
+			source += '\n';
+			continue;
+		}
+		// An include read before leaves an empty line, so the lines after it keep their numbers
+		std::string included = normalizePath(directory + name);
+		if (std::find(files.begin(), files.end(), included) != files.end())
+		{
+			source += '\n';
+			continue;
+		}
+		source += lineDirective(1, files.size());
+		if (depth >= maxIncludeDepth || !includeFile(source, included, files, depth + 1))
+		{
+			std::cout << "ERROR::SHADER::INCLUDE_NOT_READ " << included << " in " << path << std::endl;
+			return false;
+		}
+		source += lineDirective(number + 1, index);
+	}
+	return true;
+}
+
+bool PreprocessShader(std::string& source, const std::string& path, const ShaderDefines& defines, std::vector<std::string>* files)
+{
+	std::vector<std::string> read;
+	std::string text;
+	bool success = includeFile(text, normalizePath(path), read, 0);
+	if (files)
+		*files = read;
+	if (!success)
+		return false;
+
+	// The defines go after #version, or first if there is none, and the line after them gets the number it has in
+	// the file. Nothing can be included before #version, so the lines up to it are those of the file
+	size_t version = 0, number = 1;
+	for (size_t line = 0; line < text.size(); line = text.find('\n', line) + 1, number++)
+	{
+		if (isVersionLine(text.substr(line, text.find('\n', line) - line)))
+		{
+			version = text.find('\n', line) + 1;
+			number++;
+			break;
+		}
+	}
+	if (version == 0)
+		number = 1;
+	source = text.substr(0, version) + defines.GetSource() + lineDirective(number, 0) + text.substr(version);
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef SHADERPREPROCESSOR_H
+#define SHADERPREPROCESSOR_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <map>
+
+// Defines put in front of a shader's source to build one variant of it. A variant is compiled with the code it
+// doesn't use left out by #if, instead of branching on uniforms at runtime.
+class ShaderDefines
+{
+public:
+	// Adds a define, or replaces the value of one set before
+	ShaderDefines& Set(const std::string& name, const std::string& value = "1");
+	ShaderDefines& Set(const std::string& name, int value);
+
+	// The permutation key, every define as NAME=value sorted by name and separated by ';'. Two sets of defines
+	// with the same key build the same variant
+	std::string GetKey() const;
+	// The #define lines
+	std::string GetSource() const;
+
+private:
+	std::map<std::string, std::string> values;
+};
+
+// Reads the shader at path into source. #include "file" lines are replaced by the file, found next to the file
+// that includes it, and every file is included only once so includes can include each other freely. defines go
+// right after the #version line, which GLSL wants first. #line directives around every included file and after
+// the defines keep the line numbers of compile errors those of the files; the source string number of an error
+// is the index of its file in files. files receives the normalized path of every file read, path first.
+// Returns false if a file can't be read.
+bool PreprocessShader(std::string& source, const std::string& path, const ShaderDefines& defines,
+	std::vector<std::string>* files = 0);
+#endif
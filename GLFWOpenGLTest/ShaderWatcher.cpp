@@ -0,0 +1,231 @@
+#include "ShaderWatcher.h"
+
+// Std. Includes
+#include <iostream>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// The directory of a path, "." for a bare file name
+static std::string directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+// The path as the watcher reports it, the directory as watched and the bare name
+static std::string watchedName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return directoryOf(path) + "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+}
+
+ShaderWatcher::ShaderWatcher(ShaderLibrary& library) : library(library), failed(false), changed(false)
+{
+#ifdef _WIN32
+	this->stopEvent = 0;
+#else
+	this->stopPipe[0] = this->stopPipe[1] = -1;
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	this->stop();
+}
+
+void ShaderWatcher::Watch(Shader& shader)
+{
+	this->shaders.push_back(&shader);
+	for (size_t i = 0; i < shader.Files.size(); i++)
+	{
+		std::string directory = directoryOf(shader.Files[i]);
+		if (std::find(this->directories.begin(), this->directories.end(), directory) == this->directories.end())
+		{
+			// The thread watches the directories it started with, the next Update starts it again with the new one
+			this->stop();
+			this->directories.push_back(directory);
+		}
+	}
+}
+
+unsigned ShaderWatcher::Update()
+{
+	if (!this->thread.joinable() && !this->failed)
+		this->start();
+	std::vector<std::string> files;
+	if (this->changed.load(std::memory_order_acquire))
+	{
+		this->changed.store(false, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(this->mutex);
+		files.swap(this->changedFiles);
+	}
+	else if (this->waiting.empty())
+		return 0;
+
+	unsigned rebuilds = 0;
+	for (size_t i = 0; i < this->shaders.size(); i++)
+	{
+		Shader& shader = *this->shaders[i];
+		std::vector<Shader*>::iterator waits = std::find(this->waiting.begin(), this->waiting.end(), &shader);
+		bool touched = waits != this->waiting.end();
+		for (size_t j = 0; j < shader.Files.size() && !touched; j++)
+		{
+			touched = std::find(files.begin(), files.end(), watchedName(shader.Files[j])) != files.end()
+				|| std::find(files.begin(), files.end(), directoryOf(shader.Files[j]) + "/*") != files.end();
+		}
+		if (!touched)
+			continue;
+		// A shader still compiling can't take another program yet, it keeps its change until the library swaps
+		// the current one in
+		if (!shader.IsReady())
+		{
+			if (waits == this->waiting.end())
+				this->waiting.push_back(&shader);
+			continue;
+		}
+		if (waits != this->waiting.end())
+			this->waiting.erase(waits);
+		if (this->library.Rebuild(shader))
+		{
+			std::cout << "Rebuilding " << shader.VertexPath << " " << shader.FragmentPath << std::endl;
+			rebuilds++;
+		}
+	}
+	return rebuilds;
+}
+
+void ShaderWatcher::notify(const std::string& directory, const std::string& name)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::string file = directory + "/" + name;
+		if (std::find(this->changedFiles.begin(), this->changedFiles.end(), file) == this->changedFiles.end())
+			this->changedFiles.push_back(file);
+	}
+	this->changed.store(true, std::memory_order_release);
+}
+
+void ShaderWatcher::start()
+{
+#ifdef _WIN32
+	this->stopEvent = CreateEventA(0, TRUE, FALSE, 0);
+	this->failed = !this->stopEvent;
+#else
+	this->failed = pipe(this->stopPipe) != 0;
+	if (this->failed)
+		this->stopPipe[0] = this->stopPipe[1] = -1;
+#endif
+	if (this->failed)
+	{
+		std::cout << "ERROR::SHADERWATCHER::THREAD_NOT_STARTED" << std::endl;
+		return;
+	}
+	this->thread = std::thread(&ShaderWatcher::run, this);
+}
+
+void ShaderWatcher::stop()
+{
+	if (!this->thread.joinable())
+		return;
+#ifdef _WIN32
+	SetEvent(this->stopEvent);
+	this->thread.join();
+	CloseHandle(this->stopEvent);
+	this->stopEvent = 0;
+#else
+	char wake = 0;
+	if (write(this->stopPipe[1], &wake, 1) != 1)
+		std::cout << "ERROR::SHADERWATCHER::THREAD_NOT_STOPPED" << std::endl;
+	this->thread.join();
+	close(this->stopPipe[0]);
+	close(this->stopPipe[1]);
+	this->stopPipe[0] = this->stopPipe[1] = -1;
+#endif
+}
+
+#ifdef _WIN32
+void ShaderWatcher::run()
+{
+	// A change handle only says something in its directory was written, Update then looks at every shader of it
+	// and the rebuild skips the ones whose sources are the same
+	std::vector<HANDLE> handles(1, (HANDLE)this->stopEvent);
+	std::vector<std::string> watched;
+	for (size_t i = 0; i < this->directories.size() && handles.size() < MAXIMUM_WAIT_OBJECTS; i++)
+	{
+		HANDLE handle = FindFirstChangeNotificationA(this->directories[i].c_str(), FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			std::cout << "ERROR::SHADERWATCHER::DIRECTORY_NOT_WATCHED " << this->directories[i] << std::endl;
+			continue;
+		}
+		handles.push_back(handle);
+		watched.push_back(this->directories[i]);
+	}
+
+	for (;;)
+	{
+		DWORD signaled = WaitForMultipleObjects((DWORD)handles.size(), &handles[0], FALSE, INFINITE);
+		if (signaled <= WAIT_OBJECT_0 || signaled >= WAIT_OBJECT_0 + handles.size())
+			break;
+		size_t index = signaled - WAIT_OBJECT_0;
+		this->notify(watched[index - 1], "*");
+		FindNextChangeNotification(handles[index]);
+	}
+
+	for (size_t i = 1; i < handles.size(); i++)
+		FindCloseChangeNotification(handles[i]);
+}
+#else
+void ShaderWatcher::run()
+{
+	int inotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (inotify < 0)
+	{
+		std::cout << "ERROR::SHADERWATCHER::INOTIFY_NOT_STARTED" << std::endl;
+		return;
+	}
+	// Whole directories are watched rather than the files, editors that save by renaming a new file over the old
+	// one would otherwise end the watch with the first save
+	std::vector<int> watches(this->directories.size());
+	for (size_t i = 0; i < this->directories.size(); i++)
+	{
+		watches[i] = inotify_add_watch(inotify, this->directories[i].c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watches[i] < 0)
+			std::cout << "ERROR::SHADERWATCHER::DIRECTORY_NOT_WATCHED " << this->directories[i] << std::endl;
+	}
+
+	// Large enough for a burst of events, aligned for the inotify_event records
+	alignas(inotify_event) char buffer[4096];
+	pollfd waits[2] = { { inotify, POLLIN, 0 }, { this->stopPipe[0], POLLIN, 0 } };
+	for (;;)
+	{
+		if (poll(waits, 2, -1) < 0)
+			continue;
+		if (waits[1].revents)
+			break;
+		ssize_t size;
+		while ((size = read(inotify, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* event = buffer; event < buffer + size;)
+			{
+				const inotify_event* record = (const inotify_event*)event;
+				std::vector<int>::iterator watch = std::find(watches.begin(), watches.end(), record->wd);
+				if (record->len > 0 && watch != watches.end())
+					this->notify(this->directories[watch - watches.begin()], record->name);
+				event += sizeof(inotify_event) + record->len;
+			}
+		}
+	}
+	close(inotify);
+}
+#endif
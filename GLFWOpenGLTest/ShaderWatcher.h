@@ -0,0 +1,64 @@
+#ifndef SHADERWATCHER_H
+#define SHADERWATCHER_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// Project includes
+#include "Shader.h"
+#include "ShaderLibrary.h"
+
+// Rebuilds shaders when their source files are saved, so shaders can be edited while the program runs.
+// A thread sleeps on the file system's change notifications, inotify on Linux and change notification handles
+// on Windows, and only raises a flag; a frame without changes costs Update one atomic load. Rebuilds go through
+// the library, which swaps the new program in at a frame boundary and keeps the old one if the edit doesn't build.
+class ShaderWatcher
+{
+public:
+	ShaderWatcher(ShaderLibrary& library);
+	// Destructor stops the watching thread
+	~ShaderWatcher();
+
+	// Rebuilds shader whenever one of its files changes, includes too. shader must outlive the watcher
+	void Watch(Shader& shader);
+	// Call once per frame before drawing: submits the rebuilds of shaders whose files changed since the last call,
+	// the library's Poll swaps them in. A shader still compiling is rebuilt by the first Update after it's swapped
+	// in. Returns the number of rebuilds submitted
+	unsigned Update();
+
+private:
+	ShaderLibrary& library;
+	std::vector<Shader*> shaders;
+	// Shaders whose files changed while their last rebuild was still compiling, rebuilt once it is swapped in
+	std::vector<Shader*> waiting;
+	// Directories watched, those of every file the shaders read
+	std::vector<std::string> directories;
+
+	std::thread thread;
+	// The thread couldn't be started, shaders aren't watched and Update doesn't try every frame again
+	bool failed;
+	// Set by the thread when a file changed, cleared by Update
+	std::atomic<bool> changed;
+	std::mutex mutex;
+	// Files that changed, "<directory>/*" for a change somewhere in a directory when the system doesn't say where
+	std::vector<std::string> changedFiles;
+#ifdef _WIN32
+	void* stopEvent;
+#else
+	int stopPipe[2];
+#endif
+
+	void start();
+	void stop();
+	void run();
+	// Records the change of the file named name in directory
+	void notify(const std::string& directory, const std::string& name);
+
+	ShaderWatcher(const ShaderWatcher&);
+	ShaderWatcher& operator=(const ShaderWatcher&);
+};
+#endif
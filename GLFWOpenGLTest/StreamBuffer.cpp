@@ -0,0 +1,134 @@
+#include "StreamBuffer.h"
+
+// Std. Includes
+#include <iostream>
+
+// GL Includes
+#include <GLFW\glfw3.h>
+
+// Nanoseconds a BeginFrame waits for a fence before checking again, a stall prints nothing while it lasts
+static const GLuint64 fenceTimeout = 1000000000;
+
+StreamBuffer::StreamBuffer(GLState& state, GLsizeiptr frameSize, unsigned frames)
+	: Persistent(GLEW_ARB_buffer_storage != GL_FALSE), Stalls(0), StallTime(0.0), state(state), buffer(0), frameSize(frameSize),
+	frames(frames), fences(frames, (GLsync)0), region(0), head(0), mapped(0), mapStart(0), uniformAlignment(256), storageAlignment(256)
+{
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->uniformAlignment);
+	if (GLEW_ARB_shader_storage_buffer_object)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &this->storageAlignment);
+
+	// The copy target is bound to nothing else, so making and mapping the buffer disturbs no other binding
+	glGenBuffers(1, &this->buffer);
+	this->state.BindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+	GLsizeiptr size = frameSize * frames;
+	if (this->Persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, 0, flags);
+		this->mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		if (!this->mapped)
+		{
+			// Then regions are mapped one by one as without buffer storage
+			std::cout << "ERROR::STREAMBUFFER::NOT_MAPPED" << std::endl;
+			this->Persistent = false;
+		}
+	}
+	else
+		glBufferData(GL_COPY_WRITE_BUFFER, size, 0, GL_STREAM_DRAW);
+	// The first BeginFrame moves on to region 0
+	this->region = frames - 1;
+	this->head = this->region * frameSize;
+}
+
+void StreamBuffer::Release()
+{
+	for (unsigned i = 0; i < this->frames; i++)
+	{
+		if (this->fences[i])
+			glDeleteSync(this->fences[i]);
+		this->fences[i] = 0;
+	}
+	if (!this->buffer)
+		return;
+	// Deleting a buffer unmaps it
+	this->state.DeleteBuffer(this->buffer);
+	this->buffer = 0;
+	this->mapped = 0;
+}
+
+GLsizeiptr StreamBuffer::GetAlignment(GLenum target) const
+{
+	if (target == GL_UNIFORM_BUFFER)
+		return this->uniformAlignment;
+	if (target == GL_SHADER_STORAGE_BUFFER)
+		return this->storageAlignment;
+	return 16;
+}
+
+void StreamBuffer::wait(unsigned region)
+{
+	GLsync fence = this->fences[region];
+	if (!fence)
+		return;
+	// Normally the fence was passed frames ago and this returns at once
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		double start = glfwGetTime();
+		this->Stalls++;
+		do
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+		while (status == GL_TIMEOUT_EXPIRED);
+		this->StallTime += (glfwGetTime() - start) * 1000.0;
+	}
+	glDeleteSync(fence);
+	this->fences[region] = 0;
+}
+
+void StreamBuffer::BeginFrame()
+{
+	this->Commit();
+	this->region = (this->region + 1) % this->frames;
+	this->head = this->region * this->frameSize;
+	this->wait(this->region);
+}
+
+void* StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+	GLintptr start = (this->head + alignment - 1) / alignment * alignment;
+	GLintptr end = (this->region + 1) * this->frameSize;
+	if (start + size > end)
+		return 0;
+	if (!this->mapped)
+	{
+		// The fence said the GPU is done with the region, so there is nothing to synchronize the map with
+		this->state.BindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+		this->mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, start, end - start, flags);
+		if (!this->mapped)
+			return 0;
+		this->mapStart = start;
+	}
+	offset = start;
+	this->head = start + size;
+	return this->mapped + (start - this->mapStart);
+}
+
+void StreamBuffer::Commit()
+{
+	// Persistent memory is coherent, the GPU sees the writes without being told
+	if (this->Persistent || !this->mapped)
+		return;
+	this->state.BindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+	glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, this->head - this->mapStart);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	this->mapped = 0;
+}
+
+void StreamBuffer::EndFrame()
+{
+	this->Commit();
+	if (this->fences[this->region])
+		glDeleteSync(this->fences[this->region]);
+	this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
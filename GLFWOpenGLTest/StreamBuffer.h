@@ -0,0 +1,73 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "GLState.h"
+
+// A ring of frame regions in one buffer for the data a frame writes and the GPU reads once: uniform blocks,
+// storage blocks, vertices. Each frame allocates from its own region like a stack and writes straight into the
+// mapped buffer, then a fence marks the region as in use until the GPU has passed the frame's draws. The region
+// is only written again frames later, after the fence, so the CPU never waits for the GPU and never writes what
+// the GPU is still reading.
+// With GL_ARB_buffer_storage the whole buffer is mapped once, persistent and coherent. Without it, on a plain
+// 3.3 context, the part of the region being written is mapped unsynchronized and unmapped again by Commit
+class StreamBuffer
+{
+public:
+	// Whether the buffer stays mapped
+	bool Persistent;
+	// BeginFrames that had to wait for the GPU to finish with the region, and the milliseconds they waited.
+	// Anything but 0 means the frames in flight are too few or the GPU lags behind
+	unsigned Stalls;
+	double StallTime;
+
+	// Constructor creates a buffer of frames regions of frameSize bytes each. Needs a current context
+	StreamBuffer(GLState& state, GLsizeiptr frameSize, unsigned frames = 3);
+
+	// Moves on to the next region, waiting for the GPU if it still reads it
+	void BeginFrame();
+	// Reserves size bytes aligned to alignment in the region of the frame and returns where to write them.
+	// offset is their place in the buffer, for glBindBufferRange or attribute pointers. 0 if the region is full
+	void* Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+	// Makes what was written visible to GL. Call before the draws that read it; Allocate can go on afterwards
+	void Commit();
+	// Fences the region after the last draw that reads the frame's data
+	void EndFrame();
+	// Deletes the buffer and the fences. Call while the GL context is still current, before glfwTerminate
+	void Release();
+
+	GLuint GetBuffer() const { return this->buffer; }
+	// The offset alignment GL wants for binding ranges of target, 16 for anything else, e.g. vertices
+	GLsizeiptr GetAlignment(GLenum target) const;
+	// Bytes allocated in the region of the frame
+	GLsizeiptr GetUsed() const { return this->head - this->region * this->frameSize; }
+
+private:
+	GLState& state;
+	GLuint buffer;
+	GLsizeiptr frameSize;
+	unsigned frames;
+	// Fence of every region, 0 once passed
+	std::vector<GLsync> fences;
+	unsigned region;
+	// Next free byte of the buffer, in the frame's region
+	GLintptr head;
+	// The mapped memory and the buffer offset it starts at. Always mapped when Persistent
+	char* mapped;
+	GLintptr mapStart;
+	GLint uniformAlignment;
+	GLint storageAlignment;
+
+	// Waits for the fence of region, counting a stall if it wasn't passed yet
+	void wait(unsigned region);
+
+	StreamBuffer(const StreamBuffer&);
+	StreamBuffer& operator=(const StreamBuffer&);
+};
+#endif
@@ -0,0 +1,250 @@
+#include "TextureAtlas.h"
+
+// Std. Includes
+#include <algorithm>
+#include <cstring>
+
+SkylinePacker::SkylinePacker(unsigned width, unsigned height)
+{
+	this->Reset(width, height);
+}
+
+void SkylinePacker::Reset(unsigned width, unsigned height)
+{
+	this->width = width;
+	this->height = height;
+	this->skyline.clear();
+	Segment floor = { 0, 0, width };
+	this->skyline.push_back(floor);
+}
+
+bool SkylinePacker::fit(size_t segment, unsigned width, unsigned height, unsigned& y) const
+{
+	if (this->skyline[segment].X + width > this->width)
+		return false;
+	// The rectangle rests on the highest segment below it
+	y = 0;
+	unsigned widthLeft = width;
+	for (size_t i = segment; widthLeft > 0 && i < this->skyline.size(); i++)
+	{
+		y = std::max(y, this->skyline[i].Y);
+		if (y + height > this->height)
+			return false;
+		widthLeft -= std::min(widthLeft, this->skyline[i].Width);
+	}
+	return true;
+}
+
+bool SkylinePacker::Insert(unsigned width, unsigned height, unsigned& x, unsigned& y)
+{
+	size_t best = this->skyline.size();
+	unsigned bestTop = 0;
+	for (size_t i = 0; i < this->skyline.size(); i++)
+	{
+		unsigned fitY;
+		if (this->fit(i, width, height, fitY) && (best == this->skyline.size() || fitY + height < bestTop))
+		{
+			best = i;
+			bestTop = fitY + height;
+		}
+	}
+	if (best == this->skyline.size())
+		return false;
+
+	x = this->skyline[best].X;
+	y = bestTop - height;
+	Segment top = { x, bestTop, width };
+	this->skyline.insert(this->skyline.begin() + best, top);
+
+	// Cut away the segments the new one now covers
+	for (size_t i = best + 1; i < this->skyline.size();)
+	{
+		Segment& segment = this->skyline[i];
+		if (segment.X >= x + width)
+			break;
+		unsigned overlap = x + width - segment.X;
+		if (overlap < segment.Width)
+		{
+			segment.X += overlap;
+			segment.Width -= overlap;
+			break;
+		}
+		this->skyline.erase(this->skyline.begin() + i);
+	}
+	// And merge neighbors of the same height, the fewer segments the faster the next fit
+	for (size_t i = 0; i + 1 < this->skyline.size();)
+	{
+		if (this->skyline[i].Y == this->skyline[i + 1].Y)
+		{
+			this->skyline[i].Width += this->skyline[i + 1].Width;
+			this->skyline.erase(this->skyline.begin() + i + 1);
+		}
+		else
+			i++;
+	}
+	return true;
+}
+
+TextureAtlas::TextureAtlas(unsigned maxPageSize, unsigned padding) : MaxPageSize(maxPageSize), Padding(padding), PageWidth(0), PageHeight(0)
+{
+}
+
+unsigned TextureAtlas::Add(const std::string& name, const unsigned char* pixels, unsigned width, unsigned height)
+{
+	AtlasEntry entry = AtlasEntry();
+	entry.Name = name;
+	entry.Width = width;
+	entry.Height = height;
+	this->Entries.push_back(entry);
+	this->images.push_back(std::vector<unsigned char>(pixels, pixels + (size_t)width * height * 4));
+	return (unsigned)this->Entries.size() - 1;
+}
+
+unsigned TextureAtlas::paddedSize(unsigned size) const
+{
+	return (size + 2 * this->Padding + this->Padding - 1) / this->Padding * this->Padding;
+}
+
+// Orders the images tallest first, skyline packing wastes the least space that way
+struct TallerFirst
+{
+	const std::vector<AtlasEntry>* Entries;
+
+	bool operator()(size_t a, size_t b) const
+	{
+		const AtlasEntry& left = (*this->Entries)[a];
+		const AtlasEntry& right = (*this->Entries)[b];
+		return left.Height != right.Height ? left.Height > right.Height : left.Width > right.Width;
+	}
+};
+
+bool TextureAtlas::Pack()
+{
+	this->Pages.clear();
+	this->PageWidth = this->PageHeight = 0;
+	if (this->Entries.empty())
+		return true;
+
+	std::vector<size_t> order(this->Entries.size());
+	unsigned largest = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+		largest = std::max(largest, std::max(this->paddedSize(this->Entries[i].Width), this->paddedSize(this->Entries[i].Height)));
+	}
+	if (largest > this->MaxPageSize)
+		return false;
+	TallerFirst tallerFirst = { &this->Entries };
+	std::stable_sort(order.begin(), order.end(), tallerFirst);
+
+	// The smallest single page everything fits on. Widths are tried in powers of two, the height is cut down to
+	// what the images use, GL 3.3 takes any size.
+	unsigned bestWidth = 0, bestHeight = 0, pageCount, height;
+	for (unsigned width = this->Padding; width <= this->MaxPageSize; width *= 2)
+	{
+		if (this->layout(width, this->MaxPageSize, 1, order, pageCount, height)
+			&& (bestWidth == 0 || (size_t)width * height < (size_t)bestWidth * bestHeight))
+		{
+			bestWidth = width;
+			bestHeight = height;
+		}
+	}
+	// Otherwise as many pages of the largest size as it takes
+	if (bestWidth == 0)
+	{
+		bestWidth = this->MaxPageSize;
+		bestHeight = this->MaxPageSize;
+	}
+	if (!this->layout(bestWidth, bestHeight, (unsigned)this->Entries.size(), order, pageCount, height))
+		return false;
+
+	this->PageWidth = bestWidth;
+	this->PageHeight = height;
+	this->Pages.assign(pageCount, std::vector<unsigned char>((size_t)this->PageWidth * this->PageHeight * 4, 0));
+	for (size_t i = 0; i < this->Entries.size(); i++)
+	{
+		AtlasEntry& entry = this->Entries[i];
+		entry.UvRect = glm::vec4((float)entry.Width / this->PageWidth, (float)entry.Height / this->PageHeight,
+			(float)entry.X / this->PageWidth, (float)entry.Y / this->PageHeight);
+		this->draw(entry, this->images[i]);
+	}
+	return true;
+}
+
+bool TextureAtlas::layout(unsigned pageWidth, unsigned pageHeight, unsigned maxPages, const std::vector<size_t>& order,
+	unsigned& pageCount, unsigned& usedHeight)
+{
+	std::vector<SkylinePacker> packers;
+	packers.reserve(maxPages);
+	usedHeight = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		AtlasEntry& entry = this->Entries[order[i]];
+		unsigned w = this->paddedSize(entry.Width), h = this->paddedSize(entry.Height), x = 0, y = 0;
+		size_t page = 0;
+		while (page < packers.size() && !packers[page].Insert(w, h, x, y))
+			page++;
+		if (page == packers.size())
+		{
+			if (packers.size() == maxPages)
+				return false;
+			packers.push_back(SkylinePacker(pageWidth, pageHeight));
+			if (!packers.back().Insert(w, h, x, y))
+				return false;
+		}
+		entry.Page = (unsigned)page;
+		entry.X = x + this->Padding;
+		entry.Y = y + this->Padding;
+		usedHeight = std::max(usedHeight, y + h);
+	}
+	pageCount = (unsigned)packers.size();
+	return true;
+}
+
+void TextureAtlas::draw(const AtlasEntry& entry, const std::vector<unsigned char>& image)
+{
+	// The whole cell gets the image with its edge texels repeated outwards, the rounding to Padding included,
+	// so the mips of the cell's edge average the image's edge with itself
+	std::vector<unsigned char>& page = this->Pages[entry.Page];
+	unsigned cellX = entry.X - this->Padding, cellY = entry.Y - this->Padding;
+	unsigned cellWidth = this->paddedSize(entry.Width), cellHeight = this->paddedSize(entry.Height);
+	for (unsigned y = 0; y < cellHeight; y++)
+	{
+		int imageY = std::min(std::max((int)y - (int)this->Padding, 0), (int)entry.Height - 1);
+		unsigned char* row = &page[((size_t)(cellY + y) * this->PageWidth + cellX) * 4];
+		const unsigned char* imageRow = &image[(size_t)imageY * entry.Width * 4];
+		for (unsigned x = 0; x < cellWidth; x++)
+		{
+			int imageX = std::min(std::max((int)x - (int)this->Padding, 0), (int)entry.Width - 1);
+			memcpy(&row[x * 4], &imageRow[imageX * 4], 4);
+		}
+	}
+}
+
+const AtlasEntry* TextureAtlas::Find(const std::string& name) const
+{
+	for (size_t i = 0; i < this->Entries.size(); i++)
+	{
+		if (this->Entries[i].Name == name)
+			return &this->Entries[i];
+	}
+	return 0;
+}
+
+double TextureAtlas::GetEfficiency() const
+{
+	if (this->Pages.empty())
+		return 0.0;
+	double used = 0.0;
+	for (size_t i = 0; i < this->Entries.size(); i++)
+		used += (double)this->Entries[i].Width * this->Entries[i].Height;
+	return used / ((double)this->Pages.size() * this->PageWidth * this->PageHeight);
+}
+
+unsigned TextureAtlas::GetMipLevelCount() const
+{
+	unsigned levels = 1;
+	for (unsigned padding = this->Padding; padding > 1; padding /= 2)
+		levels++;
+	return levels;
+}
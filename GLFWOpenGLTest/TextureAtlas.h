@@ -0,0 +1,94 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+
+// GL Includes
+#include <glm/glm.hpp>
+
+// Where an image of the atlas ended up
+struct AtlasEntry
+{
+	std::string Name;
+	unsigned Width;
+	unsigned Height;
+	// Page the image is on, the layer of the GL_TEXTURE_2D_ARRAY the pages are uploaded to
+	unsigned Page;
+	// Top left texel of the image on its page, the padding around it not included
+	unsigned X;
+	unsigned Y;
+	// Texture coordinates in 0..1 of the image map to uv * UvRect.xy + UvRect.zw on the page
+	glm::vec4 UvRect;
+};
+
+// Bottom left skyline packing: the top edge of everything placed so far is kept as a list of horizontal segments,
+// and every rectangle goes where it ends up lowest. Fast and close to maxrects for textures, which are mostly
+// similar in size.
+class SkylinePacker
+{
+public:
+	SkylinePacker(unsigned width = 0, unsigned height = 0);
+
+	// Empties the packer for an area of width x height
+	void Reset(unsigned width, unsigned height);
+	// Places a rectangle, returns false if it doesn't fit anywhere anymore
+	bool Insert(unsigned width, unsigned height, unsigned& x, unsigned& y);
+
+private:
+	struct Segment
+	{
+		unsigned X;
+		unsigned Y;
+		unsigned Width;
+	};
+
+	unsigned width;
+	unsigned height;
+	std::vector<Segment> skyline;
+
+	// Lowest y a rectangle of width can be placed at starting on the segment, false if it runs off the area
+	bool fit(size_t segment, unsigned width, unsigned height, unsigned& y) const;
+};
+
+// Packs RGBA8 images into as few and as small pages as it can, so everything drawn with them shares one texture bind.
+// Each image gets Padding texels of its edge repeated around it, and starts on a multiple of Padding, so the first
+// GetMipLevelCount() mip levels of a page filter without bleeding images into each other.
+class TextureAtlas
+{
+public:
+	// Largest page to use, several pages of this size are made if the images don't fit in one
+	unsigned MaxPageSize;
+	// Power of two, at least 4 so the images also start on whole blocks for block compression
+	unsigned Padding;
+
+	// Filled in by Pack, all pages have the same size. The height is only as large as the images need
+	unsigned PageWidth;
+	unsigned PageHeight;
+	std::vector<AtlasEntry> Entries;
+	std::vector<std::vector<unsigned char> > Pages;
+
+	TextureAtlas(unsigned maxPageSize = 2048, unsigned padding = 8);
+
+	// Queues a copy of an image for packing, returns the index its entry will have
+	unsigned Add(const std::string& name, const unsigned char* pixels, unsigned width, unsigned height);
+	// Packs every image queued so far and draws the pages. Returns false if an image is larger than MaxPageSize.
+	bool Pack();
+
+	const AtlasEntry* Find(const std::string& name) const;
+	// Share of the page area covered by images, padding and empty space being the rest
+	double GetEfficiency() const;
+	// Mip levels, level 0 included, that stay free of bleeding between images
+	unsigned GetMipLevelCount() const;
+
+private:
+	std::vector<std::vector<unsigned char> > images;
+
+	unsigned paddedSize(unsigned size) const;
+	// Positions the entries on up to maxPages pages, returns false if they don't fit
+	bool layout(unsigned pageWidth, unsigned pageHeight, unsigned maxPages, const std::vector<size_t>& order,
+		unsigned& pageCount, unsigned& usedHeight);
+	void draw(const AtlasEntry& entry, const std::vector<unsigned char>& image);
+};
+#endif
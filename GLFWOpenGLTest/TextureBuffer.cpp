@@ -0,0 +1,42 @@
+#include "TextureBuffer.h"
+
+// Bytes the storage starts with, room for a few texels of any format
+static const GLsizeiptr initialCapacity = 256;
+
+TextureBuffer::TextureBuffer(GLState& state, GLenum format)
+	: state(state), buffer(0), texture(0), capacity(initialCapacity)
+{
+	glGenBuffers(1, &this->buffer);
+	this->state.BindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+	glBufferData(GL_TEXTURE_BUFFER, this->capacity, 0, GL_STREAM_DRAW);
+	// The texture stays attached to the buffer object whatever storage it gets later
+	glGenTextures(1, &this->texture);
+	this->state.BindTexture(GL_TEXTURE_BUFFER, this->texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, this->buffer);
+}
+
+void TextureBuffer::Upload(const void* data, GLsizeiptr size)
+{
+	this->state.BindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+	// Growing by half again keeps a slowly growing array from reallocating every frame
+	if (size > this->capacity)
+		this->capacity = size + size / 2;
+	glBufferData(GL_TEXTURE_BUFFER, this->capacity, 0, GL_STREAM_DRAW);
+	if (size)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+void TextureBuffer::Bind(GLuint unit)
+{
+	this->state.BindTexture(unit, GL_TEXTURE_BUFFER, this->texture);
+}
+
+void TextureBuffer::Release()
+{
+	if (this->texture)
+		this->state.DeleteTexture(this->texture);
+	if (this->buffer)
+		this->state.DeleteBuffer(this->buffer);
+	this->texture = 0;
+	this->buffer = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef TEXTUREBUFFER_H
+#define TEXTUREBUFFER_H
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "GLState.h"
+
+// A buffer texture the CPU fills again every frame, for arrays a shader reads with texelFetch that are too big
+// for a uniform block, on a 3.3 context without storage blocks. Upload orphans the storage the GPU may still be
+// reading and writes into a fresh one, so it never waits for the draws of the frames before
+class TextureBuffer
+{
+public:
+	// Constructor makes an empty buffer of texels of format, e.g. GL_RGBA32F. Needs a current context
+	TextureBuffer(GLState& state, GLenum format);
+
+	// Replaces the contents with size bytes of data. The storage only grows
+	void Upload(const void* data, GLsizeiptr size);
+	void Bind(GLuint unit);
+	// Deletes the texture and the buffer. Call while the GL context is still current, before glfwTerminate
+	void Release();
+
+	GLuint GetTexture() const { return this->texture; }
+	GLsizeiptr GetCapacity() const { return this->capacity; }
+
+private:
+	GLState& state;
+	GLuint buffer;
+	GLuint texture;
+	GLsizeiptr capacity;
+
+	TextureBuffer(const TextureBuffer&);
+	TextureBuffer& operator=(const TextureBuffer&);
+};
+#endif
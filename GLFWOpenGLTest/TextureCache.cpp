@@ -0,0 +1,320 @@
+#include "TextureCache.h"
+
+// Std. Includes
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 3rdparty
+#include "lodepng.h"
+
+// Project includes
+#include "FileCache.h"
+
+// Layout of a cache file: the header, LevelCount level records, then the pixels of every level, each starting
+// at a multiple of dataAlignment. Bump cacheVersion whenever the layout or the baking changes, old files then
+// count as misses and are baked again.
+static const char cacheMagic[4] = { 'T', 'E', 'X', 'C' };
+static const unsigned cacheVersion = 2;
+static const size_t dataAlignment = 16;
+
+struct CacheHeader
+{
+	char Magic[4];
+	unsigned Version;
+	unsigned long long SourceHash;
+	// Bytes of the PNG or the pixels, a source of another size can't be the same even if the hashes were
+	unsigned long long SourceSize;
+	unsigned Key;
+	unsigned Format;
+	unsigned LevelCount;
+	unsigned Reserved;
+};
+
+struct CacheLevel
+{
+	unsigned Width;
+	unsigned Height;
+	unsigned long long Offset;
+	unsigned long long Size;
+};
+
+static unsigned settingsKey(const TextureSettings& settings)
+{
+	return (settings.Mips ? 1u : 0u) | ((unsigned)settings.Filter << 1) | (settings.Srgb ? 8u : 0u) | (settings.Wrap ? 16u : 0u)
+		| ((unsigned)settings.Format << 8) | (settings.MaxLevels << 16);
+}
+
+static size_t alignUp(size_t offset)
+{
+	return (offset + dataAlignment - 1) / dataAlignment * dataAlignment;
+}
+
+// Points the levels of texture into a cache file in memory, after checking it belongs to this source and settings
+// and that every level lies inside the file
+static bool parseCacheFile(BakedTexture& texture, const unsigned char* data, size_t size, unsigned long long sourceHash, unsigned long long sourceSize,
+	const TextureSettings& settings)
+{
+	if (size < sizeof(CacheHeader))
+		return false;
+	CacheHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.Magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.Version != cacheVersion
+		|| header.SourceHash != sourceHash || header.SourceSize != sourceSize || header.Key != settingsKey(settings) || header.Format != (unsigned)settings.Format
+		|| header.LevelCount == 0 || header.LevelCount > 32 || size < sizeof(CacheHeader) + header.LevelCount * sizeof(CacheLevel))
+		return false;
+
+	std::vector<BakedLevel> levels(header.LevelCount);
+	for (unsigned i = 0; i < header.LevelCount; i++)
+	{
+		CacheLevel level;
+		memcpy(&level, data + sizeof(CacheHeader) + i * sizeof(CacheLevel), sizeof(level));
+		if (level.Offset > size || level.Size > size - level.Offset || level.Size != GetTextureLevelSize(settings.Format, level.Width, level.Height))
+			return false;
+		levels[i].Width = level.Width;
+		levels[i].Height = level.Height;
+		levels[i].Data = data + level.Offset;
+		levels[i].Size = (size_t)level.Size;
+	}
+	texture.Format = settings.Format;
+	texture.Levels.swap(levels);
+	return true;
+}
+
+// Lays out a cache file for the chain in memory, its levels already in the format of the settings
+static void bakeCacheFile(std::vector<unsigned char>& blob, const MipChain& chain, unsigned long long sourceHash, unsigned long long sourceSize, const TextureSettings& settings)
+{
+	CacheHeader header;
+	memcpy(header.Magic, cacheMagic, sizeof(cacheMagic));
+	header.Version = cacheVersion;
+	header.SourceHash = sourceHash;
+	header.SourceSize = sourceSize;
+	header.Key = settingsKey(settings);
+	header.Format = settings.Format;
+	header.LevelCount = (unsigned)chain.Levels.size();
+	header.Reserved = 0;
+
+	std::vector<CacheLevel> levels(chain.Levels.size());
+	size_t offset = alignUp(sizeof(CacheHeader) + levels.size() * sizeof(CacheLevel));
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		levels[i].Width = chain.Levels[i].Width;
+		levels[i].Height = chain.Levels[i].Height;
+		levels[i].Offset = offset;
+		levels[i].Size = chain.Levels[i].Pixels.size();
+		offset = alignUp(offset + chain.Levels[i].Pixels.size());
+	}
+
+	blob.assign(offset, 0);
+	memcpy(&blob[0], &header, sizeof(header));
+	memcpy(&blob[sizeof(header)], &levels[0], levels.size() * sizeof(CacheLevel));
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		if (!chain.Levels[i].Pixels.empty())
+			memcpy(&blob[(size_t)levels[i].Offset], &chain.Levels[i].Pixels[0], chain.Levels[i].Pixels.size());
+	}
+}
+
+BakedTexture::BakedTexture() : Format(TEXTURE_RGBA8), view(0), viewSize(0),
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE), mapping(0)
+#else
+	file(-1)
+#endif
+{
+}
+
+BakedTexture::~BakedTexture()
+{
+	this->Release();
+}
+
+size_t BakedTexture::GetByteSize() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < this->Levels.size(); i++)
+		bytes += this->Levels[i].Size;
+	return bytes;
+}
+
+void BakedTexture::Release()
+{
+	this->Levels.clear();
+	std::vector<unsigned char>().swap(this->owned);
+#ifdef _WIN32
+	if (this->view)
+		UnmapViewOfFile(this->view);
+	if (this->mapping)
+		CloseHandle(this->mapping);
+	if (this->file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->file);
+	this->mapping = 0;
+	this->file = INVALID_HANDLE_VALUE;
+#else
+	if (this->view)
+		munmap((void*)this->view, this->viewSize);
+	if (this->file >= 0)
+		close(this->file);
+	this->file = -1;
+#endif
+	this->view = 0;
+	this->viewSize = 0;
+}
+
+TextureCache::TextureCache(const std::string& directory) : Directory(directory), Hits(0), Misses(0), Jobs(0)
+{
+}
+
+bool TextureCache::Load(BakedTexture& texture, const std::string& path, const TextureSettings& settings)
+{
+	texture.Release();
+
+	// The PNG itself is small next to its pixels, reading it to hash it is cheap
+	std::vector<unsigned char> png;
+	if (lodepng::load_file(png, path) || png.empty())
+	{
+		std::cout << "ERROR::TEXTURECACHE::FILE_NOT_READ " << path << std::endl;
+		return false;
+	}
+	unsigned long long sourceHash = HashBytes(&png[0], png.size()), sourceSize = png.size();
+	std::string cacheFile = this->cachePath(path, settings);
+
+	if (this->map(texture, cacheFile, sourceHash, sourceSize, settings))
+	{
+		this->Hits++;
+		return true;
+	}
+	this->Misses++;
+
+	std::vector<unsigned char> pixels;
+	unsigned width, height;
+	unsigned error = lodepng::decode(pixels, width, height, png);
+	if (error)
+	{
+		std::cout << "ERROR::TEXTURECACHE::PNG_NOT_DECODED " << path << ": " << lodepng_error_text(error) << std::endl;
+		return false;
+	}
+
+	this->bake(texture, cacheFile, pixels, width, height, sourceHash, sourceSize, settings);
+	return true;
+}
+
+bool TextureCache::Bake(BakedTexture& texture, const std::string& name, const unsigned char* pixels, unsigned width, unsigned height,
+	const TextureSettings& settings)
+{
+	texture.Release();
+
+	// Hashing the pixels costs a fraction of filtering and compressing them
+	unsigned long long sourceHash = HashBytes(pixels, (size_t)width * height * 4);
+	sourceHash = HashBytes(&width, sizeof(width), sourceHash);
+	sourceHash = HashBytes(&height, sizeof(height), sourceHash);
+	unsigned long long sourceSize = (unsigned long long)width * height * 4;
+	std::string cacheFile = this->cachePath(name, settings);
+
+	if (this->map(texture, cacheFile, sourceHash, sourceSize, settings))
+	{
+		this->Hits++;
+		return true;
+	}
+	this->Misses++;
+
+	std::vector<unsigned char> copy(pixels, pixels + (size_t)width * height * 4);
+	this->bake(texture, cacheFile, copy, width, height, sourceHash, sourceSize, settings);
+	return true;
+}
+
+void TextureCache::bake(BakedTexture& texture, const std::string& cacheFile, std::vector<unsigned char>& pixels, unsigned width, unsigned height,
+	unsigned long long sourceHash, unsigned long long sourceSize, const TextureSettings& settings)
+{
+	MipChain chain;
+	if (settings.Mips)
+		chain.Build(pixels.data(), width, height, settings.Filter, settings.Srgb, settings.Wrap, settings.MaxLevels);
+	else
+	{
+		chain.Levels.push_back(MipLevel());
+		chain.Levels[0].Width = width;
+		chain.Levels[0].Height = height;
+		chain.Levels[0].Pixels.swap(pixels);
+	}
+	// From here on the levels hold blocks instead of pixels for the compressed formats
+	if (settings.Format != TEXTURE_RGBA8)
+	{
+		std::vector<unsigned char> blocks;
+		for (size_t i = 0; i < chain.Levels.size(); i++)
+		{
+			MipLevel& level = chain.Levels[i];
+			CompressBlocks(blocks, level.Pixels.data(), level.Width, level.Height, settings.Format, this->Jobs);
+			level.Pixels.swap(blocks);
+		}
+	}
+
+	// Serve this run from the baked copy in memory, the next one maps the file
+	bakeCacheFile(texture.owned, chain, sourceHash, sourceSize, settings);
+	WriteCacheFile(this->Directory, cacheFile, &texture.owned[0], texture.owned.size());
+	parseCacheFile(texture, &texture.owned[0], texture.owned.size(), sourceHash, sourceSize, settings);
+}
+
+std::string TextureCache::cachePath(const std::string& path, const TextureSettings& settings) const
+{
+	// Named after the PNG so the directory stays readable, plus a hash of the full path and the settings
+	// so textures with the same name or baked with different settings don't share a file
+	size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	unsigned key = settingsKey(settings);
+	unsigned long long hash = HashBytes(path.c_str(), path.size());
+	hash = HashBytes(&key, sizeof(key), hash);
+
+	std::ostringstream out;
+	out << this->Directory << "/" << name << "." << std::hex << std::setw(16) << std::setfill('0') << hash << ".tex";
+	return out.str();
+}
+
+bool TextureCache::map(BakedTexture& texture, const std::string& cacheFile, unsigned long long sourceHash, unsigned long long sourceSize, const TextureSettings& settings) const
+{
+#ifdef _WIN32
+	texture.file = CreateFileA(cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (texture.file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(texture.file, &size) || size.QuadPart == 0)
+	{
+		texture.Release();
+		return false;
+	}
+	texture.mapping = CreateFileMappingA(texture.file, 0, PAGE_READONLY, 0, 0, 0);
+	if (texture.mapping)
+		texture.view = (const unsigned char*)MapViewOfFile(texture.mapping, FILE_MAP_READ, 0, 0, 0);
+	texture.viewSize = (size_t)size.QuadPart;
+#else
+	texture.file = open(cacheFile.c_str(), O_RDONLY);
+	if (texture.file < 0)
+		return false;
+	struct stat info;
+	if (fstat(texture.file, &info) != 0 || info.st_size == 0)
+	{
+		texture.Release();
+		return false;
+	}
+	void* view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_SHARED, texture.file, 0);
+	texture.view = view == MAP_FAILED ? 0 : (const unsigned char*)view;
+	texture.viewSize = (size_t)info.st_size;
+#endif
+	if (!texture.view || !parseCacheFile(texture, texture.view, texture.viewSize, sourceHash, sourceSize, settings))
+	{
+		texture.Release();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,109 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Project includes
+#include "MipChain.h"
+#include "BlockCompression.h"
+
+// How a texture gets baked. Part of the cache key, changing any of it bakes the texture again
+struct TextureSettings
+{
+	// Bake the whole mip chain, or level 0 only
+	bool Mips;
+	Mip_Filter Filter;
+	// The texture holds colors in sRGB, not data like a specular mask
+	bool Srgb;
+	// The texture is drawn with GL_REPEAT
+	bool Wrap;
+	// Format the levels are stored and uploaded in, compressed after the mips are built from the full pixels
+	Texture_Format Format;
+	// Levels of the mip chain baked, 0 for all of them down to 1x1
+	unsigned MaxLevels;
+
+	TextureSettings(bool mips = true, Mip_Filter filter = MIP_BOX, bool srgb = true, bool wrap = true, Texture_Format format = TEXTURE_RGBA8,
+		unsigned maxLevels = 0)
+		: Mips(mips), Filter(filter), Srgb(srgb), Wrap(wrap), Format(format), MaxLevels(maxLevels) {}
+};
+
+// One level of a baked texture, pointing into the mapped cache file. Pixels for TEXTURE_RGBA8, blocks for the others
+struct BakedLevel
+{
+	unsigned Width;
+	unsigned Height;
+	const unsigned char* Data;
+	size_t Size;
+};
+
+// A texture ready for upload. Normally a read only view of its cache file mapped into memory, so loading it
+// costs little more than the page faults of the upload; only if the cache file couldn't be written does it own its pixels.
+class BakedTexture
+{
+public:
+	Texture_Format Format;
+	// Level 0 first, one level only if the texture was baked without mips
+	std::vector<BakedLevel> Levels;
+
+	BakedTexture();
+	// Destructor unmaps the cache file
+	~BakedTexture();
+
+	bool IsLoaded() const { return !this->Levels.empty(); }
+	size_t GetByteSize() const;
+	// Unmaps the cache file, the levels are gone afterwards
+	void Release();
+
+private:
+	friend class TextureCache;
+
+	const unsigned char* view;
+	size_t viewSize;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+	// Only used when the texture couldn't be mapped from the cache
+	std::vector<unsigned char> owned;
+
+	BakedTexture(const BakedTexture&);
+	BakedTexture& operator=(const BakedTexture&);
+};
+
+// Keeps the decoded pixels and mips of PNG textures on disk, one file per texture and settings, so later runs skip
+// inflating, unfiltering, converting and filtering. Every file records the hash and the size of the PNG it was baked
+// from and is baked again as soon as the PNG changes. The files are in the byte order of the machine that wrote them,
+// they're a cache of this machine, not something to ship.
+class TextureCache
+{
+public:
+	// Directory the cache files go to, created on the first bake
+	std::string Directory;
+	// Loads that were served from the cache and loads that had to decode the PNG
+	unsigned Hits;
+	unsigned Misses;
+	// Block compression of a bake spreads over these workers if set
+	JobSystem* Jobs;
+
+	TextureCache(const std::string& directory = "TextureCache");
+
+	// Loads the PNG at path into texture through the cache. Returns false if the PNG can't be read or decoded.
+	bool Load(BakedTexture& texture, const std::string& path, const TextureSettings& settings = TextureSettings());
+	// Same for RGBA8 pixels made at runtime, e.g. the pages of an atlas. name takes the place of the path in the
+	// cache key and the pixels the place of the PNG, so the cache file is rebaked when they change.
+	bool Bake(BakedTexture& texture, const std::string& name, const unsigned char* pixels, unsigned width, unsigned height,
+		const TextureSettings& settings = TextureSettings());
+
+private:
+	std::string cachePath(const std::string& path, const TextureSettings& settings) const;
+	// Builds the mips, compresses and writes the cache file, serving texture from memory. Consumes pixels
+	void bake(BakedTexture& texture, const std::string& cacheFile, std::vector<unsigned char>& pixels, unsigned width, unsigned height,
+		unsigned long long sourceHash, unsigned long long sourceSize, const TextureSettings& settings);
+	bool map(BakedTexture& texture, const std::string& cacheFile, unsigned long long sourceHash, unsigned long long sourceSize, const TextureSettings& settings) const;
+};
+#endif
@@ -0,0 +1,208 @@
+#include "TextureManager.h"
+
+// Std. Includes
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+
+// The GL format a compressed texture is uploaded in
+static GLenum compressedFormat(Texture_Format format)
+{
+	return format == TEXTURE_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+		: format == TEXTURE_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+TextureManager::TextureManager(TextureCache& cache, size_t budget)
+	: Budget(budget), Hits(0), Misses(0), Evictions(0), ResidentBytes(0), State(0), cache(cache), frame(1)
+{
+}
+
+TextureHandle TextureManager::Add(const std::string& path, const TextureSettings& settings)
+{
+	Entry entry = Entry();
+	entry.Path = path;
+	entry.Settings = settings;
+	entry.Target = GL_TEXTURE_2D;
+	this->entries.push_back(entry);
+	return (TextureHandle)this->entries.size() - 1;
+}
+
+TextureHandle TextureManager::AddAtlas(const TextureAtlas& atlas, Texture_Format format)
+{
+	// A page holds diffuse colors and specular intensities alike, it's filtered as colors since most maps are
+	Entry entry = Entry();
+	entry.Settings = TextureSettings(true, MIP_BOX, true, false, format);
+	entry.Atlas = &atlas;
+	entry.Target = GL_TEXTURE_2D_ARRAY;
+	this->entries.push_back(entry);
+	return (TextureHandle)this->entries.size() - 1;
+}
+
+GLuint TextureManager::Get(TextureHandle handle)
+{
+	Entry& entry = this->entries[handle];
+	if (entry.Texture)
+	{
+		this->Hits++;
+		this->used.splice(this->used.begin(), this->used, entry.Use);
+	}
+	else if (!entry.Missing)
+	{
+		this->Misses++;
+		if (entry.Atlas)
+			this->loadAtlas(entry);
+		else
+			this->load(entry);
+
+		if (entry.Texture)
+		{
+			this->ResidentBytes += entry.Bytes;
+			this->used.push_front(handle);
+			entry.Use = this->used.begin();
+		}
+		else // The error is printed once, not every frame
+			entry.Missing = true;
+	}
+	entry.LastFrame = this->frame;
+	return entry.Texture;
+}
+
+GLenum TextureManager::GetTarget(TextureHandle handle) const
+{
+	return this->entries[handle].Target;
+}
+
+void TextureManager::BeginFrame()
+{
+	this->frame++;
+}
+
+void TextureManager::Evict(TextureHandle handle)
+{
+	Entry& entry = this->entries[handle];
+	if (!entry.Texture)
+		return;
+	if (this->State)
+		this->State->DeleteTexture(entry.Texture);
+	else
+		glDeleteTextures(1, &entry.Texture);
+	entry.Texture = 0;
+	this->ResidentBytes -= entry.Bytes;
+	this->used.erase(entry.Use);
+}
+
+void TextureManager::Clear()
+{
+	while (!this->used.empty())
+		this->Evict(this->used.front());
+}
+
+void TextureManager::bind(GLenum target, GLuint texture)
+{
+	if (this->State)
+		this->State->BindTexture(target, texture);
+	else
+		glBindTexture(target, texture);
+}
+
+void TextureManager::makeRoom(size_t bytes)
+{
+	// Every Get moves its texture to the front, so the back is the least recently used and once it is in use
+	// this frame, so is everything else
+	while (this->ResidentBytes + bytes > this->Budget && !this->used.empty()
+		&& this->entries[this->used.back()].LastFrame != this->frame)
+	{
+		this->Evict(this->used.back());
+		this->Evictions++;
+	}
+}
+
+void TextureManager::load(Entry& entry)
+{
+	// Mapping the cache file costs next to nothing, so the size is known before anything is evicted for it
+	BakedTexture baked;
+	if (!this->cache.Load(baked, entry.Path, entry.Settings))
+		return;
+	entry.Bytes = baked.GetByteSize();
+	this->makeRoom(entry.Bytes);
+
+	glGenTextures(1, &entry.Texture);
+	this->bind(GL_TEXTURE_2D, entry.Texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, entry.Settings.Wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, entry.Settings.Wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, entry.Settings.Mips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Every level straight from the mapped cache file
+	for (size_t i = 0; i < baked.Levels.size(); i++)
+	{
+		const BakedLevel& level = baked.Levels[i];
+		// RGBA8 rows are always 4 byte aligned, so the default GL_UNPACK_ALIGNMENT fits even the 1x1 level
+		if (baked.Format == TEXTURE_RGBA8)
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA, level.Width, level.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.Data);
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, compressedFormat(baked.Format), level.Width, level.Height, 0, (GLsizei)level.Size, level.Data);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)baked.Levels.size() - 1);
+	this->bind(GL_TEXTURE_2D, 0);
+}
+
+void TextureManager::loadAtlas(Entry& entry)
+{
+	const TextureAtlas& atlas = *entry.Atlas;
+	Texture_Format format = entry.Settings.Format;
+	GLsizei layers = (GLsizei)atlas.Pages.size();
+	if (layers == 0)
+	{
+		std::cout << "ERROR::TEXTUREMANAGER::ATLAS_NOT_PACKED" << std::endl;
+		return;
+	}
+
+	// Only the mip levels the padding keeps apart are baked and uploaded, smaller ones would blend the images
+	// together. Their size follows from the page size, the pages are baked one at a time after making room for all of them
+	GLint levels = 0;
+	entry.Bytes = 0;
+	while (levels < (GLint)atlas.GetMipLevelCount() && ((atlas.PageWidth | atlas.PageHeight) >> levels) != 0)
+	{
+		entry.Bytes += GetTextureLevelSize(format, std::max(atlas.PageWidth >> levels, 1u), std::max(atlas.PageHeight >> levels, 1u)) * layers;
+		levels++;
+	}
+	this->makeRoom(entry.Bytes);
+	TextureSettings settings = entry.Settings;
+	settings.MaxLevels = levels;
+
+	glGenTextures(1, &entry.Texture);
+	this->bind(GL_TEXTURE_2D_ARRAY, entry.Texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	BakedTexture page;
+	for (GLsizei layer = 0; layer < layers; layer++)
+	{
+		// Keyed on the pixels of the page, a reload maps the file baked by the first load
+		std::ostringstream name;
+		name << "atlas" << layer;
+		this->cache.Bake(page, name.str(), &atlas.Pages[layer][0], atlas.PageWidth, atlas.PageHeight, settings);
+		for (GLint i = 0; i < levels; i++)
+		{
+			const BakedLevel& level = page.Levels[i];
+			// Storage for all layers of the level comes with the first one
+			if (format == TEXTURE_RGBA8)
+			{
+				if (layer == 0)
+					glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA, level.Width, level.Height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.Width, level.Height, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.Data);
+			}
+			else
+			{
+				if (layer == 0)
+					glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, compressedFormat(format), level.Width, level.Height, layers, 0, (GLsizei)level.Size * layers, 0);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.Width, level.Height, 1, compressedFormat(format), (GLsizei)level.Size, level.Data);
+			}
+		}
+	}
+	this->bind(GL_TEXTURE_2D_ARRAY, 0);
+}
@@ -0,0 +1,88 @@
+#ifndef TEXTUREMANAGER_H
+#define TEXTUREMANAGER_H
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <list>
+#include <cstddef>
+
+// GL Includes
+#include <GL\glew.h>
+
+// Project includes
+#include "TextureCache.h"
+#include "TextureAtlas.h"
+#include "GLState.h"
+
+// Index of a texture registered with the TextureManager, stays valid while the texture is evicted and reloaded
+typedef unsigned TextureHandle;
+
+// Owns the GL textures of the scene and keeps the bytes they take on the GPU, mips included, within a budget.
+// Textures are loaded on their first Get, and when the budget is full the least recently used ones are deleted
+// and loaded again from the texture cache the next time they are asked for. Textures used in the current frame
+// are never evicted, if they alone exceed the budget it is overrun rather than drawing without them.
+class TextureManager
+{
+public:
+	// Bytes the resident textures may take, changes apply on the next load
+	size_t Budget;
+	// Gets of resident textures, gets that had to load the texture, textures deleted to stay in the budget
+	unsigned Hits;
+	unsigned Misses;
+	unsigned Evictions;
+	size_t ResidentBytes;
+	// Textures are bound and deleted through this if set, so it knows the bindings loads and evictions change
+	GLState* State;
+
+	TextureManager(TextureCache& cache, size_t budget = 256 * 1024 * 1024);
+
+	// Registers the PNG at path, it is loaded through the cache with settings on its first Get
+	TextureHandle Add(const std::string& path, const TextureSettings& settings = TextureSettings());
+	// Registers the pages of the atlas as one GL_TEXTURE_2D_ARRAY, each page baked through the cache in format.
+	// The atlas is read again on every reload, it must stay alive and packed as long as the manager
+	TextureHandle AddAtlas(const TextureAtlas& atlas, Texture_Format format);
+
+	// The texture of handle, loading it first if it isn't resident. Marks it as used in this frame
+	GLuint Get(TextureHandle handle);
+	// GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for atlases
+	GLenum GetTarget(TextureHandle handle) const;
+	// Starts a new frame, the textures used so far become candidates for eviction
+	void BeginFrame();
+	// Deletes the texture of handle, it stays registered and loads again on the next Get
+	void Evict(TextureHandle handle);
+	// Deletes every texture. Call while the GL context is still current, before glfwTerminate
+	void Clear();
+
+private:
+	struct Entry
+	{
+		std::string Path;
+		TextureSettings Settings;
+		const TextureAtlas* Atlas;
+		GLenum Target;
+		GLuint Texture;
+		size_t Bytes;
+		unsigned LastFrame;
+		// Failed to load, not tried again
+		bool Missing;
+		// Position in the use list, only meaningful while the texture is resident
+		std::list<TextureHandle>::iterator Use;
+	};
+
+	TextureCache& cache;
+	std::vector<Entry> entries;
+	// Resident textures, most recently used first
+	std::list<TextureHandle> used;
+	unsigned frame;
+
+	// Evicts the least recently used textures not in use this frame until bytes more fit in the budget
+	void makeRoom(size_t bytes);
+	void load(Entry& entry);
+	void loadAtlas(Entry& entry);
+	void bind(GLenum target, GLuint texture);
+
+	TextureManager(const TextureManager&);
+	TextureManager& operator=(const TextureManager&);
+};
+#endif
@@ -0,0 +1,302 @@
+#include "Transforms.h"
+
+// Std. Includes
+#include <cmath>
+#if defined(__AVX__)
+#define TRANSFORMS_AVX
+#include <immintrin.h>
+#endif
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRANSFORMS_SSE2
+#include <emmintrin.h>
+#endif
+
+unsigned TransformArrays::Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	this->PositionX.push_back(0.0f);
+	this->PositionY.push_back(0.0f);
+	this->PositionZ.push_back(0.0f);
+	this->RotationX.push_back(0.0f);
+	this->RotationY.push_back(0.0f);
+	this->RotationZ.push_back(0.0f);
+	this->RotationW.push_back(1.0f);
+	this->ScaleX.push_back(1.0f);
+	this->ScaleY.push_back(1.0f);
+	this->ScaleZ.push_back(1.0f);
+	unsigned index = (unsigned)this->PositionX.size() - 1;
+	this->Set(index, position, rotation, scale);
+	return index;
+}
+
+void TransformArrays::Set(unsigned index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	this->PositionX[index] = position.x;
+	this->PositionY[index] = position.y;
+	this->PositionZ[index] = position.z;
+	this->RotationX[index] = rotation.x;
+	this->RotationY[index] = rotation.y;
+	this->RotationZ[index] = rotation.z;
+	this->RotationW[index] = rotation.w;
+	this->ScaleX[index] = scale.x;
+	this->ScaleY[index] = scale.y;
+	this->ScaleZ[index] = scale.z;
+}
+
+void TransformArrays::Clear()
+{
+	this->PositionX.clear();
+	this->PositionY.clear();
+	this->PositionZ.clear();
+	this->RotationX.clear();
+	this->RotationY.clear();
+	this->RotationZ.clear();
+	this->RotationW.clear();
+	this->ScaleX.clear();
+	this->ScaleY.clear();
+	this->ScaleZ.clear();
+}
+
+unsigned AxisAngleArrays::Add(const glm::vec3& axis, float angle)
+{
+	this->AxisX.push_back(0.0f);
+	this->AxisY.push_back(0.0f);
+	this->AxisZ.push_back(1.0f);
+	this->Angle.push_back(0.0f);
+	unsigned index = (unsigned)this->AxisX.size() - 1;
+	this->Set(index, axis, angle);
+	return index;
+}
+
+void AxisAngleArrays::Set(unsigned index, const glm::vec3& axis, float angle)
+{
+	glm::vec3 unit = glm::normalize(axis);
+	this->AxisX[index] = unit.x;
+	this->AxisY[index] = unit.y;
+	this->AxisZ[index] = unit.z;
+	this->Angle[index] = angle;
+}
+
+void AxisAngleArrays::Clear()
+{
+	this->AxisX.clear();
+	this->AxisY.clear();
+	this->AxisZ.clear();
+	this->Angle.clear();
+}
+
+// The sine and cosine polynomials of Cephes' sinf and cosf, for angles within pi / 4 of 0. Larger angles are
+// brought there by taking out the nearest multiple of pi / 2, in three parts so the first products are exact
+static const float quarterTurn1 = 1.5703125f;
+static const float quarterTurn2 = 4.837512969970703125e-4f;
+static const float quarterTurn3 = 7.54978995489188216e-8f;
+static const float sin1 = -1.6666654611e-1f, sin2 = 8.3321608736e-3f, sin3 = -1.9515295891e-4f;
+static const float cos1 = 4.166664568298827e-2f, cos2 = -1.388731625493765e-3f, cos3 = 2.443315711809948e-5f;
+
+static void rotationsScalar(TransformArrays& transforms, const AxisAngleArrays& rotations, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float half = rotations.Angle[i] * 0.5f;
+		float s = std::sin(half);
+		transforms.RotationX[i] = rotations.AxisX[i] * s;
+		transforms.RotationY[i] = rotations.AxisY[i] * s;
+		transforms.RotationZ[i] = rotations.AxisZ[i] * s;
+		transforms.RotationW[i] = std::cos(half);
+	}
+}
+
+#if defined(TRANSFORMS_SSE2) && !defined(TRANSFORMS_AVX)
+// Sine and cosine of 4 angles. The quarter turns taken out pick which polynomial is which and their signs: an odd
+// count swaps them, bit 1 of it negates the sine and bit 1 of it plus one the cosine. Shifting those bits up to the
+// top makes them the sign masks
+static void sinCos(__m128 angle, __m128& sine, __m128& cosine)
+{
+	__m128i turns = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(0.636619772f)));
+	__m128 n = _mm_cvtepi32_ps(turns);
+	__m128 r = _mm_sub_ps(angle, _mm_mul_ps(n, _mm_set1_ps(quarterTurn1)));
+	r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(quarterTurn2)));
+	r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(quarterTurn3)));
+	__m128 z = _mm_mul_ps(r, r);
+	__m128 s = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(sin3), z), _mm_set1_ps(sin2)), z),
+		_mm_set1_ps(sin1)), _mm_mul_ps(z, r)), r);
+	__m128 c = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(cos3), z), _mm_set1_ps(cos2)), z),
+		_mm_set1_ps(cos1)), _mm_mul_ps(z, z)), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)));
+	__m128i one = _mm_set1_epi32(1);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(turns, one), one));
+	__m128 signBit = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+	__m128 sineSign = _mm_and_ps(_mm_castsi128_ps(_mm_slli_epi32(turns, 30)), signBit);
+	__m128 cosineSign = _mm_and_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(turns, one), 30)), signBit);
+	sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sineSign);
+	cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosineSign);
+}
+#endif
+
+#ifdef TRANSFORMS_SSE2
+// Writes 4 model matrices from the 3 columns of their rotations and scales, a register per component of a column,
+// and their positions. Every column of 4 objects is a 4x4 transpose
+static void storeMatrices(glm::mat4* models, __m128 columns[3][3], __m128 x, __m128 y, __m128 z)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		__m128 a = columns[c][0], b = columns[c][1], d = columns[c][2], w = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(a, b, d, w);
+		_mm_storeu_ps(&models[0][c][0], a);
+		_mm_storeu_ps(&models[1][c][0], b);
+		_mm_storeu_ps(&models[2][c][0], d);
+		_mm_storeu_ps(&models[3][c][0], w);
+	}
+	__m128 w = _mm_set1_ps(1.0f);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&models[0][3][0], x);
+	_mm_storeu_ps(&models[1][3][0], y);
+	_mm_storeu_ps(&models[2][3][0], z);
+	_mm_storeu_ps(&models[3][3][0], w);
+}
+#endif
+
+#ifdef TRANSFORMS_AVX
+// sinCos for 8 angles. AVX has no 256 bit integer instructions, so the quarter turns are counted in floats and
+// the mod 4 taken with a floor
+static void sinCos(__m256 angle, __m256& sine, __m256& cosine)
+{
+	__m256 n = _mm256_round_ps(_mm256_mul_ps(angle, _mm256_set1_ps(0.636619772f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_sub_ps(angle, _mm256_mul_ps(n, _mm256_set1_ps(quarterTurn1)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(quarterTurn2)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(quarterTurn3)));
+	__m256 z = _mm256_mul_ps(r, r);
+	__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(sin3), z),
+		_mm256_set1_ps(sin2)), z), _mm256_set1_ps(sin1)), _mm256_mul_ps(z, r)), r);
+	__m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(cos3), z),
+		_mm256_set1_ps(cos2)), z), _mm256_set1_ps(cos1)), _mm256_mul_ps(z, z)),
+		_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), z)));
+	__m256 quarter = _mm256_sub_ps(n, _mm256_mul_ps(_mm256_set1_ps(4.0f), _mm256_floor_ps(_mm256_mul_ps(n, _mm256_set1_ps(0.25f)))));
+	__m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), three = _mm256_set1_ps(3.0f);
+	__m256 swap = _mm256_or_ps(_mm256_cmp_ps(quarter, one, _CMP_EQ_OQ), _mm256_cmp_ps(quarter, three, _CMP_EQ_OQ));
+	__m256 signBit = _mm256_set1_ps(-0.0f);
+	__m256 sineSign = _mm256_and_ps(_mm256_cmp_ps(quarter, two, _CMP_GE_OQ), signBit);
+	__m256 cosineSign = _mm256_and_ps(_mm256_or_ps(_mm256_cmp_ps(quarter, one, _CMP_EQ_OQ), _mm256_cmp_ps(quarter, two, _CMP_EQ_OQ)), signBit);
+	// Selected with masks rather than blends, which are slower on a mask that changes from angle to angle
+	sine = _mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(swap, c), _mm256_andnot_ps(swap, s)), sineSign);
+	cosine = _mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(swap, s), _mm256_andnot_ps(swap, c)), cosineSign);
+}
+#endif
+
+void SetRotations(TransformArrays& transforms, const AxisAngleArrays& rotations, size_t begin, size_t end, bool simd)
+{
+	size_t i = begin;
+	if (simd && begin < end)
+	{
+		float *x = &transforms.RotationX[0], *y = &transforms.RotationY[0], *z = &transforms.RotationZ[0], *w = &transforms.RotationW[0];
+		const float *axisX = &rotations.AxisX[0], *axisY = &rotations.AxisY[0], *axisZ = &rotations.AxisZ[0], *angle = &rotations.Angle[0];
+#if defined(TRANSFORMS_AVX)
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 s, c;
+			sinCos(_mm256_mul_ps(_mm256_loadu_ps(angle + i), _mm256_set1_ps(0.5f)), s, c);
+			_mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(axisX + i), s));
+			_mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(axisY + i), s));
+			_mm256_storeu_ps(z + i, _mm256_mul_ps(_mm256_loadu_ps(axisZ + i), s));
+			_mm256_storeu_ps(w + i, c);
+		}
+#elif defined(TRANSFORMS_SSE2)
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 s, c;
+			sinCos(_mm_mul_ps(_mm_loadu_ps(angle + i), _mm_set1_ps(0.5f)), s, c);
+			_mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(axisX + i), s));
+			_mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(axisY + i), s));
+			_mm_storeu_ps(z + i, _mm_mul_ps(_mm_loadu_ps(axisZ + i), s));
+			_mm_storeu_ps(w + i, c);
+		}
+#endif
+	}
+	rotationsScalar(transforms, rotations, i, end);
+}
+
+// The rotation matrix of a unit quaternion, as glm::mat4_cast makes it, with column c scaled by scale c
+static void composeScalar(const TransformArrays& transforms, size_t begin, size_t end, glm::mat4* models)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float x = transforms.RotationX[i], y = transforms.RotationY[i], z = transforms.RotationZ[i], w = transforms.RotationW[i];
+		float x2 = x + x, y2 = y + y, z2 = z + z;
+		float xx = x * x2, yy = y * y2, zz = z * z2, xy = x * y2, xz = x * z2, yz = y * z2, wx = w * x2, wy = w * y2, wz = w * z2;
+		float sx = transforms.ScaleX[i], sy = transforms.ScaleY[i], sz = transforms.ScaleZ[i];
+		glm::mat4& model = models[i];
+		model[0] = glm::vec4((1.0f - (yy + zz)) * sx, (xy + wz) * sx, (xz - wy) * sx, 0.0f);
+		model[1] = glm::vec4((xy - wz) * sy, (1.0f - (xx + zz)) * sy, (yz + wx) * sy, 0.0f);
+		model[2] = glm::vec4((xz + wy) * sz, (yz - wx) * sz, (1.0f - (xx + yy)) * sz, 0.0f);
+		model[3] = glm::vec4(transforms.PositionX[i], transforms.PositionY[i], transforms.PositionZ[i], 1.0f);
+	}
+}
+
+void ComposeTransforms(const TransformArrays& transforms, size_t begin, size_t end, glm::mat4* models, bool simd)
+{
+	size_t i = begin;
+	if (simd && begin < end)
+	{
+		const float *px = &transforms.PositionX[0], *py = &transforms.PositionY[0], *pz = &transforms.PositionZ[0];
+		const float *qx = &transforms.RotationX[0], *qy = &transforms.RotationY[0], *qz = &transforms.RotationZ[0], *qw = &transforms.RotationW[0];
+		const float *scaleX = &transforms.ScaleX[0], *scaleY = &transforms.ScaleY[0], *scaleZ = &transforms.ScaleZ[0];
+#if defined(TRANSFORMS_AVX)
+		// 8 objects at a time, stored as two groups of 4
+		__m256 one = _mm256_set1_ps(1.0f);
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(qx + i), y = _mm256_loadu_ps(qy + i), z = _mm256_loadu_ps(qz + i), w = _mm256_loadu_ps(qw + i);
+			__m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+			__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+			__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+			__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+			__m256 sx = _mm256_loadu_ps(scaleX + i), sy = _mm256_loadu_ps(scaleY + i), sz = _mm256_loadu_ps(scaleZ + i);
+			__m256 columns[3][3] = {
+				{ _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx), _mm256_mul_ps(_mm256_add_ps(xy, wz), sx), _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx) },
+				{ _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy), _mm256_mul_ps(_mm256_add_ps(yz, wx), sy) },
+				{ _mm256_mul_ps(_mm256_add_ps(xz, wy), sz), _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz) }
+			};
+			__m256 positionX = _mm256_loadu_ps(px + i), positionY = _mm256_loadu_ps(py + i), positionZ = _mm256_loadu_ps(pz + i);
+			__m128 low[3][3], high[3][3];
+			for (int c = 0; c < 3; c++)
+			{
+				for (int r = 0; r < 3; r++)
+				{
+					low[c][r] = _mm256_castps256_ps128(columns[c][r]);
+					high[c][r] = _mm256_extractf128_ps(columns[c][r], 1);
+				}
+			}
+			storeMatrices(models + i, low, _mm256_castps256_ps128(positionX), _mm256_castps256_ps128(positionY), _mm256_castps256_ps128(positionZ));
+			storeMatrices(models + i + 4, high, _mm256_extractf128_ps(positionX, 1), _mm256_extractf128_ps(positionY, 1), _mm256_extractf128_ps(positionZ, 1));
+		}
+#elif defined(TRANSFORMS_SSE2)
+		// 4 objects at a time
+		__m128 one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(qx + i), y = _mm_loadu_ps(qy + i), z = _mm_loadu_ps(qz + i), w = _mm_loadu_ps(qw + i);
+			__m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+			__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+			__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+			__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+			__m128 sx = _mm_loadu_ps(scaleX + i), sy = _mm_loadu_ps(scaleY + i), sz = _mm_loadu_ps(scaleZ + i);
+			__m128 columns[3][3] = {
+				{ _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(xz, wy), sx) },
+				{ _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_add_ps(yz, wx), sy) },
+				{ _mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz) }
+			};
+			storeMatrices(models + i, columns, _mm_loadu_ps(px + i), _mm_loadu_ps(py + i), _mm_loadu_ps(pz + i));
+		}
+#endif
+	}
+	composeScalar(transforms, i, end, models);
+}
+
+const char* GetTransformInstructions()
+{
+#if defined(TRANSFORMS_AVX)
+	return "AVX";
+#elif defined(TRANSFORMS_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+// Std. Includes
+#include <vector>
+#include <cstddef>
+
+// GL Includes
+#include <glm\glm.hpp>
+#include <glm\gtc\quaternion.hpp>
+
+// Where objects are, how they are turned and how big they are, as a structure of arrays so one SIMD register
+// holds a component of 4 or 8 of them. Rotations are unit quaternions
+struct TransformArrays
+{
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+
+	// Returns the index the model matrices give the object
+	unsigned Add(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+	void Set(unsigned index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void Clear();
+	size_t GetSize() const { return this->PositionX.size(); }
+};
+
+// Rotations by an angle in radians about an axis, a structure of arrays like TransformArrays. The axes are
+// normalized once when added, not every time they are turned into rotations
+struct AxisAngleArrays
+{
+	std::vector<float> AxisX, AxisY, AxisZ, Angle;
+
+	unsigned Add(const glm::vec3& axis, float angle);
+	void Set(unsigned index, const glm::vec3& axis, float angle);
+	void Clear();
+	size_t GetSize() const { return this->AxisX.size(); }
+};
+
+// Sets the rotations of the transforms begin to end to the axis angles of the same index, the sines and cosines of
+// 4 or 8 half angles at a time. The SIMD sines and cosines are polynomials, within a few units in the last place
+// of std::sin and std::cos for angles up to a few thousand turns. With simd false they are std::sin and std::cos,
+// one object at a time
+void SetRotations(TransformArrays& transforms, const AxisAngleArrays& rotations, size_t begin, size_t end, bool simd = true);
+// Writes translate(position) * rotation * scale(scale) of the transforms begin to end to the same index of models,
+// what glm::translate, glm::rotate and glm::scale would build, 4 or 8 objects at a time. Ranges are independent,
+// so a JobSystem can split a batch
+void ComposeTransforms(const TransformArrays& transforms, size_t begin, size_t end, glm::mat4* models, bool simd = true);
+// The instruction set the transforms were compiled for: "AVX", "SSE2" or "scalar"
+const char* GetTransformInstructions();
+#endif
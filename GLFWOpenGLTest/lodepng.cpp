@@ -1102,9 +1102,9 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
-/*inflate a block with dynamic of fixed Huffman tree*/
+/*inflate a block with dynamic of fixed Huffman tree, stops early once *pos reaches stoppos*/
 static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+                                    size_t* pos, size_t inlength, unsigned btype, size_t stoppos)
 {
   unsigned error = 0;
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
@@ -1120,7 +1120,9 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    unsigned code_ll;
+    if(*pos >= stoppos) break; /*the caller has all the output it asked for*/
+    code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
     if(code_ll <= 255) /*literal symbol*/
     {
       /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
@@ -1225,29 +1227,84 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
   return error;
 }
 
-static unsigned lodepng_inflatev(ucvector* out,
-                                 const unsigned char* in, size_t insize,
-                                 const LodePNGDecompressSettings* settings)
+/*
+Block boundaries recorded while inflating: bit position of the block header and the
+output position it decodes to. Only boundaries at least spacing output bytes after the
+previous recorded one are kept. Used to build the checkpoints of a LodePNGRowIndex.
+*/
+typedef struct InflateBlockLog
+{
+  size_t* bitpos;
+  size_t* outpos;
+  size_t size;
+  size_t allocsize;
+  size_t spacing;
+} InflateBlockLog;
+
+static void InflateBlockLog_init(InflateBlockLog* log, size_t spacing)
+{
+  log->bitpos = log->outpos = 0;
+  log->size = log->allocsize = 0;
+  log->spacing = spacing ? spacing : 1;
+}
+
+static void InflateBlockLog_cleanup(InflateBlockLog* log)
+{
+  lodepng_free(log->bitpos);
+  lodepng_free(log->outpos);
+  InflateBlockLog_init(log, log->spacing);
+}
+
+static unsigned InflateBlockLog_add(InflateBlockLog* log, size_t bitpos, size_t outpos)
+{
+  size_t last = log->size ? log->outpos[log->size - 1] : 0;
+  if(outpos < last + log->spacing) return 0; /*too close to the previous one, not an error*/
+  if(log->size >= log->allocsize)
+  {
+    size_t newsize = log->allocsize * 2 + 16;
+    size_t* newbit = (size_t*)lodepng_realloc(log->bitpos, newsize * sizeof(size_t));
+    size_t* newout;
+    if(!newbit) return 83; /*alloc fail*/
+    log->bitpos = newbit;
+    newout = (size_t*)lodepng_realloc(log->outpos, newsize * sizeof(size_t));
+    if(!newout) return 83; /*alloc fail*/
+    log->outpos = newout;
+    log->allocsize = newsize;
+  }
+  log->bitpos[log->size] = bitpos;
+  log->outpos[log->size] = outpos;
+  ++log->size;
+  return 0;
+}
+
+/*
+Inflates the deflate stream starting at bit *bp, writing to out from *pos on. Stops after
+the final block, or as soon as *pos reaches stoppos (it may overshoot by one LZ77 match).
+The bytes before *pos in out are the sliding window for back references, which is how
+decoding can resume from a saved checkpoint. log may be NULL.
+*/
+static unsigned inflateRange(ucvector* out, const unsigned char* in, size_t insize,
+                             size_t* bp, size_t* pos, size_t stoppos, InflateBlockLog* log)
 {
-  /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
-  size_t bp = 0;
   unsigned BFINAL = 0;
-  size_t pos = 0; /*byte position in the out buffer*/
   unsigned error = 0;
 
-  (void)settings;
-
-  while(!BFINAL)
+  while(!BFINAL && *pos < stoppos)
   {
     unsigned BTYPE;
-    if(bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
-    BFINAL = readBitFromStream(&bp, in);
-    BTYPE = 1u * readBitFromStream(&bp, in);
-    BTYPE += 2u * readBitFromStream(&bp, in);
+    if(*bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
+    if(log)
+    {
+      error = InflateBlockLog_add(log, *bp, *pos);
+      if(error) return error;
+    }
+    BFINAL = readBitFromStream(bp, in);
+    BTYPE = 1u * readBitFromStream(bp, in);
+    BTYPE += 2u * readBitFromStream(bp, in);
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
-    else if(BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+    else if(BTYPE == 0) error = inflateNoCompression(out, in, bp, pos, insize); /*no compression*/
+    else error = inflateHuffmanBlock(out, in, bp, pos, insize, BTYPE, stoppos); /*compression, BTYPE 01 or 10*/
 
     if(error) return error;
   }
@@ -1255,6 +1312,24 @@ static unsigned lodepng_inflatev(ucvector* out,
   return error;
 }
 
+static unsigned lodepng_inflatev(ucvector* out,
+                                 const unsigned char* in, size_t insize,
+                                 const LodePNGDecompressSettings* settings)
+{
+  /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
+  size_t bp = 0;
+  size_t pos = 0; /*byte position in the out buffer*/
+
+  size_t stoppos = (size_t)(-1);
+  unsigned error;
+
+  /*stopping right after the limit is free, inflateHuffmanBlock checks stoppos for every symbol anyway*/
+  if(settings->max_output_size && settings->max_output_size < stoppos) stoppos = settings->max_output_size + 1;
+  error = inflateRange(out, in, insize, &bp, &pos, stoppos, 0);
+  if(!error && settings->max_output_size && pos > settings->max_output_size) error = 98;
+  return error;
+}
+
 unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGDecompressSettings* settings)
@@ -1274,7 +1349,10 @@ static unsigned inflate(unsigned char** out, size_t* outsize,
 {
   if(settings->custom_inflate)
   {
-    return settings->custom_inflate(out, outsize, in, insize, settings);
+    /*a custom inflate can only be checked after the fact*/
+    unsigned error = settings->custom_inflate(out, outsize, in, insize, settings);
+    if(!error && settings->max_output_size && *outsize > settings->max_output_size) error = 98;
+    return error;
   }
   else
   {
@@ -2102,10 +2180,9 @@ static unsigned adler32(const unsigned char* data, unsigned len)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize, const LodePNGDecompressSettings* settings)
+/*checks the 2-byte zlib header in front of the deflate data, returns error code*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize)
 {
-  unsigned error = 0;
   unsigned CM, CINFO, FDICT;
 
   if(insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2134,6 +2211,15 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
     return 26;
   }
 
+  return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings)
+{
+  unsigned error = zlib_check_header(in, insize);
+  if(error) return error;
+
   error = inflate(out, outsize, in + 2, insize - 2, settings);
   if(error) return error;
 
@@ -2274,13 +2360,14 @@ const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT
 void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
 {
   settings->ignore_adler32 = 0;
+  settings->max_output_size = 0;
 
   settings->custom_zlib = 0;
   settings->custom_inflate = 0;
   settings->custom_context = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0};
+const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0, 0};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -3863,6 +3950,8 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   /*read the values given in the header*/
   *w = lodepng_read32bitInt(&in[16]);
   *h = lodepng_read32bitInt(&in[20]);
+  /*error: invalid color type, checked here already because out of range values can't go in the enum*/
+  if(in[25] > 6) CERROR_RETURN_ERROR(state->error, 31);
   info->color.bitdepth = in[24];
   info->color.colortype = (LodePNGColorType)in[25];
   info->compression_method = in[26];
@@ -4447,18 +4536,45 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*size of the inflated IDAT data of an image: the filtered scanlines of all passes, with their filter bytes*/
+static size_t predictIdatSize(unsigned w, unsigned h, const LodePNGInfo* info_png)
 {
+  const LodePNGColorMode* color = &info_png->color;
+  size_t predict = 0;
+  if(info_png->interlace_method == 0)
+  {
+    /*The extra h is added because this are the filter bytes every scanline starts with*/
+    predict = lodepng_get_raw_size_idat(w, h, color) + h;
+  }
+  else
+  {
+    /*Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes*/
+    predict += lodepng_get_raw_size_idat((w + 7) / 8, (h + 7) / 8, color) + (h + 7) / 8;
+    if(w > 4) predict += lodepng_get_raw_size_idat((w + 3) / 8, (h + 7) / 8, color) + (h + 7) / 8;
+    predict += lodepng_get_raw_size_idat((w + 3) / 4, (h + 3) / 8, color) + (h + 3) / 8;
+    if(w > 2) predict += lodepng_get_raw_size_idat((w + 1) / 4, (h + 3) / 4, color) + (h + 3) / 4;
+    predict += lodepng_get_raw_size_idat((w + 1) / 2, (h + 1) / 4, color) + (h + 1) / 4;
+    if(w > 1) predict += lodepng_get_raw_size_idat((w + 0) / 2, (h + 1) / 2, color) + (h + 1) / 2;
+    predict += lodepng_get_raw_size_idat((w + 0) / 1, (h + 0) / 2, color) + (h + 0) / 2;
+  }
+  return predict;
+}
+
+/*
+read the header and all chunks of a PNG, filling in state->info_png and gathering the
+concatenated zlib data of the IDAT chunks in idat (which must be initialized)
+limits: 0 ignores max_pixels, max_chunks and max_output_size, only for the benchmark
+*/
+static void decodeChunks(ucvector* idat, unsigned* w, unsigned* h,
+                         LodePNGState* state,
+                         const unsigned char* in, size_t insize, unsigned limits)
+{
+  LodePNGDecompressSettings zlibsettings = state->decoder.zlibsettings;
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  ucvector scanlines;
-  size_t predict;
   size_t numpixels;
+  unsigned numchunks = 1; /*the IHDR*/
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
@@ -4466,9 +4582,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-  /*provide some proper output values if error will happen*/
-  *out = 0;
-
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
 
@@ -4480,7 +4593,14 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   bytes with 16-bit RGBA, the rest is room for filter bytes.*/
   if(numpixels > 268435455) CERROR_RETURN(state->error, 92);
 
-  ucvector_init(&idat);
+  /*configured limits, checked before anything gets allocated for the image*/
+  if(limits && state->decoder.max_pixels && numpixels > state->decoder.max_pixels) CERROR_RETURN(state->error, 99);
+  if(!limits) zlibsettings.max_output_size = 0;
+  if(zlibsettings.max_output_size && predictIdatSize(*w, *h, &state->info_png) > zlibsettings.max_output_size)
+  {
+    CERROR_RETURN(state->error, 98);
+  }
+
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4492,6 +4612,7 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     /*error: size of the in buffer too small to contain next chunk*/
     if((size_t)((chunk - in) + 12) > insize || chunk < in) CERROR_BREAK(state->error, 30);
+    if(limits && state->decoder.max_chunks && ++numchunks > state->decoder.max_chunks) CERROR_BREAK(state->error, 100);
 
     /*length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes*/
     chunkLength = lodepng_chunk_length(chunk);
@@ -4508,9 +4629,9 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT"))
     {
-      size_t oldsize = idat.size;
-      if(!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+      size_t oldsize = idat->size;
+      if(!ucvector_resize(idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      for(i = 0; i != chunkLength; ++i) idat->data[oldsize + i] = data[i];
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -4556,7 +4677,7 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     {
       if(state->decoder.read_text_chunks)
       {
-        state->error = readChunk_zTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
+        state->error = readChunk_zTXt(&state->info_png, &zlibsettings, data, chunkLength);
         if(state->error) break;
       }
     }
@@ -4565,7 +4686,7 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     {
       if(state->decoder.read_text_chunks)
       {
-        state->error = readChunk_iTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
+        state->error = readChunk_iTXt(&state->info_png, &zlibsettings, data, chunkLength);
         if(state->error) break;
       }
     }
@@ -4603,34 +4724,42 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
+}
+
+/*read a PNG, the result will be in the same color type as the PNG (hence "generic"). limits as in decodeChunks*/
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize, unsigned limits)
+{
+  ucvector idat; /*the data from idat chunks*/
+  ucvector scanlines;
+  size_t predict;
+
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+
+  ucvector_init(&idat);
+  decodeChunks(&idat, w, h, state, in, insize, limits);
+  if(state->error)
+  {
+    ucvector_cleanup(&idat);
+    return;
+  }
 
   ucvector_init(&scanlines);
   /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
   If the decompressed size does not match the prediction, the image must be corrupt.*/
-  if(state->info_png.interlace_method == 0)
-  {
-    /*The extra *h is added because this are the filter bytes every scanline starts with*/
-    predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
-  }
-  else
-  {
-    /*Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes*/
-    const LodePNGColorMode* color = &state->info_png.color;
-    predict = 0;
-    predict += lodepng_get_raw_size_idat((*w + 7) / 8, (*h + 7) / 8, color) + (*h + 7) / 8;
-    if(*w > 4) predict += lodepng_get_raw_size_idat((*w + 3) / 8, (*h + 7) / 8, color) + (*h + 7) / 8;
-    predict += lodepng_get_raw_size_idat((*w + 3) / 4, (*h + 3) / 8, color) + (*h + 3) / 8;
-    if(*w > 2) predict += lodepng_get_raw_size_idat((*w + 1) / 4, (*h + 3) / 4, color) + (*h + 3) / 4;
-    predict += lodepng_get_raw_size_idat((*w + 1) / 2, (*h + 1) / 4, color) + (*h + 1) / 4;
-    if(*w > 1) predict += lodepng_get_raw_size_idat((*w + 0) / 2, (*h + 1) / 2, color) + (*h + 1) / 2;
-    predict += lodepng_get_raw_size_idat((*w + 0) / 1, (*h + 0) / 2, color) + (*h + 0) / 2;
-  }
+  predict = predictIdatSize(*w, *h, &state->info_png);
   if(!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
   if(!state->error)
   {
+    /*never inflate past the prediction, a stream that goes on is corrupt and may be a zlib bomb*/
+    LodePNGDecompressSettings zlibsettings = state->decoder.zlibsettings;
+    zlibsettings.max_output_size = limits ? predict : 0;
     state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-                                   idat.size, &state->decoder.zlibsettings);
-    if(!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
+                                   idat.size, &zlibsettings);
+    /*decompressed size doesn't match prediction*/
+    if(state->error == 98 || (!state->error && scanlines.size != predict)) state->error = 91;
   }
   ucvector_cleanup(&idat);
 
@@ -4646,13 +4775,9 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   ucvector_cleanup(&scanlines);
 }
 
-unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
-                        LodePNGState* state,
-                        const unsigned char* in, size_t insize)
+/*converts the w * h pixels in *out from the PNG color type to info_raw, replacing *out if needed*/
+static unsigned convertDecoded(unsigned char** out, unsigned w, unsigned h, LodePNGState* state)
 {
-  *out = 0;
-  decodeGeneric(out, w, h, state, in, insize);
-  if(state->error) return state->error;
   if(!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
   {
     /*same color type, no copying or converting of data needed*/
@@ -4678,19 +4803,29 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
       return 56; /*unsupported color mode conversion*/
     }
 
-    outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
+    outsize = lodepng_get_raw_size(w, h, &state->info_raw);
     *out = (unsigned char*)lodepng_malloc(outsize);
     if(!(*out))
     {
       state->error = 83; /*alloc fail*/
     }
     else state->error = lodepng_convert(*out, data, &state->info_raw,
-                                        &state->info_png.color, *w, *h);
+                                        &state->info_png.color, w, h);
     lodepng_free(data);
   }
   return state->error;
 }
 
+unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
+                        LodePNGState* state,
+                        const unsigned char* in, size_t insize)
+{
+  *out = 0;
+  decodeGeneric(out, w, h, state, in, insize, 1);
+  if(state->error) return state->error;
+  return convertDecoded(out, *w, *h, state);
+}
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -4738,6 +4873,347 @@ unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h, co
 }
 #endif /*LODEPNG_COMPILE_DISK*/
 
+#ifdef LODEPNG_COMPILE_ZLIB
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / Partial decoding                                                       / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+void lodepng_row_index_init(LodePNGRowIndex* index)
+{
+  index->w = index->h = 0;
+  index->linebytes = 0;
+  index->checkpoints = 0;
+  index->numcheckpoints = 0;
+}
+
+void lodepng_row_index_cleanup(LodePNGRowIndex* index)
+{
+  size_t i;
+  for(i = 0; i != index->numcheckpoints; ++i)
+  {
+    lodepng_free(index->checkpoints[i].window);
+    lodepng_free(index->checkpoints[i].prevline);
+  }
+  lodepng_free(index->checkpoints);
+  lodepng_row_index_init(index);
+}
+
+/*allocates numcheckpoints zeroed checkpoints in an index that was just initialized*/
+static unsigned row_index_alloc(LodePNGRowIndex* index, size_t numcheckpoints)
+{
+  size_t i;
+  if(numcheckpoints == 0) return 0;
+  if(numcheckpoints > ((size_t)(-1)) / sizeof(LodePNGInflateCheckpoint)) return 77; /*integer overflow*/
+  index->checkpoints = (LodePNGInflateCheckpoint*)lodepng_malloc(numcheckpoints * sizeof(LodePNGInflateCheckpoint));
+  if(!index->checkpoints) return 83; /*alloc fail*/
+  for(i = 0; i != numcheckpoints; ++i)
+  {
+    index->checkpoints[i].bitpos = index->checkpoints[i].outpos = 0;
+    index->checkpoints[i].window = index->checkpoints[i].prevline = 0;
+    index->checkpoints[i].windowsize = 0;
+  }
+  index->numcheckpoints = numcheckpoints;
+  return 0;
+}
+
+/*header checks shared by the partial decoding functions, returns bits per pixel or 0 with state->error set*/
+static unsigned partialDecodeBpp(LodePNGState* state)
+{
+  unsigned bpp = lodepng_get_bpp(&state->info_png.color);
+  if(bpp == 0) state->error = 31; /*error: invalid colortype*/
+  /*rows of an Adam7 image are spread over all 7 passes, so they can't be decoded on their own*/
+  else if(state->info_png.interlace_method != 0) state->error = 94;
+  /*no way to stop or resume a custom decompressor*/
+  else if(state->decoder.zlibsettings.custom_zlib || state->decoder.zlibsettings.custom_inflate) state->error = 95;
+  return state->error ? 0 : bpp;
+}
+
+unsigned lodepng_row_index_build(LodePNGRowIndex* index, LodePNGState* state,
+                                 const unsigned char* in, size_t insize, size_t spacing)
+{
+  unsigned w, h, bpp;
+  size_t linebytes, stride, bp = 0, pos = 0, i, n = 0;
+  ucvector idat, scanlines;
+  unsigned char* image = 0;
+  InflateBlockLog log;
+
+  lodepng_row_index_cleanup(index);
+  ucvector_init(&idat);
+  ucvector_init(&scanlines);
+  InflateBlockLog_init(&log, spacing);
+
+  decodeChunks(&idat, &w, &h, state, in, insize, 1);
+  if(!state->error && (bpp = partialDecodeBpp(state)) != 0)
+  {
+    linebytes = (w * bpp + 7) / 8;
+    stride = linebytes + 1;
+    state->error = zlib_check_header(idat.data, idat.size);
+    if(!state->error && !ucvector_reserve(&scanlines, stride * h)) state->error = 83; /*alloc fail*/
+    if(!state->error)
+    {
+      /*one byte past the prediction is enough to tell the stream is too long*/
+      state->error = inflateRange(&scanlines, idat.data + 2, idat.size - 2, &bp, &pos, stride * h + 1, &log);
+    }
+    if(!state->error && pos != stride * h) state->error = 91; /*decompressed size doesn't match prediction*/
+    if(!state->error)
+    {
+      image = (unsigned char*)lodepng_malloc(linebytes * h);
+      if(!image) state->error = 83; /*alloc fail*/
+    }
+    if(!state->error) state->error = unfilter(image, scanlines.data, w, h, bpp);
+    /*the checkpoint at output position 0 is implicit, it's where decoding without index starts*/
+    if(!state->error) state->error = row_index_alloc(index, log.size);
+    for(i = 0; !state->error && i != log.size; ++i)
+    {
+      LodePNGInflateCheckpoint* cp = &index->checkpoints[n];
+      size_t outpos = log.outpos[i];
+      size_t row = outpos / stride;
+      /*the window must reach back to the start of the row, and 32K for the LZ77 distances*/
+      size_t windowsize = outpos < 32768 ? outpos : 32768;
+      if(outpos - row * stride > windowsize) windowsize = outpos - row * stride;
+      if(row >= h) break;
+
+      cp->bitpos = log.bitpos[i];
+      cp->outpos = outpos;
+      cp->windowsize = windowsize;
+      cp->window = (unsigned char*)lodepng_malloc(windowsize);
+      cp->prevline = (unsigned char*)lodepng_malloc(linebytes);
+      if(!cp->window || !cp->prevline) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      memcpy(cp->window, &scanlines.data[outpos - windowsize], windowsize);
+      if(row > 0) memcpy(cp->prevline, &image[(row - 1) * linebytes], linebytes);
+      else memset(cp->prevline, 0, linebytes);
+      ++n;
+    }
+    if(!state->error)
+    {
+      index->w = w;
+      index->h = h;
+      index->linebytes = linebytes;
+    }
+    /*free the tail that ended up unused, cleanup only looks at numcheckpoints*/
+    for(i = n; i < index->numcheckpoints; ++i)
+    {
+      lodepng_free(index->checkpoints[i].window);
+      lodepng_free(index->checkpoints[i].prevline);
+    }
+    if(index->numcheckpoints > n) index->numcheckpoints = n;
+  }
+
+  lodepng_free(image);
+  InflateBlockLog_cleanup(&log);
+  ucvector_cleanup(&scanlines);
+  ucvector_cleanup(&idat);
+  if(state->error) lodepng_row_index_cleanup(index);
+  return state->error;
+}
+
+/*
+the sidecar format is "LPRI", version, w, h, linebytes, numcheckpoints, then per checkpoint
+bitpos and outpos as 64-bit values, windowsize, the window bytes and linebytes prevline bytes.
+All integers are 32-bit big endian like in PNG.
+*/
+static const unsigned ROW_INDEX_VERSION = 1;
+
+static void row_index_set_size(unsigned char* buffer, size_t value)
+{
+  /*shifting in two steps keeps this defined when size_t is 32-bit*/
+  lodepng_set32bitInt(buffer, (unsigned)((value >> 16) >> 16));
+  lodepng_set32bitInt(buffer + 4, (unsigned)(value & 0xffffffffu));
+}
+
+unsigned lodepng_row_index_encode(unsigned char** out, size_t* outsize, const LodePNGRowIndex* index)
+{
+  size_t size = 24, pos = 24, i;
+  unsigned char* data;
+  for(i = 0; i != index->numcheckpoints; ++i) size += 20 + index->checkpoints[i].windowsize + index->linebytes;
+  data = (unsigned char*)lodepng_malloc(size);
+  if(!data) return 83; /*alloc fail*/
+
+  data[0] = 'L'; data[1] = 'P'; data[2] = 'R'; data[3] = 'I';
+  lodepng_set32bitInt(&data[4], ROW_INDEX_VERSION);
+  lodepng_set32bitInt(&data[8], index->w);
+  lodepng_set32bitInt(&data[12], index->h);
+  lodepng_set32bitInt(&data[16], (unsigned)index->linebytes);
+  lodepng_set32bitInt(&data[20], (unsigned)index->numcheckpoints);
+  for(i = 0; i != index->numcheckpoints; ++i)
+  {
+    const LodePNGInflateCheckpoint* cp = &index->checkpoints[i];
+    row_index_set_size(&data[pos], cp->bitpos);
+    row_index_set_size(&data[pos + 8], cp->outpos);
+    lodepng_set32bitInt(&data[pos + 16], (unsigned)cp->windowsize);
+    pos += 20;
+    memcpy(&data[pos], cp->window, cp->windowsize);
+    pos += cp->windowsize;
+    memcpy(&data[pos], cp->prevline, index->linebytes);
+    pos += index->linebytes;
+  }
+  *out = data;
+  *outsize = size;
+  return 0;
+}
+
+/*reads a 64-bit value written by row_index_set_size, returns 0 if it doesn't fit in size_t*/
+static unsigned row_index_read_size(size_t* value, const unsigned char* in)
+{
+  size_t hi = lodepng_read32bitInt(in);
+  if(sizeof(size_t) < 8 && hi != 0) return 0;
+  *value = ((hi << 16) << 16) | lodepng_read32bitInt(in + 4);
+  return 1;
+}
+
+unsigned lodepng_row_index_decode(LodePNGRowIndex* index, const unsigned char* in, size_t insize)
+{
+  size_t pos = 24, count, i;
+  unsigned error = 0;
+
+  lodepng_row_index_cleanup(index);
+  if(insize < 24 || in[0] != 'L' || in[1] != 'P' || in[2] != 'R' || in[3] != 'I') return 96;
+  if(lodepng_read32bitInt(&in[4]) != ROW_INDEX_VERSION) return 96;
+  index->w = lodepng_read32bitInt(&in[8]);
+  index->h = lodepng_read32bitInt(&in[12]);
+  index->linebytes = lodepng_read32bitInt(&in[16]);
+  count = lodepng_read32bitInt(&in[20]);
+  /*every checkpoint takes at least 20 bytes, don't let a corrupt count allocate more than the file could hold*/
+  if(count > (insize - pos) / 20) error = 96;
+  if(!error) error = row_index_alloc(index, count);
+  for(i = 0; !error && i != count; ++i)
+  {
+    LodePNGInflateCheckpoint* cp = &index->checkpoints[i];
+    if(insize - pos < 20) ERROR_BREAK(96);
+    if(!row_index_read_size(&cp->bitpos, &in[pos]) || !row_index_read_size(&cp->outpos, &in[pos + 8])) ERROR_BREAK(96);
+    cp->windowsize = lodepng_read32bitInt(&in[pos + 16]);
+    pos += 20;
+    if(cp->windowsize > insize - pos || index->linebytes > insize - pos - cp->windowsize) ERROR_BREAK(96);
+    if(cp->windowsize > cp->outpos) ERROR_BREAK(96);
+    cp->window = (unsigned char*)lodepng_malloc(cp->windowsize ? cp->windowsize : 1);
+    cp->prevline = (unsigned char*)lodepng_malloc(index->linebytes ? index->linebytes : 1);
+    if(!cp->window || !cp->prevline) ERROR_BREAK(83 /*alloc fail*/);
+    memcpy(cp->window, &in[pos], cp->windowsize);
+    pos += cp->windowsize;
+    memcpy(cp->prevline, &in[pos], index->linebytes);
+    pos += index->linebytes;
+  }
+  if(error) lodepng_row_index_cleanup(index);
+  return error;
+}
+
+/*rows y0..y1 in the PNG color type, like decodeGeneric but only inflating as far as needed*/
+static void decodeRowsGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                              LodePNGState* state, const unsigned char* in, size_t insize,
+                              unsigned y0, unsigned y1, const LodePNGRowIndex* index)
+{
+  unsigned bpp, y, firstrow = 0;
+  size_t linebytes, stride, bytewidth, base = 0, bp = 0, pos = 0, stoppos, i;
+  ucvector idat, scanlines;
+  const unsigned char* prevline = 0;
+  unsigned char* rows = 0;
+  unsigned char* roll = 0;
+
+  *out = 0;
+  ucvector_init(&idat);
+  ucvector_init(&scanlines);
+
+  decodeChunks(&idat, w, h, state, in, insize, 1);
+  if(state->error || (bpp = partialDecodeBpp(state)) == 0)
+  {
+    ucvector_cleanup(&idat);
+    return;
+  }
+  if(y0 >= y1 || y1 > *h)
+  {
+    ucvector_cleanup(&idat);
+    CERROR_RETURN(state->error, 97);
+  }
+
+  linebytes = (*w * bpp + 7) / 8;
+  stride = linebytes + 1; /*the extra filterbyte added to each row*/
+  bytewidth = (bpp + 7) / 8;
+
+  if(index)
+  {
+    const LodePNGInflateCheckpoint* cp = 0;
+    size_t row = 0;
+    if(index->w != *w || index->h != *h || index->linebytes != linebytes) state->error = 96;
+    /*the last checkpoint at or before the first row we need, the checkpoints are in stream order*/
+    for(i = 0; !state->error && i != index->numcheckpoints; ++i)
+    {
+      if(index->checkpoints[i].outpos / stride > y0) break;
+      cp = &index->checkpoints[i];
+    }
+    if(cp)
+    {
+      row = cp->outpos / stride;
+      if(cp->windowsize > cp->outpos || cp->outpos - row * stride > cp->windowsize) state->error = 96;
+      else if(idat.size < 2 || cp->bitpos / 8 >= idat.size - 2) state->error = 96;
+      else if(!ucvector_resize(&scanlines, cp->windowsize)) state->error = 83; /*alloc fail*/
+    }
+    if(cp && !state->error)
+    {
+      memcpy(scanlines.data, cp->window, cp->windowsize);
+      base = cp->outpos - cp->windowsize;
+      bp = cp->bitpos;
+      pos = cp->windowsize;
+      firstrow = (unsigned)row;
+      prevline = row > 0 ? cp->prevline : 0;
+    }
+  }
+
+  if(!state->error) state->error = zlib_check_header(idat.data, idat.size);
+  stoppos = y1 * stride - base;
+  if(!state->error && !ucvector_reserve(&scanlines, stoppos + 258)) state->error = 83; /*alloc fail*/
+  if(!state->error)
+  {
+    /*stops as soon as the last needed row is complete, the rest of the stream is never touched*/
+    state->error = inflateRange(&scanlines, idat.data + 2, idat.size - 2, &bp, &pos, stoppos, 0);
+    if(!state->error && pos < stoppos) state->error = 91; /*stream ended before the rows we want*/
+  }
+  ucvector_cleanup(&idat);
+
+  if(!state->error)
+  {
+    rows = (unsigned char*)lodepng_malloc((y1 - y0) * linebytes);
+    roll = (unsigned char*)lodepng_malloc(2 * linebytes);
+    if(!rows || !roll) state->error = 83; /*alloc fail*/
+  }
+  for(y = firstrow; !state->error && y < y1; ++y)
+  {
+    /*rows before y0 only serve as precon for the next one, alternate between two lines for them*/
+    unsigned char* recon = y >= y0 ? &rows[(y - y0) * linebytes] : &roll[(y & 1) * linebytes];
+    const unsigned char* scanline = &scanlines.data[y * stride - base];
+    state->error = unfilterScanline(recon, scanline + 1, prevline, bytewidth, scanline[0], linebytes);
+    prevline = recon;
+  }
+  ucvector_cleanup(&scanlines);
+  lodepng_free(roll);
+
+  if(!state->error && bpp < 8 && *w * bpp != linebytes * 8)
+  {
+    size_t outsize = lodepng_get_raw_size(*w, y1 - y0, &state->info_png.color);
+    unsigned char* packed = (unsigned char*)lodepng_malloc(outsize);
+    if(!packed) state->error = 83; /*alloc fail*/
+    else
+    {
+      removePaddingBits(packed, rows, *w * bpp, linebytes * 8, y1 - y0);
+      lodepng_free(rows);
+      rows = packed;
+    }
+  }
+
+  if(state->error) lodepng_free(rows);
+  else *out = rows;
+}
+
+unsigned lodepng_decode_rows(unsigned char** out, unsigned* w, unsigned* h,
+                             LodePNGState* state, const unsigned char* in, size_t insize,
+                             unsigned y0, unsigned y1, const LodePNGRowIndex* index)
+{
+  *out = 0;
+  decodeRowsGeneric(out, w, h, state, in, insize, y0, y1, index);
+  if(state->error) return state->error;
+  return convertDecoded(out, *w, y1 - y0, state);
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
 {
   settings->color_convert = 1;
@@ -4746,6 +5222,8 @@ void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
   settings->remember_unknown_chunks = 0;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
   settings->ignore_crc = 0;
+  settings->max_pixels = 0;
+  settings->max_chunks = 0;
   lodepng_decompress_settings_init(&settings->zlibsettings);
 }
 
@@ -5822,6 +6300,74 @@ void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings)
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_PNG*/
 
+#ifdef LODEPNG_COMPILE_BENCHMARK
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / Benchmark entry points                                                 / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+#if defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_DECODER)
+unsigned lodepng_bench_decode_unchecked(unsigned char** out, unsigned* w, unsigned* h,
+                                        LodePNGState* state,
+                                        const unsigned char* in, size_t insize)
+{
+  *out = 0;
+  decodeGeneric(out, w, h, state, in, insize, 0);
+  if(state->error) return state->error;
+  return convertDecoded(out, *w, *h, state);
+}
+
+unsigned lodepng_bench_unfilter(unsigned char* out, unsigned char* in,
+                                unsigned w, unsigned h, const LodePNGInfo* info_png)
+{
+  return postProcessScanlines(out, in, w, h, info_png);
+}
+#endif /*defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_DECODER)*/
+
+#if defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_ENCODER)
+unsigned lodepng_bench_filter(unsigned char** out, size_t* outsize, const unsigned char* in,
+                              unsigned w, unsigned h,
+                              const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings)
+{
+  return preProcessScanlines(out, outsize, in, w, h, info_png, settings);
+}
+#endif /*defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_ENCODER)*/
+
+#if defined(LODEPNG_COMPILE_ZLIB) && defined(LODEPNG_COMPILE_ENCODER)
+unsigned lodepng_bench_lz77(size_t* numsymbols, const unsigned char* in, size_t insize,
+                            const LodePNGCompressSettings* settings)
+{
+  /*same block split and shared hash table as the dynamic tree path of deflate, minus the huffman coding*/
+  unsigned error = 0;
+  size_t blocksize, start;
+  Hash hash;
+  uivector lz77_encoded;
+
+  *numsymbols = 0;
+  blocksize = insize / 8 + 8;
+  if(blocksize < 65536) blocksize = 65536;
+  if(blocksize > 262144) blocksize = 262144;
+
+  error = hash_init(&hash, settings->windowsize);
+  if(error) return error;
+
+  uivector_init(&lz77_encoded);
+  for(start = 0; start < insize && !error; start += blocksize)
+  {
+    size_t end = start + blocksize;
+    if(end > insize) end = insize;
+    lz77_encoded.size = 0;
+    error = encodeLZ77(&lz77_encoded, &hash, in, start, end, settings->windowsize,
+                       settings->minmatch, settings->nicematch, settings->lazymatching);
+    *numsymbols += lz77_encoded.size;
+  }
+  uivector_cleanup(&lz77_encoded);
+  hash_cleanup(&hash);
+
+  return error;
+}
+#endif /*defined(LODEPNG_COMPILE_ZLIB) && defined(LODEPNG_COMPILE_ENCODER)*/
+#endif /*LODEPNG_COMPILE_BENCHMARK*/
+
 #ifdef LODEPNG_COMPILE_ERROR_TEXT
 /*
 This returns the description of a numerical error code in English. This is also
@@ -5923,6 +6469,13 @@ const char* lodepng_error_text(unsigned code)
     case 91: return "invalid decompressed idat size";
     case 92: return "too many pixels, not supported";
     case 93: return "zero width or height is invalid";
+    case 94: return "partial decoding needs a non-interlaced PNG";
+    case 95: return "partial decoding can't be combined with a custom zlib or inflate function";
+    case 96: return "row index is corrupt or doesn't belong to this PNG";
+    case 97: return "invalid row range given for partial decoding";
+    case 98: return "decompressed data is larger than the configured max_output_size";
+    case 99: return "image has more pixels than the configured max_pixels";
+    case 100: return "PNG has more chunks than the configured max_chunks";
   }
   return "unknown error code";
 }
@@ -6084,6 +6637,64 @@ unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
   return decode(out, w, h, state, in.empty() ? 0 : &in[0], in.size());
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+RowIndex::RowIndex()
+{
+  lodepng_row_index_init(this);
+}
+
+RowIndex::~RowIndex()
+{
+  lodepng_row_index_cleanup(this);
+}
+
+unsigned decode_rows(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+                     State& state, const std::vector<unsigned char>& in,
+                     unsigned y0, unsigned y1, const LodePNGRowIndex* index)
+{
+  unsigned char* buffer = 0;
+  unsigned error = lodepng_decode_rows(&buffer, &w, &h, &state, in.empty() ? 0 : &in[0], in.size(), y0, y1, index);
+  if(buffer && !error)
+  {
+    size_t buffersize = lodepng_get_raw_size(w, y1 - y0, &state.info_raw);
+    out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+  }
+  lodepng_free(buffer);
+  return error;
+}
+
+unsigned decode_rows(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+                     const std::vector<unsigned char>& in, unsigned y0, unsigned y1,
+                     const LodePNGRowIndex* index, LodePNGColorType colortype, unsigned bitdepth)
+{
+  State state;
+  state.info_raw.colortype = colortype;
+  state.info_raw.bitdepth = bitdepth;
+  return decode_rows(out, w, h, state, in, y0, y1, index);
+}
+
+unsigned build_row_index(RowIndex& index, const std::vector<unsigned char>& in, size_t spacing)
+{
+  State state;
+  return lodepng_row_index_build(&index, &state, in.empty() ? 0 : &in[0], in.size(), spacing);
+}
+
+unsigned encode_row_index(std::vector<unsigned char>& out, const RowIndex& index)
+{
+  unsigned char* buffer = 0;
+  size_t buffersize = 0;
+  unsigned error = lodepng_row_index_encode(&buffer, &buffersize, &index);
+  if(buffer && !error) out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+  lodepng_free(buffer);
+  return error;
+}
+
+unsigned decode_row_index(RowIndex& index, const std::vector<unsigned char>& in)
+{
+  return lodepng_row_index_decode(&index, in.empty() ? 0 : &in[0], in.size());
+}
+#endif /* LODEPNG_COMPILE_ZLIB */
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const std::string& filename,
                 LodePNGColorType colortype, unsigned bitdepth)
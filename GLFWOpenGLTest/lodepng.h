@@ -79,6 +79,8 @@ source files with custom allocators.*/
 #ifndef LODEPNG_NO_COMPILE_ALLOCATORS
 #define LODEPNG_COMPILE_ALLOCATORS
 #endif
+/*entry points to single internal stages of the codec for benchmarking. Off by default, so
+there is no LODEPNG_NO_COMPILE_BENCHMARK; define LODEPNG_COMPILE_BENCHMARK to enable them.*/
 /*compile the C++ version (you can disable the C++ wrapper here even when compiling for C++)*/
 #ifdef __cplusplus
 #ifndef LODEPNG_NO_COMPILE_CPP
@@ -256,6 +258,9 @@ typedef struct LodePNGDecompressSettings LodePNGDecompressSettings;
 struct LodePNGDecompressSettings
 {
   unsigned ignore_adler32; /*if 1, continue and don't give an error message if the Adler32 checksum is corrupted*/
+  /*if not 0, fail with error 98 as soon as the decompressed output would grow past this many bytes.
+  Protects against small hostile inputs that inflate to gigabytes. Default: 0, no limit*/
+  size_t max_output_size;
 
   /*use custom zlib decoder instead of built in one (default: null)*/
   unsigned (*custom_zlib)(unsigned char**, size_t*,
@@ -522,6 +527,15 @@ typedef struct LodePNGDecoderSettings
 
   unsigned ignore_crc; /*ignore CRC checksums*/
 
+  /*
+  Limits for decoding untrusted PNGs, 0 means no limit (the default). The size limits are
+  checked as soon as the header is read, before any image data is inflated or allocated.
+  The size of the decompressed image data, as computed from the header, is limited by
+  zlibsettings.max_output_size, which also limits compressed text chunks.
+  */
+  size_t max_pixels; /*fail with error 99 if width * height is larger than this*/
+  unsigned max_chunks; /*fail with error 100 if the PNG has more chunks than this, IHDR and IEND included*/
+
   unsigned color_convert; /*whether to convert the PNG to the color type you want. Default: yes*/
 
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
@@ -659,6 +673,57 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/*
+A place in the IDAT stream of a non-interlaced PNG where inflating can resume without
+decoding anything before it. Always at the start of a deflate block.
+*/
+typedef struct LodePNGInflateCheckpoint
+{
+  size_t bitpos; /*bit offset of the block in the deflate data (after the 2 byte zlib header)*/
+  size_t outpos; /*offset in the decompressed, still filtered, scanlines that bitpos decodes to*/
+  /*the windowsize decompressed bytes before outpos: the LZ77 window, and at least the start of the current row*/
+  unsigned char* window;
+  size_t windowsize;
+  unsigned char* prevline; /*the unfiltered row before the row outpos is in, linebytes long*/
+} LodePNGInflateCheckpoint;
+
+/*Checkpoints for one PNG image, ordered by outpos. Can be stored next to the PNG as a sidecar file.*/
+typedef struct LodePNGRowIndex
+{
+  unsigned w, h; /*dimensions of the image it belongs to*/
+  size_t linebytes; /*bytes per unfiltered row, excluding the filter type byte*/
+  LodePNGInflateCheckpoint* checkpoints;
+  size_t numcheckpoints;
+} LodePNGRowIndex;
+
+void lodepng_row_index_init(LodePNGRowIndex* index);
+void lodepng_row_index_cleanup(LodePNGRowIndex* index);
+
+/*
+Decodes the whole image once and records a checkpoint at deflate block boundaries at
+least spacing decompressed bytes apart (each one costs up to 32K of memory).
+*/
+unsigned lodepng_row_index_build(LodePNGRowIndex* index, LodePNGState* state,
+                                 const unsigned char* in, size_t insize, size_t spacing);
+
+/*Serializes the index to a buffer allocated with lodepng_malloc, e.g. to save as sidecar file.*/
+unsigned lodepng_row_index_encode(unsigned char** out, size_t* outsize, const LodePNGRowIndex* index);
+/*Reads an index serialized with lodepng_row_index_encode. index must be initialized.*/
+unsigned lodepng_row_index_decode(LodePNGRowIndex* index, const unsigned char* in, size_t insize);
+
+/*
+Decodes only the rows y0 (inclusive) to y1 (exclusive) of a non-interlaced PNG. Inflating
+stops as soon as row y1 - 1 is complete, so the cost grows with y1, unless index is given:
+then it starts from the last checkpoint before y0. index may be NULL.
+*w and *h are set to the dimensions of the full image, out contains w * (y1 - y0) pixels
+in the color type of state->info_raw. The Adler32 checksum is not checked, the chunk CRCs are.
+*/
+unsigned lodepng_decode_rows(unsigned char** out, unsigned* w, unsigned* h,
+                             LodePNGState* state, const unsigned char* in, size_t insize,
+                             unsigned y0, unsigned y1, const LodePNGRowIndex* index);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 
@@ -812,6 +877,50 @@ return value: error code (0 means ok)
 unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const char* filename);
 #endif /*LODEPNG_COMPILE_DISK*/
 
+#ifdef LODEPNG_COMPILE_BENCHMARK
+/*
+Single stages of the codec, exposed so they can be timed on their own. These are not
+part of the regular API, they only exist when LODEPNG_COMPILE_BENCHMARK is defined.
+*/
+#if defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_DECODER)
+/*
+Same as lodepng_decode, but without any decoder limit: max_pixels, max_chunks and max_output_size
+of state are ignored, and so is the cap at the predicted IDAT size. Unsafe on untrusted input, this
+only exists to time what the limits cost.
+*/
+unsigned lodepng_bench_decode_unchecked(unsigned char** out, unsigned* w, unsigned* h,
+                                        LodePNGState* state,
+                                        const unsigned char* in, size_t insize);
+
+/*
+Unfilters the inflated scanlines of an image described by info_png into out, and
+deinterlaces them if the image is Adam7 interlaced. out must have room for the raw image.
+NOTE: the in buffer is overwritten with intermediate data.
+*/
+unsigned lodepng_bench_unfilter(unsigned char* out, unsigned char* in,
+                                unsigned w, unsigned h, const LodePNGInfo* info_png);
+#endif /*defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_DECODER)*/
+
+#if defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_ENCODER)
+/*
+Filters (and interlaces, if info_png says so) raw pixels in the color type of
+info_png into the scanlines that the encoder would deflate. out is allocated.
+*/
+unsigned lodepng_bench_filter(unsigned char** out, size_t* outsize, const unsigned char* in,
+                              unsigned w, unsigned h,
+                              const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings);
+#endif /*defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_ENCODER)*/
+
+#if defined(LODEPNG_COMPILE_ZLIB) && defined(LODEPNG_COMPILE_ENCODER)
+/*
+Runs the LZ77 match finder of deflate over in, without the huffman coding.
+numsymbols: receives the amount of LZ77 output values, as a sanity check.
+*/
+unsigned lodepng_bench_lz77(size_t* numsymbols, const unsigned char* in, size_t insize,
+                            const LodePNGCompressSettings* settings);
+#endif /*defined(LODEPNG_COMPILE_ZLIB) && defined(LODEPNG_COMPILE_ENCODER)*/
+#endif /*LODEPNG_COMPILE_BENCHMARK*/
+
 #ifdef LODEPNG_COMPILE_CPP
 /* The LodePNG C++ wrapper uses std::vectors instead of manually allocated memory buffers. */
 namespace lodepng
@@ -834,6 +943,33 @@ unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
 unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
                 State& state,
                 const std::vector<unsigned char>& in);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/* LodePNGRowIndex that cleans up after itself. */
+class RowIndex : public LodePNGRowIndex
+{
+  public:
+    RowIndex();
+    ~RowIndex();
+  private:
+    RowIndex(const RowIndex& other); /*not copyable*/
+    RowIndex& operator=(const RowIndex& other);
+};
+
+/* Same as lodepng_decode_rows, appending the w * (y1 - y0) decoded pixels to out. */
+unsigned decode_rows(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+                     State& state, const std::vector<unsigned char>& in,
+                     unsigned y0, unsigned y1, const LodePNGRowIndex* index = 0);
+unsigned decode_rows(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+                     const std::vector<unsigned char>& in, unsigned y0, unsigned y1,
+                     const LodePNGRowIndex* index = 0,
+                     LodePNGColorType colortype = LCT_RGBA, unsigned bitdepth = 8);
+
+/* Builds, serializes and deserializes the checkpoint index used by decode_rows. */
+unsigned build_row_index(RowIndex& index, const std::vector<unsigned char>& in, size_t spacing = 262144);
+unsigned encode_row_index(std::vector<unsigned char>& out, const RowIndex& index);
+unsigned decode_row_index(RowIndex& index, const std::vector<unsigned char>& in);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -892,7 +1028,7 @@ TODO:
 [X] converting color to 16-bit per channel types
 [ ] read all public PNG chunk types (but never let the color profile and gamma ones touch RGB values)
 [ ] make sure encoder generates no chunks with size > (2^31)-1
-[ ] partial decoding (stream processing)
+[.] partial decoding (stream processing) - row ranges via lodepng_decode_rows, no streaming input yet
 [X] let the "isFullyOpaque" function check color keys and transparent palettes too
 [X] better name for the variables "codes", "codesD", "codelengthcodes", "clcl" and "lldl"
 [ ] don't stop decoding on errors like 69, 57, 58 (make warnings)
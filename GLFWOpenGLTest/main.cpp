@@ -1,6 +1,8 @@
 // VS 2015 includes
 #include <iostream>
 #include <vector>
+#include <sstream>
+#include <cstring>
 #include <cmath>
 // GLEW (NOTICE: GLEW MUST BE ALWAYS INCLUDED BEFORE GLFW)
 #define GLEW_STATIC
@@ -17,24 +19,62 @@
 
 // Project includes
 #include "Shader.h"
+#include "ShaderLibrary.h"
+#include "ShaderWatcher.h"
 #include "Camera.h"
+#include "TextureCache.h"
+#include "TextureAtlas.h"
+#include "TextureManager.h"
+#include "JobSystem.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "MeshArena.h"
+#include "StreamBuffer.h"
+#include "FrameUniforms.h"
+#include "Frustum.h"
+#include "Bvh.h"
+#include "OcclusionBuffer.h"
+#include "LightClusters.h"
+#include "TextureBuffer.h"
+#include "GpuTimer.h"
+#include "GBuffer.h"
+#include "Transforms.h"
 
 // Window dimensions
 const GLuint screenWidth = 1280, screenHeight = 720;
+// GPU memory the textures may take, mips included
+const size_t textureBudget = 64 * 1024 * 1024;
+// Objects a worker records the draws of at a time
+const size_t recordGrain = 256;
 // Functions
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void do_movement();
+Texture_Format pick_texture_format(bool alpha);
 
 // Camera
 GLfloat lastX = screenWidth / 2.0, lastY = screenHeight / 2.0;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 bool keys[1024];
 bool firstMouse = true;
+// Set by a left click, the next frame picks the box under the middle of the screen
+bool pickRequested = false;
 
 // Position of the light/lamp
 glm::vec3 lightPos(1.2f, 0.5f, 1.0f);
+// Point lights of the scene, with a lamp each
+const GLuint pointLightCount = 4;
+// Small coloured lights floating around the boxes, switched on and off with L
+const GLuint swarmLightCount = 2048;
+bool swarmLights = false;
+// The most lights a frame draws with, the ones covering the most of the view. K turns the limit off and on
+const GLuint lightBudget = 256;
+bool lightBudgetOn = true;
+// G switches between lighting every box fragment with its cluster's lights and the deferred path, surfaces into a
+// G-buffer first and then lit by a volume drawn for every light
+bool deferredShading = false;
 
 // Deltatime
 GLfloat deltaTime = 0.0f;
@@ -66,6 +106,7 @@ int main()
 	glfwSetKeyCallback(window, key_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
 	
 	// GLFW Options
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -89,20 +130,42 @@ int main()
 	//Setup OpenGL options
 	glEnable(GL_DEPTH_TEST);
 
-	// Build and compile our shader program
-	Shader ourShader("VertexShader.txt", "FragmentShader.txt");
-	Shader lampShader("LampVertexShader.txt", "LampFragmentShader.txt");
+	// Every bind and uniform of the frame goes through the state, which only calls GL for what changed
+	GLState glState;
+	// Build and compile our shader program, or restore it from the binary the last run left in the shader cache
+	ShaderCache shaderCache;
+	// The tiny unlit lamp program is built right away; the lit one compiles while the textures load and the
+	// first frames run, drawing the cubes unlit with the lamp program until it is ready
+	double shaderStart = glfwGetTime();
+	Shader lampShader("LampVertexShader.txt", "LampFragmentShader.txt", &shaderCache);
+	lampShader.State = &glState;
+	ShaderLibrary shaders(&shaderCache);
+	shaders.State = &glState;
+	Shader& ourShader = shaders.Add("VertexShader.txt", "FragmentShader.txt",
+		ShaderDefines().Set("SPECULAR_MAP", 1), &lampShader);
+	bool shadersReady = false;
+	// Saving a shader file rebuilds it while the program runs
+	ShaderWatcher shaderWatcher(shaders);
+	shaderWatcher.Watch(ourShader);
+	shaderWatcher.Watch(lampShader);
+	// The passes of the deferred path, used once they are all built
+	Shader& gbufferShader = shaders.Add("VertexShader.txt", "GBufferFragmentShader.txt", ShaderDefines().Set("SPECULAR_MAP", 1));
+	Shader& lightVolumeShader = shaders.Add("LightVolumeVertexShader.txt", "LightVolumeFragmentShader.txt");
+	Shader& compositeShader = shaders.Add("FullscreenVertexShader.txt", "CompositeFragmentShader.txt");
+	shaderWatcher.Watch(gbufferShader);
+	shaderWatcher.Watch(lightVolumeShader);
+	shaderWatcher.Watch(compositeShader);
 	
 
 	// Set up vertex data (and buffer(s)) and attribute pointers
 	GLfloat vertices[] = {
 		// Positions          // Normals          // Texture Coords
 		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
 		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
 		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
 		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
 
 		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
 		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
@@ -119,11 +182,11 @@ int main()
 		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f, 0.0f,   1.0f, 0.0f,
 
 		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f, 0.0f,   1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f, 0.0f,   1.0f, 1.0f,
 		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f, 0.0f,   0.0f, 1.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f, 0.0f,   1.0f, 1.0f,
 		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f, 0.0f,   0.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f, 0.0f,   0.0f, 0.0f,
 		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f, 0.0f,   1.0f, 0.0f,
+		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f, 0.0f,   0.0f, 0.0f,
 
 		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f, 0.0f,   0.0f, 1.0f,
 		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f, 0.0f,   1.0f, 1.0f,
@@ -133,11 +196,11 @@ int main()
 		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f, 0.0f,   0.0f, 1.0f,
 
 		-0.5f, 0.5f, -0.5f,   0.0f,  1.0f, 0.0f,   0.0f, 1.0f,
-		 0.5f, 0.5f, -0.5f,   0.0f,  1.0f, 0.0f,   1.0f, 1.0f,
 		 0.5f, 0.5f,  0.5f,   0.0f,  1.0f, 0.0f,   1.0f, 0.0f,
+		 0.5f, 0.5f, -0.5f,   0.0f,  1.0f, 0.0f,   1.0f, 1.0f,
 		 0.5f, 0.5f,  0.5f,   0.0f,  1.0f, 0.0f,   1.0f, 0.0f,
-		-0.5f, 0.5f,  0.5f,   0.0f,  1.0f, 0.0f,   0.0f, 0.0f,
-		-0.5f, 0.5f, -0.5f,   0.0f,  1.0f, 0.0f,   0.0f, 1.0f
+		-0.5f, 0.5f, -0.5f,   0.0f,  1.0f, 0.0f,   0.0f, 1.0f,
+		-0.5f, 0.5f,  0.5f,   0.0f,  1.0f, 0.0f,   0.0f, 0.0f
 	};
 	GLuint indices[] = {
 		0, 1, 3,	// First Triangle
@@ -170,49 +233,6 @@ int main()
 		glm::vec3(0.0f, 9.0f, -20.0f)
 	};
 
-	GLfloat lightVertices[] = {
-		-0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, -0.5f,
-		0.5f, 0.5f, -0.5f,
-		0.5f, 0.5f, -0.5f,
-		-0.5f, 0.5f, -0.5f,
-		-0.5f, -0.5f, -0.5f,
-
-		-0.5f, -0.5f, 0.5f,
-		0.5f, -0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-		-0.5f, 0.5f, 0.5f,
-		-0.5f, -0.5f, 0.5f,
-
-		-0.5f, 0.5f, 0.5f,
-		-0.5f, 0.5f, -0.5f,
-		-0.5f, -0.5f, -0.5f,
-		-0.5f, -0.5f, -0.5f,
-		-0.5f, -0.5f, 0.5f,
-		-0.5f, 0.5f, 0.5f,
-
-		0.5f, 0.5f, 0.5f,
-		0.5f, 0.5f, -0.5f,
-		0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-
-		-0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, 0.5f,
-		0.5f, -0.5f, 0.5f,
-		-0.5f, -0.5f, 0.5f,
-		-0.5f, -0.5f, -0.5f,
-
-		-0.5f, 0.5f, -0.5f,
-		0.5f, 0.5f, -0.5f,
-		0.5f, 0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-		-0.5f, 0.5f, 0.5f,
-		-0.5f, 0.5f, -0.5f
-	};
 	glm::vec3 pointLightPositions[] =
 	{
 		glm::vec3( 0.7f, 0.2f, 2.0f),
@@ -258,72 +278,111 @@ int main()
 	glBindBuffer(GL_ARRAY_BUFFER, 0); // Note that this is allowed, the call to glVertexAttribPointer registered VBO as the currently bound vertex buffer object so afterwards we can safely unbind
 	glBindVertexArray(0);
 
-	//-------------------------------------------------------------------
-	// LIGHTNING
-	GLuint lightVAO, lightVBO;
-	glGenVertexArrays(1, &lightVAO);
-	glGenBuffers(1, &lightVBO);
-	glBindVertexArray(lightVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
-	
-	glBufferData(GL_ARRAY_BUFFER, sizeof(lightVertices), lightVertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	glBindVertexArray(0); // Unbind VAO (it's always a good thing to unbind any buffer/array to prevent strange bugs)
+	// Adding textures, decoded and mipmapped once and then mapped straight from the texture cache on later runs
+	// Block compression of the first run spreads over all cores
+	JobSystem jobs;
+	TextureCache textureCache;
+	textureCache.Jobs = &jobs;
+	BakedTexture baked;
+	TextureManager textures(textureCache, textureBudget);
+	textures.State = &glState;
+	// The camera and lights of a frame go to the shaders as one uniform block, written straight into a mapped ring
+	// of frame regions instead of a uniform call each
+	const GLuint frameBinding = 0;
+	StreamBuffer streamBuffer(glState, 64 * 1024);
+	std::cout << "Stream buffer: " << (streamBuffer.Persistent ? "persistently mapped" : "mapped every frame, no GL_ARB_buffer_storage") << std::endl;
+	// The draws of a frame, recorded on the workers and sorted before any of them is made
+	RenderQueue renderQueue;
+	CommandRecorder recorder(jobs);
+
+	// The lamps never move, they are baked into a mesh arena where they stand and drawn by one indirect draw
+	MeshArena staticMeshes;
+	std::vector<MeshRange> lampMeshes;
+	for (GLuint i = 0; i < pointLightCount; i++)
+	{
+		glm::mat4 model;
+		model = glm::translate(model, pointLightPositions2[i]);
+		model = glm::scale(model, glm::vec3(0.2f));
+		lampMeshes.push_back(staticMeshes.Add(vertices, 36, 0, 0, model));
+	}
+	// The boxes spin, their boxes in the hierarchy are refitted every frame. Inserted in order, so proxy i is box i
+	const GLuint boxCount = 10;
+	const Aabb unitCube(glm::vec3(-0.5f), glm::vec3(0.5f));
+	Bvh boxTree;
+	for (GLuint i = 0; i < boxCount; i++)
+		boxTree.Insert(Aabb(cubePositions2[i] - 0.5f, cubePositions2[i] + 0.5f));
+	glm::mat4 boxModels[boxCount];
+	// Where they stand and the axes they spin about, made into their model matrices in SIMD batches every frame
+	TransformArrays boxTransforms;
+	AxisAngleArrays boxSpins;
+	for (GLuint i = 0; i < boxCount; i++)
+	{
+		boxTransforms.Add(cubePositions2[i]);
+		boxSpins.Add(glm::vec3(1.0f, 0.3f, 0.5f), 0.0f);
+	}
+	// The lamps stand still, bounding spheres around the cubes they are made of
+	const GLfloat cubeRadius = 0.5f * glm::sqrt(3.0f);
+	SphereBounds lampBounds;
+	for (GLuint i = 0; i < pointLightCount; i++)
+		lampBounds.Add(pointLightPositions2[i], 0.2f * cubeRadius);
+	std::vector<unsigned> visibleBoxes, visibleLamps;
+	std::cout << "Frustum culling: " << GetCullingInstructions() << ", transforms: " << GetTransformInstructions() << std::endl;
+	// The boxes in view hide what is behind them, drawn into a small depth buffer on the workers
+	OcclusionBuffer occlusion(jobs);
+	double occlusionTime = 0.0;
+	// The point lights go to the clusters of the view they reach, a fragment only lights with those of its cluster.
+	// The lights and lists are buffer textures on units 1 to 3, after the atlas
+	LightClusters lightClusters(jobs);
+	TextureBuffer clusterLights(glState, GL_RGBA32F), clusterGrid(glState, GL_RG32UI), clusterIndices(glState, GL_R32UI);
+	const GLuint clusterUnit = 1, clusterTextureCount = 3;
+	double clusterTime = 0.0;
+	// What the lit boxes cost on the GPU, where fewer lights per fragment show
+	GpuTimer litTimer;
+	// The deferred path's targets, read on the units after the cluster buffers, and what each of its passes costs
+	GBuffer gBuffer(glState, screenWidth, screenHeight);
+	const GLuint gBufferUnit = clusterUnit + clusterTextureCount;
+	GpuTimer geometryTimer, lightVolumeTimer, compositeTimer;
+	std::vector<glm::vec3> swarmPositions(swarmLightCount), swarmColors(swarmLightCount);
+	for (GLuint i = 0; i < swarmLightCount; i++)
+	{
+		// Spread over the boxes by a fixed sequence, a hue each
+		GLfloat u = glm::fract(i * 0.618034f), v = glm::fract(i * 0.754878f), w = glm::fract(i * 0.569840f);
+		swarmPositions[i] = glm::vec3(-6.0f + 12.0f * u, -4.0f + 10.0f * v, -16.0f + 18.0f * w);
+		swarmColors[i] = glm::clamp(glm::abs(glm::fract(glm::vec3(u) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+	}
+	std::cout << "Light clusters: " << lightClusters.GetClusterCount() << ", press L for " << swarmLightCount << " more lights, K to turn the limit of "
+		<< lightBudget << " lights off and on, G for deferred shading" << std::endl;
+	staticMeshes.Upload(glState);
+	IndirectBatch staticBatch;
+	std::cout << "Static meshes: " << lampMeshes.size() << " in " << staticMeshes.GetVertexCount() << " vertices, drawn "
+		<< (staticBatch.Indirect ? "by glMultiDrawElementsIndirect" : "by a glDrawElements loop, no GL_ARB_multi_draw_indirect") << std::endl;
+	double stateTitleTime = glfwGetTime();
+	double textureStart = glfwGetTime();
 
-	// Adding textures
-	std::vector<unsigned char> png, pixels;
-	
-	GLuint width, height;
 	GLuint texture;
 	GLuint texture2;
 
-	GLuint diffuseMap;
-
-	glGenTextures(1, &diffuseMap);
-	glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-	// Set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// Set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Loading the image, creating a texture and generate mipmaps
-	lodepng::load_file(png, "woodbox.png");
-	lodepng::decode(pixels, width, height, png.data(), png.size());
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	// Second texture
-	png.clear();
-	pixels.clear();
-
-	GLuint specularMap;
-
-	glGenTextures(1, &specularMap);
-	glBindTexture(GL_TEXTURE_2D, specularMap);
-
-	//// Set our texture parameters
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	//// Set texture filtering
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	lodepng::load_file(png, "smiley.png");
-	lodepng::decode(pixels, width, height, png.data(), png.size());
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// Every map goes into one texture atlas, so all materials draw with a single texture bind. Only level 0 is
+	// needed from the cache, the pages get their own mips once the images are padded
+	TextureAtlas atlas;
+	const char* textureFiles[] = { "woodbox.png", "smiley.png" };
+	for (int i = 0; i < 2; i++)
+	{
+		if (textureCache.Load(baked, textureFiles[i], TextureSettings(false, MIP_BOX, true, false, TEXTURE_RGBA8)))
+			atlas.Add(textureFiles[i], baked.Levels[0].Data, baked.Levels[0].Width, baked.Levels[0].Height);
+	}
+	baked.Release();
+	if (!atlas.Pack())
+		std::cout << "ERROR::TEXTURE::ATLAS_TEXTURE_TOO_LARGE" << std::endl;
+	TextureHandle atlasMap = textures.AddAtlas(atlas, pick_texture_format(false));
+	textures.Get(atlasMap);
+	const AtlasEntry* diffuseEntry = atlas.Find("woodbox.png");
+	const AtlasEntry* specularEntry = atlas.Find("smiley.png");
+
+	std::cout << "Textures loaded in " << (glfwGetTime() - textureStart) * 1000.0 << " ms, " << textureCache.Hits << " from the cache" << std::endl;
+	std::cout << "Texture atlas: " << atlas.Entries.size() << " textures on " << atlas.Pages.size() << " page(s) of "
+		<< atlas.PageWidth << "x" << atlas.PageHeight << ", " << atlas.GetEfficiency() * 100.0 << "% used, texture binds per frame "
+		<< atlas.Entries.size() << " -> " << (atlas.Pages.empty() ? 0 : 1) << std::endl;
 
 	// Game loop
 	while (!glfwWindowShouldClose(window))
@@ -337,67 +396,49 @@ int main()
 		glfwPollEvents();
 		do_movement();
 
+		// Rebuild the shaders saved since the last frame and swap in the programs the driver finished
+		shaderWatcher.Update();
+		if (shaders.Poll() == 0 && !shadersReady)
+		{
+			shadersReady = true;
+			std::cout << "Shaders ready " << (glfwGetTime() - shaderStart) * 1000.0 << " ms after submitting (submit "
+				<< lampShader.CompileTime + shaders.SubmitTime << " ms, waited " << lampShader.LinkTime + shaders.WaitTime << " ms, "
+				<< (shaders.Parallel ? "parallel" : "serial") << " compile), " << shaderCache.Hits << " from the cache"
+				<< (shaderCache.IsSupported() ? "" : ", program binaries not supported") << std::endl;
+		}
+
 		// Render
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Load shaders
-		ourShader.Use();
+		glState.BeginFrame();
 		
-		// Binding texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuseMap);
-		glUniform1i(glGetUniformLocation(ourShader.Program, "material.diffuse"), 0);
-
-		//.... texture2
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, specularMap);
-		glUniform1i(glGetUniformLocation(ourShader.Program, "material.specular"), 1);
+		// The atlas, the one texture every material samples from. Loaded again if it was evicted
+		textures.BeginFrame();
+		GLuint atlasTexture = textures.Get(atlasMap);
+		// The deferred path once its passes are built, else the forward one
+		bool deferred = deferredShading && shadersReady && gBuffer.IsComplete();
+		Shader& boxShader = deferred ? gbufferShader : ourShader;
+		glState.UseProgram(boxShader);
+		glState.Uniform1i("material.atlas", 0);
+
+		// Where the maps of the material are in it
+		if (diffuseEntry)
+		{
+			glState.Uniform4fv("material.diffuseRect", glm::value_ptr(diffuseEntry->UvRect));
+			glState.Uniform1f("material.diffuseLayer", (GLfloat)diffuseEntry->Page);
+		}
+		if (specularEntry)
+		{
+			glState.Uniform4fv("material.specularRect", glm::value_ptr(specularEntry->UvRect));
+			glState.Uniform1f("material.specularLayer", (GLfloat)specularEntry->Page);
+		}
 		
 		//View position
-		glUniform3f(glGetUniformLocation(ourShader.Program, "viewPos"), camera.Position.x, camera.Position.y, camera.Position.z);
 		// Material properties
-		glUniform1f(glGetUniformLocation(ourShader.Program, "material.shininess"), 32.0f);
-
-		// Directional light
-		glUniform3f(glGetUniformLocation(ourShader.Program, "dirLight.direction"), -0.2f, -1.0f, -0.3f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "dirLight.ambient"), 0.05f, 0.05f, 0.05f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "dirLight.diffuse"), 0.4f, 0.4f, 0.4f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "dirLight.specular"), 0.5f, 0.5f, 0.5f);
-		
-		// Light materials
-		glUniform3f(glGetUniformLocation(ourShader.Program, "light.ambient"), 0.1f, 0.1f, 0.1f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "light.diffuse"), 0.8f, 0.8f, 0.8f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "light.specular"), 1.0f, 1.0f, 1.0f);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "light.constant"), 1.0f);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "light.linear"), 0.09);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "light.quadratic"), 0.032);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "material.shininess"), 32.0f);
-
-		// 4 point lights
-		for (GLuint i = 0; i < 4; i++)
-		{
-			std::string number = std::to_string(i);
-
-			glUniform3f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].position").c_str()), pointLightPositions[i].x, pointLightPositions[i].y, pointLightPositions[i].z);
-			glUniform3f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].ambient").c_str()), 0.05f, 0.05f, 0.05f);
-			glUniform3f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].diffuse").c_str()), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].specular").c_str()), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].constant").c_str()), 1.0f);
-			glUniform1f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].linear").c_str()), 0.09f);
-			glUniform1f(glGetUniformLocation(ourShader.Program, ("pointLights[" + number + "].quadratic").c_str()), 0.032f);
-		}
-		// SpotLight
-		glUniform3f(glGetUniformLocation(ourShader.Program, "spotLight.position"), camera.Position.x, camera.Position.y, camera.Position.z);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "spotLight.direction"), camera.Front.x, camera.Front.y, camera.Front.z);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "spotLight.ambient"), 0.0f, 0.0f, 0.0f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "spotLight.diffuse"), 1.0f, 1.0f, 1.0f);
-		glUniform3f(glGetUniformLocation(ourShader.Program, "spotLight.specular"), 1.0f, 1.0f, 1.0f);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "spotLight.constant"), 1.0f);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "spotLight.linear"), 0.09);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "spotLight.quadratic"), 0.032);
-		glUniform1f(glGetUniformLocation(ourShader.Program, "spotLight.cutOff"), glm::cos(glm::radians(12.5f)));
-		glUniform1f(glGetUniformLocation(ourShader.Program, "spotLight.outerCutOff"), glm::cos(glm::radians(15.0f)));
+		const GLfloat shininess = 32.0f;
+		glState.Uniform1f("material.shininess", shininess);
 
 		// Camera/View Transformations
 		glm::mat4 view;
@@ -407,61 +448,283 @@ int main()
 		glm::mat4 projection;
 		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)screenWidth / (GLfloat)screenHeight, 0.1f, 100.0f);
 
-		// Get their uniform locations
-		GLint modelLoc = glGetUniformLocation(ourShader.Program, "model");
-		GLint viewLoc = glGetUniformLocation(ourShader.Program, "view");
-		GLint projectionLoc = glGetUniformLocation(ourShader.Program, "projection");
-		
-		// Passing them to shaders
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-		
-		// Draw box
-		glBindVertexArray(VAO);
-		glm::mat4 model;
-		//glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-		//glDrawArrays(GL_TRIANGLES, 0, 36);
-		//glBindVertexArray(0);
-
-		for (GLuint i = 0; i < 10; i++)
+		// The point lights by cluster, the scene's 4 and the swarm bobbing around the boxes
+		double clusterStart = glfwGetTime();
+		lightClusters.Clear();
+		for (GLuint i = 0; i < pointLightCount; i++)
+			lightClusters.AddPointLight(pointLightPositions[i], glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f);
+		for (GLuint i = 0; swarmLights && i < swarmLightCount; i++)
+		{
+			glm::vec3 position = swarmPositions[i] + glm::vec3(0.0f, 0.5f * glm::sin(currentFrame + i), 0.0f);
+			lightClusters.AddPointLight(position, glm::vec3(0.0f), swarmColors[i] * 0.1f, swarmColors[i] * 0.1f, 1.0f, 4.0f, 20.0f);
+		}
+		lightClusters.MaxLights = lightBudgetOn ? lightBudget : 0;
+		lightClusters.Assign(view, projection);
+		const std::vector<ClusterLight>& lights = lightClusters.GetLights();
+		clusterLights.Upload(lights.empty() ? 0 : &lights[0], lights.size() * sizeof(ClusterLight));
+		clusterGrid.Upload(&lightClusters.GetGrid()[0], lightClusters.GetGrid().size() * sizeof(GLuint));
+		const std::vector<GLuint>& lightIndices = lightClusters.GetIndices();
+		clusterIndices.Upload(lightIndices.empty() ? 0 : &lightIndices[0], lightIndices.size() * sizeof(GLuint));
+		clusterLights.Bind(clusterUnit);
+		clusterGrid.Bind(clusterUnit + 1);
+		clusterIndices.Bind(clusterUnit + 2);
+		// The forward shader reads the lists, the light volumes only the lights
+		glState.UseProgram(deferred ? lightVolumeShader : ourShader);
+		glState.Uniform1i("clusterLights", clusterUnit);
+		glState.Uniform1i("clusterGrid", clusterUnit + 1);
+		glState.Uniform1i("clusterIndices", clusterUnit + 2);
+		clusterTime = (glfwGetTime() - clusterStart) * 1000.0;
+
+		// The frame block: camera, directional light, spotlight and the clusters
+		streamBuffer.BeginFrame();
+		GLintptr frameOffset = 0;
+		GLsizeiptr frameSize = sizeof(FrameBlock);
+		char* frameData = (char*)streamBuffer.Allocate(frameSize, streamBuffer.GetAlignment(GL_UNIFORM_BUFFER), frameOffset);
+		if (frameData)
+		{
+			FrameBlock frame = FrameBlock();
+			frame.View = view;
+			frame.Projection = projection;
+			frame.ViewPos = camera.Position;
+			// Directional light
+			frame.DirLight.Direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+			frame.DirLight.Ambient = glm::vec3(0.05f);
+			frame.DirLight.Diffuse = glm::vec3(0.4f);
+			frame.DirLight.Specular = glm::vec3(0.5f);
+			// SpotLight
+			frame.SpotLight.Position = camera.Position;
+			frame.SpotLight.Direction = camera.Front;
+			frame.SpotLight.Ambient = glm::vec3(0.0f);
+			frame.SpotLight.Diffuse = glm::vec3(1.0f);
+			frame.SpotLight.Specular = glm::vec3(1.0f);
+			frame.SpotLight.Constant = 1.0f;
+			frame.SpotLight.Linear = 0.09f;
+			frame.SpotLight.Quadratic = 0.032f;
+			frame.SpotLight.CutOff = glm::cos(glm::radians(12.5f));
+			frame.SpotLight.OuterCutOff = glm::cos(glm::radians(15.0f));
+			// Clusters
+			frame.ClusterCount = lightClusters.GetCount();
+			frame.ClusterScale = glm::vec4((GLfloat)frame.ClusterCount.x / screenWidth, (GLfloat)frame.ClusterCount.y / screenHeight,
+				lightClusters.GetSliceScale(), lightClusters.GetSliceBias());
+			memcpy(frameData, &frame, sizeof(frame));
+			streamBuffer.Commit();
+			glState.BindBufferRange(GL_UNIFORM_BUFFER, frameBinding, streamBuffer.GetBuffer(), frameOffset, frameSize);
+		}
+		else
+			std::cout << "ERROR::STREAMBUFFER::FULL" << std::endl;
+		glState.UniformBlock("Frame", frameBinding);
+		glState.UseProgram(boxShader);
+		glState.UniformBlock("Frame", frameBinding);
+		if (deferred)
 		{
-			model = glm::mat4();
-			model = glm::translate(model, cubePositions2[i]);
-			GLfloat angle = glm::radians(20.0f) * i;
-			model = glm::rotate(model, (GLfloat)glfwGetTime() * angle, glm::vec3(1.0f, 0.3f, 0.5f));
-			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			glState.UseProgram(compositeShader);
+			glState.UniformBlock("Frame", frameBinding);
 		}
 
 		// Lamps
-		lampShader.Use();
-		modelLoc = glGetUniformLocation(lampShader.Program, "model");
-		viewLoc = glGetUniformLocation(lampShader.Program, "view");
-		projectionLoc = glGetUniformLocation(lampShader.Program, "projection");
-		// Matrices
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-		//Drawing light object using light's vertex attributes
-		glBindVertexArray(lightVAO);
-		for (GLuint i = 0; i < 4; i++)
+		glState.UseProgram(lampShader);
+		glState.UniformBlock("Frame", frameBinding);
+
+		// Where the boxes are this frame
+		GLfloat time = (GLfloat)glfwGetTime();
+		for (GLuint i = 0; i < boxCount; i++)
+			boxSpins.Angle[i] = time * glm::radians(20.0f) * i;
+		SetRotations(boxTransforms, boxSpins, 0, boxCount);
+		ComposeTransforms(boxTransforms, 0, boxCount, boxModels);
+		for (GLuint i = 0; i < boxCount; i++)
+			boxTree.SetBounds(i, unitCube.Transform(boxModels[i]));
+		boxTree.Refit();
+
+		// Only what is at least partly in view gets drawn
+		Frustum frustum = camera.GetFrustum(projection);
+		boxTree.QueryFrustum(frustum, visibleBoxes);
+		CullSpheres(frustum, lampBounds, visibleLamps);
+		// Then only what the boxes in view leave uncovered. Every box is an occluder too, but never hides itself:
+		// its box reaches closer than its faces
+		double occlusionStart = glfwGetTime();
+		occlusion.BeginFrame(projection * view);
+		for (size_t i = 0; i < visibleBoxes.size(); i++)
+			occlusion.AddOccluder(vertices, 8, 36, boxModels[visibleBoxes[i]]);
+		occlusion.Rasterize();
+		size_t kept = 0;
+		for (size_t i = 0; i < visibleBoxes.size(); i++)
+		{
+			if (occlusion.IsVisible(boxTree.GetBounds(visibleBoxes[i])))
+				visibleBoxes[kept++] = visibleBoxes[i];
+		}
+		visibleBoxes.resize(kept);
+		kept = 0;
+		for (size_t i = 0; i < visibleLamps.size(); i++)
+		{
+			glm::vec3 lamp = pointLightPositions2[visibleLamps[i]];
+			if (occlusion.IsVisible(Aabb(lamp - 0.1f, lamp + 0.1f)))
+				visibleLamps[kept++] = visibleLamps[i];
+		}
+		visibleLamps.resize(kept);
+		occlusionTime = (glfwGetTime() - occlusionStart) * 1000.0;
+
+		// The box in the middle of the screen, against the triangles of the boxes its ray reaches
+		if (pickRequested)
 		{
-			model = glm::mat4();
-			model = glm::translate(model, pointLightPositions2[i]);
-			model = glm::scale(model, glm::vec3(0.2f));
-			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			pickRequested = false;
+			RayHit hit;
+			bool picked = boxTree.RayCast(camera.Position, camera.Front, 100.0f, [&](unsigned proxy, float& distance)
+			{
+				return RayTriangles(camera.Position, camera.Front, vertices, 8, 36, boxModels[proxy], distance);
+			}, hit);
+			if (picked)
+				std::cout << "Picked box " << hit.Proxy << " at " << hit.Distance << std::endl;
+			else
+				std::cout << "Picked nothing" << std::endl;
+		}
+
+		// Boxes in view, recorded into command lists by the workers in ranges of objects. The workers only build keys
+		// and packets, the lists are submitted to the queue here on the thread of the context
+		DrawPacket box;
+		box.Program = &boxShader;
+		box.VertexArray = VAO;
+		box.TextureTarget = textures.GetTarget(atlasMap);
+		box.Texture = atlasTexture;
+		box.Mode = GL_TRIANGLES;
+		box.First = 0;
+		box.Count = 36;
+		recorder.Record(visibleBoxes.size(), recordGrain, [&](CommandList& list, size_t begin, size_t end)
+		{
+			DrawPacket packet = box;
+			for (size_t j = begin; j < end; j++)
+			{
+				const glm::mat4& model = boxModels[visibleBoxes[j]];
+				packet.Model = model;
+				// The queue sorts them by program, texture and distance from the camera
+				GLfloat depth = -(view * model[3]).z;
+				list.Submit(MakeDrawKey(0, boxShader.GetProgram(), atlasTexture, depth), packet);
+			}
+		});
+		renderQueue.Submit(recorder);
+		if (!deferred)
+		{
+			litTimer.Begin();
+			renderQueue.Execute(glState);
+			litTimer.End();
+		}
+		else
+		{
+			// Geometry pass: the boxes' surfaces into the G-buffer
+			gBuffer.BeginGeometry();
+			geometryTimer.Begin();
+			renderQueue.Execute(glState);
+			geometryTimer.End();
+
+			// Light pass: the cube around every light's range adds its light to the surfaces inside. Only the back
+			// faces are drawn, so the volumes around the camera still are, and only where they lie behind a surface
+			glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+			gBuffer.BeginLighting();
+			gBuffer.BindTextures(gBufferUnit);
+			glState.UseProgram(lightVolumeShader);
+			glState.Uniform1i("gAlbedoSpecular", gBufferUnit + GBUFFER_ALBEDO_SPECULAR);
+			glState.Uniform1i("gNormal", gBufferUnit + GBUFFER_NORMAL);
+			glState.Uniform1i("gDepth", gBufferUnit + GBUFFER_DEPTH);
+			glState.UniformMatrix4fv("inverseViewProjection", glm::value_ptr(inverseViewProjection));
+			glState.Uniform1f("gShininess", shininess);
+			glDepthMask(GL_FALSE);
+			glDepthFunc(GL_GEQUAL);
+			glEnable(GL_DEPTH_CLAMP);
+			glEnable(GL_CULL_FACE);
+			glCullFace(GL_FRONT);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			lightVolumeTimer.Begin();
+			if (!lights.empty())
+			{
+				glState.BindVertexArray(VAO);
+				glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)lights.size());
+			}
+			lightVolumeTimer.End();
+			glDisable(GL_BLEND);
+			glCullFace(GL_BACK);
+			glDisable(GL_CULL_FACE);
+			glDisable(GL_DEPTH_CLAMP);
+			glDepthMask(GL_TRUE);
+
+			// Composite: the lights of the whole scene over the volumes' into the window, with the G-buffer's depth
+			gBuffer.End();
+			glState.UseProgram(compositeShader);
+			glState.Uniform1i("gAlbedoSpecular", gBufferUnit + GBUFFER_ALBEDO_SPECULAR);
+			glState.Uniform1i("gNormal", gBufferUnit + GBUFFER_NORMAL);
+			glState.Uniform1i("gDepth", gBufferUnit + GBUFFER_DEPTH);
+			glState.Uniform1i("lightAccumulation", gBufferUnit + GBUFFER_LIGHT);
+			glState.UniformMatrix4fv("inverseViewProjection", glm::value_ptr(inverseViewProjection));
+			glState.Uniform1f("gShininess", shininess);
+			glDepthFunc(GL_ALWAYS);
+			compositeTimer.Begin();
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			compositeTimer.End();
+			glDepthFunc(GL_LESS);
+		}
+		renderQueue.Clear();
+
+		//Drawing light objects, already where they stand
+		glState.UseProgram(lampShader);
+		glState.UniformMatrix4fv("model", glm::value_ptr(glm::mat4()));
+		staticBatch.Clear();
+		for (size_t i = 0; i < visibleLamps.size(); i++)
+			staticBatch.Add(lampMeshes[visibleLamps[i]]);
+		staticBatch.Draw(glState, staticMeshes);
+		// The vertex array stays bound, the state knows it and every draw binds the one it needs
+		// Nothing after this reads the frame block, its region is free again once the GPU is past here
+		streamBuffer.EndFrame();
+
+		// How many calls the state kept from the driver and the static draws, in the title once a second
+		if (currentFrame - stateTitleTime >= 1.0)
+		{
+			stateTitleTime = currentFrame;
+			std::ostringstream title;
+			title << "OpenGL Tutorial - GL calls per frame " << glState.Frame.GetIssued() << ", " << glState.Frame.GetSaved() << " redundant ones saved, boxes in view "
+				<< visibleBoxes.size() << "/" << boxTree.GetObjectCount() << ", static meshes "
+				<< staticBatch.Draws << " in " << staticBatch.DrawCalls << " draw call(s) submitted in " << staticBatch.SubmitTime << " ms, stream buffer "
+				<< streamBuffer.GetUsed() << " bytes, " << streamBuffer.Stalls << " stalls, occluded " << occlusion.Occluded << "/" << occlusion.Tested
+				<< " in " << occlusionTime << " ms, lights " << lightClusters.GetLights().size() << "/" << lightClusters.GetAddedCount() << " ("
+				<< lightClusters.Culled << " out of view, " << lightClusters.Dropped << " over the limit) in " << lightClusters.GetIndices().size()
+				<< " cluster entries assigned in " << clusterTime << " ms, ";
+			if (deferred)
+				title << "deferred: geometry " << geometryTimer.Time << " ms, light volumes " << lightVolumeTimer.Time << " ms, composite "
+					<< compositeTimer.Time << " ms on the GPU";
+			else
+				title << "forward: lit boxes " << litTimer.Time << " ms on the GPU";
+			if (lightClusters.Overflows)
+				title << " (" << lightClusters.Overflows << " dropped from full clusters)";
+			glfwSetWindowTitle(window, title.str().c_str());
 		}
-		glBindVertexArray(0);
 		
 		// Swap the screen buffers
 		glfwSwapBuffers(window);
 	}
 	// Deleting all resources, what have been rendered
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
+	glState.DeleteVertexArray(VAO);
+	glState.DeleteBuffer(VBO);
+	glState.DeleteBuffer(EBO);
+	staticMeshes.Release(glState);
+	staticBatch.Release(glState);
+	streamBuffer.Release();
+	clusterLights.Release();
+	clusterGrid.Release();
+	clusterIndices.Release();
+	litTimer.Release();
+	geometryTimer.Release();
+	lightVolumeTimer.Release();
+	compositeTimer.Release();
+	gBuffer.Release();
 	// Clearing any resources allocated by GLFW
+	std::cout << "Textures: " << textures.Hits << " hits, " << textures.Misses << " misses, " << textures.Evictions << " evictions, "
+		<< textures.ResidentBytes / 1024 << " KB resident of " << textures.Budget / 1024 << " KB" << std::endl;
+	const State_Counters& counters = glState.LastFrame;
+	std::cout << "GL calls of the last frame: " << counters.GetIssued() << " issued, " << counters.GetSaved() << " redundant ones saved (programs "
+		<< counters.Issued[CALL_PROGRAM] << "/" << counters.Saved[CALL_PROGRAM] << ", vertex arrays " << counters.Issued[CALL_VERTEX_ARRAY] << "/"
+		<< counters.Saved[CALL_VERTEX_ARRAY] << ", textures " << counters.Issued[CALL_TEXTURE] << "/" << counters.Saved[CALL_TEXTURE] << ", uniforms "
+		<< counters.Issued[CALL_UNIFORM] << "/" << counters.Saved[CALL_UNIFORM] << ", uniform locations " << counters.Issued[CALL_UNIFORM_LOCATION]
+		<< "/" << counters.Saved[CALL_UNIFORM_LOCATION] << ")" << std::endl;
+	std::cout << "Stream buffer: " << streamBuffer.Stalls << " frames waited for the GPU, " << streamBuffer.StallTime << " ms" << std::endl;
+	textures.Clear();
 	glfwTerminate();
 	return 0;
 }
@@ -476,6 +739,18 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	{
 		glfwSetWindowShouldClose(window, GL_TRUE);
 	}
+	else if (key == GLFW_KEY_L && action == GLFW_PRESS)
+	{
+		swarmLights = !swarmLights;
+	}
+	else if (key == GLFW_KEY_K && action == GLFW_PRESS)
+	{
+		lightBudgetOn = !lightBudgetOn;
+	}
+	else if (key == GLFW_KEY_G && action == GLFW_PRESS)
+	{
+		deferredShading = !deferredShading;
+	}
 	else if (key >=  0 && key < 1024)
 	{
 		if (action == GLFW_PRESS)
@@ -532,4 +807,20 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll(yoffset);
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+		pickRequested = true;
+}
+
+// The best compressed format the driver takes, BC7 if it can, else BC1 or BC3 for textures that need their alpha
+Texture_Format pick_texture_format(bool alpha)
+{
+	if (GLEW_ARB_texture_compression_bptc)
+		return TEXTURE_BC7;
+	if (GLEW_EXT_texture_compression_s3tc)
+		return alpha ? TEXTURE_BC3 : TEXTURE_BC1;
+	return TEXTURE_RGBA8;
 }
\ No newline at end of file
@@ -0,0 +1,336 @@
+// PngCook: recompresses every PNG in a directory tree with the given lodepng encoder settings.
+// Used as the asset cook step, and as end-to-end benchmark of the codec.
+//
+// Usage: PngCook <input dir> <output dir> [options]
+//   --threads N        worker threads (default: one per hardware thread)
+//   --filter NAME      zero, minsum, entropy, bruteforce or predefined (default: minsum)
+//   --window N         LZ77 window size, power of two up to 32768 (default: 2048)
+//   --nicematch N      stop searching at matches this long, up to 258 (default: 128)
+//   --no-lazy          disable lazy matching
+//   --no-auto-color    keep the color type of the source instead of lodepng_auto_choose_color
+
+// Std. Includes
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// 3rdparty
+#include "lodepng.h"
+
+// Project includes
+#include "JobSystem.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct CookSettings
+{
+	unsigned Threads;
+	LodePNGFilterStrategy Filter;
+	unsigned WindowSize;
+	unsigned NiceMatch;
+	bool LazyMatching;
+	bool AutoColor;
+};
+
+struct CookJob
+{
+	std::string RelativePath;
+	size_t FileSize;
+	// Results, filled in by the worker
+	unsigned Error;
+	size_t RawSize;
+	size_t OutSize;
+	bool KeptSource;
+	double DecodeSeconds;
+	double EncodeSeconds;
+};
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double megabytesPerSecond(size_t bytes, double seconds)
+{
+	return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+static bool hasPngExtension(const std::string& name)
+{
+	if (name.size() < 4)
+		return false;
+	std::string ext = name.substr(name.size() - 4);
+	for (size_t i = 0; i < ext.size(); i++)
+		ext[i] = (char)tolower(ext[i]);
+	return ext == ".png";
+}
+
+// Collects all PNGs below root, with their path relative to root and their file size
+static void listPngFiles(const std::string& root, const std::string& relative, std::vector<CookJob>& jobs)
+{
+	std::string dir = relative.empty() ? root : root + "/" + relative;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((dir + "/*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		std::string name = data.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = relative.empty() ? name : relative + "/" + name;
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			listPngFiles(root, path, jobs);
+		else if (hasPngExtension(name))
+		{
+			CookJob job = CookJob();
+			job.RelativePath = path;
+			job.FileSize = ((size_t)data.nFileSizeHigh << 16 << 16) | data.nFileSizeLow;
+			jobs.push_back(job);
+		}
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR* handle = opendir(dir.c_str());
+	if (handle == nullptr)
+		return;
+	while (dirent* entry = readdir(handle))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = relative.empty() ? name : relative + "/" + name;
+		struct stat info;
+		if (stat((root + "/" + path).c_str(), &info) != 0)
+			continue;
+		if (S_ISDIR(info.st_mode))
+			listPngFiles(root, path, jobs);
+		else if (hasPngExtension(name))
+		{
+			CookJob job = CookJob();
+			job.RelativePath = path;
+			job.FileSize = (size_t)info.st_size;
+			jobs.push_back(job);
+		}
+	}
+	closedir(handle);
+#endif
+}
+
+// Creates every directory along path, existing ones are fine
+static void makeDirectories(const std::string& path)
+{
+	for (size_t i = 1; i <= path.size(); i++)
+	{
+		if (i < path.size() && path[i] != '/' && path[i] != '\\')
+			continue;
+#ifdef _WIN32
+		_mkdir(path.substr(0, i).c_str());
+#else
+		mkdir(path.substr(0, i).c_str(), 0755);
+#endif
+	}
+}
+
+static void cookFile(CookJob& job, const std::string& inputDir, const std::string& outputDir, const CookSettings& settings)
+{
+	std::vector<unsigned char> png, pixels, out;
+	job.Error = lodepng::load_file(png, inputDir + "/" + job.RelativePath);
+	if (job.Error)
+		return;
+
+	// Decode to the color type of the file itself, so 16-bit and palette sources survive the round trip
+	lodepng::State state;
+	state.decoder.color_convert = 0;
+	unsigned width, height;
+	Clock::time_point start = Clock::now();
+	job.Error = lodepng::decode(pixels, width, height, state, png);
+	job.DecodeSeconds = secondsSince(start);
+	if (job.Error)
+		return;
+	job.RawSize = pixels.size();
+
+	lodepng::State encodeState;
+	lodepng_color_mode_copy(&encodeState.info_raw, &state.info_raw);
+	if (!settings.AutoColor)
+		lodepng_color_mode_copy(&encodeState.info_png.color, &state.info_raw);
+	encodeState.info_png.interlace_method = state.info_png.interlace_method;
+	encodeState.encoder.auto_convert = settings.AutoColor ? 1 : 0;
+	encodeState.encoder.filter_strategy = settings.Filter;
+	encodeState.encoder.zlibsettings.windowsize = settings.WindowSize;
+	encodeState.encoder.zlibsettings.nicematch = settings.NiceMatch;
+	encodeState.encoder.zlibsettings.lazymatching = settings.LazyMatching ? 1 : 0;
+
+	start = Clock::now();
+	job.Error = lodepng::encode(out, pixels, width, height, encodeState);
+	job.EncodeSeconds = secondsSince(start);
+	if (job.Error)
+		return;
+	// A source that is already packed tighter than these settings manage is written out as it was
+	job.KeptSource = out.size() >= png.size();
+	if (job.KeptSource)
+		out.swap(png);
+	job.OutSize = out.size();
+
+	std::string outPath = outputDir + "/" + job.RelativePath;
+	size_t slash = outPath.find_last_of("/\\");
+	if (slash != std::string::npos)
+		makeDirectories(outPath.substr(0, slash));
+	job.Error = lodepng::save_file(out, outPath);
+}
+
+static bool parseFilter(const std::string& name, LodePNGFilterStrategy& filter)
+{
+	if (name == "zero") filter = LFS_ZERO;
+	else if (name == "minsum") filter = LFS_MINSUM;
+	else if (name == "entropy") filter = LFS_ENTROPY;
+	else if (name == "bruteforce") filter = LFS_BRUTE_FORCE;
+	else if (name == "predefined") filter = LFS_PREDEFINED;
+	else return false;
+	return true;
+}
+
+// The LZ77 window has to be a power of two no larger than the 32K deflate allows
+static bool parseWindow(const std::string& text, unsigned& window)
+{
+	char* end;
+	unsigned long value = strtoul(text.c_str(), &end, 10);
+	if (*end != '\0' || value == 0 || value > 32768 || (value & (value - 1)) != 0)
+		return false;
+	window = (unsigned)value;
+	return true;
+}
+
+static void printUsage()
+{
+	std::cout << "Usage: PngCook <input dir> <output dir> [--threads N] [--filter zero|minsum|entropy|bruteforce|predefined]" << std::endl;
+	std::cout << "               [--window N] [--nicematch N] [--no-lazy] [--no-auto-color]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		printUsage();
+		return 1;
+	}
+	std::string inputDir = argv[1];
+	std::string outputDir = argv[2];
+
+	CookSettings settings;
+	settings.Threads = 0;
+	settings.Filter = LFS_MINSUM;
+	settings.WindowSize = 2048;
+	settings.NiceMatch = 128;
+	settings.LazyMatching = true;
+	settings.AutoColor = true;
+	for (int i = 3; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--threads" && hasValue)
+			settings.Threads = (unsigned)atoi(argv[++i]);
+		else if (arg == "--filter" && hasValue && parseFilter(argv[i + 1], settings.Filter))
+			i++;
+		else if (arg == "--window" && hasValue)
+		{
+			if (!parseWindow(argv[++i], settings.WindowSize))
+			{
+				std::cout << "ERROR::PNGCOOK::INVALID_WINDOW " << argv[i] << ", must be a power of two up to 32768" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--nicematch" && hasValue)
+			settings.NiceMatch = (unsigned)atoi(argv[++i]);
+		else if (arg == "--no-lazy")
+			settings.LazyMatching = false;
+		else if (arg == "--no-auto-color")
+			settings.AutoColor = false;
+		else
+		{
+			std::cout << "ERROR::PNGCOOK::UNKNOWN_ARGUMENT " << arg << std::endl;
+			printUsage();
+			return 1;
+		}
+	}
+
+	std::vector<CookJob> jobs;
+	listPngFiles(inputDir, "", jobs);
+	if (jobs.empty())
+	{
+		std::cout << "No PNG files found in " << inputDir << std::endl;
+		return 0;
+	}
+	// Largest files first, so the big ones don't end up alone on one core at the end of the run
+	std::sort(jobs.begin(), jobs.end(), [](const CookJob& a, const CookJob& b) { return a.FileSize > b.FileSize; });
+
+	JobSystem pool(settings.Threads);
+	std::cout << "Cooking " << jobs.size() << " files on " << pool.GetThreadCount() << " threads" << std::endl;
+
+	std::mutex printLock;
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		CookJob* job = &jobs[i];
+		pool.Submit([job, &inputDir, &outputDir, &settings, &printLock]()
+		{
+			cookFile(*job, inputDir, outputDir, settings);
+
+			std::ostringstream line;
+			line << std::fixed << std::setprecision(2);
+			if (job->Error)
+				line << "ERROR::PNGCOOK::" << job->RelativePath << ": " << lodepng_error_text(job->Error);
+			else
+			{
+				line << job->RelativePath << ": " << job->FileSize << " -> " << job->OutSize << " bytes"
+					<< ", ratio " << (double)job->OutSize / job->FileSize
+					<< (job->KeptSource ? " (source kept)" : "")
+					<< ", decode " << megabytesPerSecond(job->RawSize, job->DecodeSeconds) << " MB/s"
+					<< ", encode " << megabytesPerSecond(job->RawSize, job->EncodeSeconds) << " MB/s";
+			}
+			std::lock_guard<std::mutex> lock(printLock);
+			std::cout << line.str() << std::endl;
+		});
+	}
+	pool.Wait();
+	double wallSeconds = secondsSince(start);
+
+	// Aggregate over the files that made it, throughput is raw pixel data over wall time
+	size_t inBytes = 0, outBytes = 0, rawBytes = 0, failed = 0;
+	double decodeSeconds = 0.0, encodeSeconds = 0.0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].Error)
+		{
+			failed++;
+			continue;
+		}
+		inBytes += jobs[i].FileSize;
+		outBytes += jobs[i].OutSize;
+		rawBytes += jobs[i].RawSize;
+		decodeSeconds += jobs[i].DecodeSeconds;
+		encodeSeconds += jobs[i].EncodeSeconds;
+	}
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Total: " << inBytes << " -> " << outBytes << " bytes, ratio " << (inBytes ? (double)outBytes / inBytes : 0.0)
+		<< ", " << failed << " failed" << std::endl;
+	std::cout << "Wall time " << wallSeconds << " s, " << megabytesPerSecond(rawBytes, wallSeconds) << " MB/s"
+		<< " (per thread: decode " << megabytesPerSecond(rawBytes, decodeSeconds)
+		<< " MB/s, encode " << megabytesPerSecond(rawBytes, encodeSeconds) << " MB/s)" << std::endl;
+	return failed ? 2 : 0;
+}